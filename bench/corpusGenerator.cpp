@@ -0,0 +1,236 @@
+#include "./corpusGenerator.h"
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// What the generator needs to know about a language to write plausible code in it
+struct syntax {
+  const char* extension;
+  const char* lineComment;
+  const char* blockOpen;
+  const char* blockClose;
+  const char* quote;
+};
+
+constexpr syntax SYNTAX[lang::BUILTIN_COUNT] = {
+  { "c", "//", "/*", "*/", "\"" },     // UNDEF: written as C
+  { "c", "//", "/*", "*/", "\"" },     // C
+  { "cpp", "//", "/*", "*/", "\"" },   // CPP
+  { "h", "//", "/*", "*/", "\"" },     // H
+  { "hpp", "//", "/*", "*/", "\"" },   // HPP
+  { "py", "#", "\"\"\"", "\"\"\"", "'" }, // PYTHON (docstrings)
+  { "java", "//", "/*", "*/", "\"" },  // JAVA
+  { "js", "//", "/*", "*/", "'" },     // JAVASCRIPT
+  { "go", "//", "/*", "*/", "\"" },    // GO
+  { "rs", "//", "/*", "*/", "\"" },    // RUST
+};
+
+const char* const WORDS[] = { "count",  "index", "buffer", "value", "result", "node",
+                              "length", "state", "token",  "line",  "offset", "size",
+                              "next",   "table", "entry",  "file" };
+
+}  // namespace
+
+corpusGenerator::corpusGenerator(std::uint64_t seed) : state(seed) {}
+
+std::uint64_t corpusGenerator::next() {
+  std::uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+void corpusGenerator::word(std::string& out) {
+  out += WORDS[below(sizeof(WORDS) / sizeof(WORDS[0]))];
+}
+
+const char* corpusGenerator::extension(langId language) {
+  return SYNTAX[language < lang::BUILTIN_COUNT ? language : lang::UNDEF].extension;
+}
+
+std::string corpusGenerator::source(langId language, size_t lines) {
+  const syntax& s = SYNTAX[language < lang::BUILTIN_COUNT ? language : lang::UNDEF];
+  std::string out;
+  out.reserve(lines * 32);
+  size_t written = 0;
+  while (written < lines) {
+    std::uint64_t kind = below(100);
+    if (kind >= 15) {
+      out.append(2 * below(4), ' ');  // Indentation; blank lines get none
+    }
+    if (kind < 15) {
+      // Blank line
+    } else if (kind < 27) {
+      out += s.lineComment;
+      out += ' ';
+      word(out);
+      out += ' ';
+      word(out);
+    } else if (kind < 32 && written + 3 <= lines) {
+      // A block comment over a few lines
+      size_t inner = 1 + below(4);
+      if (written + inner + 2 > lines) {
+        inner = lines - written - 2;
+      }
+      out += s.blockOpen;
+      for (size_t k = 0; k < inner; k++) {
+        out += "\n   ";
+        word(out);
+      }
+      out += '\n';
+      out += s.blockClose;
+      written += inner + 1;
+    } else if (kind < 40) {
+      word(out);
+      out += " = ";
+      out += s.quote;
+      word(out);
+      out += "\\n ";
+      word(out);
+      out += s.quote;
+      out += ';';
+    } else {
+      word(out);
+      out += " = ";
+      word(out);
+      out += " + ";
+      out += std::to_string(below(1000));
+      out += ';';
+      if (kind >= 95) {
+        out += ' ';
+        out += s.lineComment;
+        out += ' ';
+        word(out);
+      }
+    }
+    out += '\n';
+    written++;
+  }
+  return out;
+}
+
+std::string corpusGenerator::hugeLine(size_t bytes) {
+  std::string out;
+  out.reserve(bytes + 16);
+  while (out.size() < bytes) {
+    word(out);
+    out += " = ";
+    word(out);
+    out += "; ";
+  }
+  return out;
+}
+
+std::string corpusGenerator::longBlockComment(size_t bytes) {
+  std::string out = "/*\n";
+  out.reserve(bytes + 16);
+  while (out.size() < bytes) {
+    out += " * ";
+    word(out);
+    out += ' ';
+    word(out);
+    out += '\n';
+  }
+  out += " */\n";
+  return out;
+}
+
+std::string corpusGenerator::stringHeavy(size_t bytes) {
+  std::string out;
+  out.reserve(bytes + 64);
+  while (out.size() < bytes) {
+    out += "puts(\"";
+    word(out);
+    out += "\\\" \\\\ '";
+    word(out);
+    out += "' // not a comment /* nor this */\");\n";
+  }
+  return out;
+}
+
+size_t corpusGenerator::writeTree(const std::string& root, const corpusOptions& options) {
+  // Directories level by level: the root, its fanout children, theirs, and so on
+  std::vector<std::string> dirs = { root };
+  size_t levelBegin = 0;
+  for (unsigned level = 0; level < options.depth; level++) {
+    size_t levelEnd = dirs.size();
+    for (size_t d = levelBegin; d < levelEnd; d++) {
+      for (unsigned k = 0; k < options.fanout; k++) {
+        dirs.push_back(dirs[d] + "/d" + std::to_string(k));
+      }
+    }
+    levelBegin = levelEnd;
+  }
+  std::error_code error;
+  for (const auto& dir : dirs) {
+    fs::create_directories(dir, error);
+    if (error) {
+      return 0;
+    }
+  }
+
+  std::vector<std::pair<langId, unsigned>> mix = options.mix;
+  if (mix.empty()) {
+    for (langId id = 1; id < lang::BUILTIN_COUNT; id++) {
+      mix.emplace_back(id, 1);
+    }
+  }
+  unsigned totalWeight = 0;
+  for (const auto& entry : mix) {
+    totalWeight += entry.second;
+  }
+  if (totalWeight == 0) {
+    return 0;
+  }
+
+  size_t bytes = 0;
+  for (unsigned i = 0; i < options.files; i++) {
+    std::uint64_t pick = below(totalWeight);
+    langId language = mix.back().first;
+    for (const auto& entry : mix) {
+      if (pick < entry.second) {
+        language = entry.first;
+        break;
+      }
+      pick -= entry.second;
+    }
+    size_t lines = options.meanLines / 2 + below(options.meanLines + 1);
+    std::string content = source(language, lines);
+    std::string filePath
+      = dirs[i % dirs.size()] + "/f" + std::to_string(i) + "." + extension(language);
+    std::ofstream out(filePath, std::ios::binary);
+    out.write(content.data(), static_cast<std::streamsize>(content.size()));
+    if (!out) {
+      return 0;
+    }
+    bytes += content.size();
+  }
+  return bytes;
+}
+
+bool corpusGenerator::parseMix(const std::string& spec,
+                               std::vector<std::pair<langId, unsigned>>& mix) {
+  mix.clear();
+  size_t begin = 0;
+  while (begin <= spec.size()) {
+    size_t end = spec.find(',', begin);
+    if (end == std::string::npos) {
+      end = spec.size();
+    }
+    std::string item = spec.substr(begin, end - begin);
+    size_t equals = item.find('=');
+    std::string ext = item.substr(0, equals);
+    std::string weight = equals == std::string::npos ? "1" : item.substr(equals + 1);
+    langId language = languageRegistry::fromExtension(ext);
+    if (language == lang::UNDEF || weight.empty() || weight.size() > 4
+        || weight.find_first_not_of("0123456789") != std::string::npos) {
+      return false;
+    }
+    mix.emplace_back(language, static_cast<unsigned>(std::stoul(weight)));
+    begin = end + 1;
+  }
+  return !mix.empty();
+}
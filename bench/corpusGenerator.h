@@ -0,0 +1,121 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../include/language.h"
+
+/**
+ * @struct corpusOptions
+ * @brief Shape of a synthetic source tree.
+ */
+struct corpusOptions {
+  unsigned files = 2000;     /**< Number of source files */
+  unsigned depth = 3;        /**< Levels of directories below the root */
+  unsigned fanout = 4;       /**< Subdirectories per directory */
+  unsigned meanLines = 200;  /**< Average number of lines per file */
+  std::uint64_t seed = 1;    /**< Seed of the generator: same seed, same tree */
+  std::vector<std::pair<langId, unsigned>> mix; /**< Languages and their weights (empty = all) */
+};
+
+/**
+ * @class corpusGenerator
+ * @brief Deterministic generator of source code and source trees for benchmarks.
+ *
+ * Everything is derived from a splitmix64 stream, so a seed always yields the same bytes on every
+ * machine and every run, and two versions of the counter can be compared on identical input.
+ */
+class corpusGenerator {
+public:
+  /**
+   * @brief Creates a generator.
+   *
+   * @param seed Seed of the random stream.
+   */
+  explicit corpusGenerator(std::uint64_t seed);
+
+  /**
+   * @brief Generates a plausible source file: code, comments, literals and blank lines.
+   *
+   * @param language Language whose comment and literal syntax is used.
+   * @param lines Number of lines.
+   * @return The file content.
+   */
+  std::string source(langId language, size_t lines);
+
+  /**
+   * @brief Generates a C file made of one line of code without a newline.
+   *
+   * @param bytes Size of the line.
+   * @return The file content.
+   */
+  std::string hugeLine(size_t bytes);
+
+  /**
+   * @brief Generates a C file made of a single block comment.
+   *
+   * @param bytes Approximate size of the file.
+   * @return The file content.
+   */
+  std::string longBlockComment(size_t bytes);
+
+  /**
+   * @brief Generates a C file where most lines are string literals with escapes.
+   *
+   * @param bytes Approximate size of the file.
+   * @return The file content.
+   */
+  std::string stringHeavy(size_t bytes);
+
+  /**
+   * @brief Writes a source tree.
+   *
+   * @param root Directory to create the tree in (created if missing).
+   * @param options Shape of the tree.
+   * @return Number of bytes written, or 0 on failure.
+   */
+  size_t writeTree(const std::string& root, const corpusOptions& options);
+
+  /**
+   * @brief Parses a language mix such as "cpp=3,py=1" (extensions and weights).
+   *
+   * @param spec The mix.
+   * @param mix Receives the languages and their weights.
+   * @return False if an extension is unknown or a weight is malformed.
+   */
+  static bool parseMix(const std::string& spec, std::vector<std::pair<langId, unsigned>>& mix);
+
+  /**
+   * @brief Gets the usual file extension of a language.
+   *
+   * @param language A built-in language.
+   * @return Extension without the dot.
+   */
+  static const char* extension(langId language);
+
+private:
+  std::uint64_t state; /**< State of the splitmix64 stream */
+
+  /**
+   * @brief Draws the next random number.
+   *
+   * @return 64 random bits.
+   */
+  std::uint64_t next();
+
+  /**
+   * @brief Draws a number below a bound.
+   *
+   * @param bound Exclusive upper bound (must not be 0).
+   * @return A number in [0, bound).
+   */
+  std::uint64_t below(std::uint64_t bound) { return next() % bound; }
+
+  /**
+   * @brief Appends a random identifier-like word.
+   *
+   * @param out Text to append to.
+   */
+  void word(std::string& out);
+};
@@ -0,0 +1,315 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "../include/dirWalker.h"
+#include "../include/fileHandler.h"
+#include "../include/language.h"
+#include "../include/lexer.h"
+#include "../include/outputHandler.h"
+#include "../include/resultStore.h"
+#include "../include/simdScan.h"
+#include "../include/sloc.h"
+#include "../include/threadPool.h"
+#include "./corpusGenerator.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Bumped whenever the set of benchmarks or the meaning of a field changes
+constexpr int REPORT_VERSION = 1;
+
+struct benchResult {
+  std::string name;
+  unsigned iterations = 0;
+  double seconds = 0;  // Best iteration
+  size_t bytes = 0;    // Input bytes per iteration (0 if not meaningful)
+  size_t items = 0;    // Files or rows per iteration (0 if not meaningful)
+};
+
+struct benchSettings {
+  double minSeconds = 0.5;    // Time spent on each benchmark
+  size_t lexerBytes = 16 << 20;
+  size_t rows = 200000;
+  corpusOptions corpus;
+  std::string corpusDir;      // Walk an existing tree instead of a generated one
+  std::string filter;         // Only run the group of benchmarks named by this
+};
+
+// Runs a body until the time budget is spent (at least three times) and keeps the best time
+benchResult measure(const std::string& name,
+                    const benchSettings& settings,
+                    size_t bytes,
+                    size_t items,
+                    const std::function<void()>& body) {
+  benchResult result{ name, 0, 0, bytes, items };
+  double spent = 0;
+  while (result.iterations < 3 || spent < settings.minSeconds) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    double seconds
+      = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (result.iterations == 0 || seconds < result.seconds) {
+      result.seconds = seconds;
+    }
+    spent += seconds;
+    result.iterations++;
+  }
+  std::cerr << "  " << name << ": " << result.seconds * 1000 << " ms\n";
+  return result;
+}
+
+// Keeps the compiler from dropping a computation whose result is unused
+volatile count_t consumed = 0;
+
+void consume(const lineCounts& counts) { consumed = counts.lines + counts.code; }
+
+void benchLexer(const benchSettings& settings, std::vector<benchResult>& results) {
+  corpusGenerator generator(settings.corpus.seed);
+  for (langId id = 1; id < languageRegistry::count(); id++) {
+    std::string text = generator.source(id, settings.lexerBytes / 24);
+    const lexTables& tables = languageRegistry::tables(id);
+    results.push_back(measure(
+      "lexer/" + std::string(languageRegistry::name(id)), settings, text.size(), 0, [&] {
+        consume(lexer::count(tables, text.data(), text.size()));
+      }));
+  }
+
+  // The same source fed in 4 KiB chunks, as a socket or a decompressor would hand it over
+  std::string source = generator.source(lang::CPP, settings.lexerBytes / 24);
+  results.push_back(measure("lexer/chunked_4k", settings, source.size(), 0, [&] {
+    sloc::chunkCounter counter(lang::CPP);
+    for (size_t offset = 0; offset < source.size(); offset += 4096) {
+      counter.feed(std::string_view(source).substr(offset, 4096));
+    }
+    consume(counter.finish());
+  }));
+
+  // Inputs that defeat line-oriented shortcuts
+  const lexTables& c = languageRegistry::tables(lang::C);
+  std::vector<std::pair<std::string, std::string>> pathological = {
+    { "lexer/huge_line", generator.hugeLine(settings.lexerBytes) },
+    { "lexer/long_block_comment", generator.longBlockComment(settings.lexerBytes) },
+    { "lexer/string_heavy", generator.stringHeavy(settings.lexerBytes) },
+    { "lexer/blank_lines", std::string(settings.lexerBytes, '\n') },
+  };
+  for (const auto& [name, text] : pathological) {
+    results.push_back(measure(name, settings, text.size(), 0, [&] {
+      consume(lexer::count(c, text.data(), text.size()));
+    }));
+  }
+}
+
+void benchTree(const benchSettings& settings,
+               const std::string& root,
+               std::vector<benchResult>& results) {
+  size_t files = 0;
+  dirWalker counter(true, nullptr);
+  counter.walk(root, [&files](const std::string&, size_t) { files++; });
+
+  results.push_back(measure("walk/sequential", settings, 0, files, [&] {
+    dirWalker walker(true, nullptr);
+    walker.walk(root, [](const std::string&, size_t) {});
+  }));
+  results.push_back(measure("walk/parallel", settings, 0, files, [&] {
+    threadPool pool(0);
+    dirWalker walker(true, &pool);
+    walker.walk(root, [](const std::string&, size_t) {});
+  }));
+
+  for (unsigned jobs : { 1u, 0u }) {
+    scanOptions options;
+    options.isRecursive = true;
+    options.jobs = jobs;
+    results.push_back(
+      measure(jobs == 1 ? "count/sequential" : "count/parallel", settings, 0, files, [&] {
+        resultStore Db;
+        fileHandler(root).setFilesInDatabase(Db, options);
+      }));
+  }
+}
+
+void benchOutput(const benchSettings& settings, std::vector<benchResult>& results) {
+  // Rows spread over a few hundred directories, like a real tree
+  resultStore Db;
+  Db.reserve(settings.rows);
+  for (size_t row = 0; row < settings.rows; row++) {
+    langId language = static_cast<langId>(1 + row % (languageRegistry::count() - 1));
+    std::string filePath = "src/d" + std::to_string((row * 2654435761u) % 331) + "/f"
+                           + std::to_string(row) + "." + corpusGenerator::extension(language);
+    lineCounts counts;
+    counts.lines = (row * 7919) % 5000;
+    counts.blank = counts.lines / 7;
+    counts.comments = (row * 31) % (counts.lines + 1) / 3;
+    counts.code = counts.lines - counts.blank - counts.comments / 2;
+    Db.append(filePath, language, counts);
+  }
+
+  // The table goes to /dev/null: the formatting benchmarks must not measure the terminal
+  int discard = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+  if (discard < 0) {
+    std::cerr << "Could not open /dev/null\n";
+    return;
+  }
+  {
+    outputHandler output(discard);
+    const std::pair<const char*, std::pair<std::string, std::string>> orders[] = {
+      { "format/unsorted", { "", "" } },  { "sort+format/name", { "-s", "f" } },
+      { "sort+format/type", { "-s", "t" } }, { "sort+format/all_desc", { "-S", "a" } },
+    };
+    for (const auto& [name, option] : orders) {
+      results.push_back(measure(name, settings, 0, Db.size(), [&] {
+        output.outputFormatted(Db, static_cast<int>(Db.size()), option);
+      }));
+    }
+  }
+  ::close(discard);
+}
+
+void writeReport(std::ostream& out, const std::vector<benchResult>& results) {
+  out << "{\n  \"version\": " << REPORT_VERSION << ",\n";
+  out << "  \"simd_kernel\": \"" << simd::kernelName() << "\",\n";
+  out << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+  out << "  \"results\": [";
+  for (size_t k = 0; k < results.size(); k++) {
+    const benchResult& r = results[k];
+    char line[512];
+    std::snprintf(line,
+                  sizeof(line),
+                  "%s\n    {\"name\": \"%s\", \"iterations\": %u, \"seconds\": %.9f, "
+                  "\"bytes\": %zu, \"items\": %zu, \"mb_per_s\": %.3f, \"items_per_s\": %.1f}",
+                  k == 0 ? "" : ",",
+                  r.name.c_str(),
+                  r.iterations,
+                  r.seconds,
+                  r.bytes,
+                  r.items,
+                  r.bytes ? r.bytes / r.seconds / 1e6 : 0.0,
+                  r.items ? r.items / r.seconds : 0.0);
+    out << line;
+  }
+  out << "\n  ]\n}\n";
+}
+
+void printUsage() {
+  std::cerr << "Usage: slockf_bench [--quick] [--only NAME] [--json FILE] [--seed N]\n"
+               "                    [--corpus DIR] [--files N] [--depth N] [--fanout N]\n"
+               "                    [--lines N] [--mix EXT=W,...]\n"
+               "       slockf_bench --generate DIR [--seed N] [--files N] [--depth N]\n"
+               "                    [--fanout N] [--lines N] [--mix EXT=W,...]\n";
+}
+
+unsigned parseNumber(const std::string& option, const std::string& value) {
+  if (value.empty() || value.size() > 9 || value.find_first_not_of("0123456789") != std::string::npos) {
+    std::cerr << "Invalid value for " << option << ": " << value << "\n";
+    std::exit(1);
+  }
+  return static_cast<unsigned>(std::stoul(value));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  benchSettings settings;
+  std::string jsonPath;
+  std::string generateDir;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--quick") {
+      settings.minSeconds = 0.05;
+      settings.lexerBytes = 2 << 20;
+      settings.rows = 20000;
+      settings.corpus.files = 500;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      printUsage();
+      return 1;
+    }
+    std::string value = argv[++i];
+    if (arg == "--json") jsonPath = value;
+    else if (arg == "--only") settings.filter = value;
+    else if (arg == "--corpus") settings.corpusDir = value;
+    else if (arg == "--generate") generateDir = value;
+    else if (arg == "--seed") settings.corpus.seed = parseNumber(arg, value);
+    else if (arg == "--files") settings.corpus.files = parseNumber(arg, value);
+    else if (arg == "--depth") settings.corpus.depth = parseNumber(arg, value);
+    else if (arg == "--fanout") settings.corpus.fanout = parseNumber(arg, value);
+    else if (arg == "--lines") settings.corpus.meanLines = parseNumber(arg, value);
+    else if (arg == "--mix") {
+      if (!corpusGenerator::parseMix(value, settings.corpus.mix)) {
+        std::cerr << "Invalid language mix: " << value << "\n";
+        return 1;
+      }
+    } else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (!generateDir.empty()) {
+    corpusGenerator generator(settings.corpus.seed);
+    size_t bytes = generator.writeTree(generateDir, settings.corpus);
+    if (bytes == 0) {
+      std::cerr << "Could not write the corpus to " << generateDir << "\n";
+      return 1;
+    }
+    std::cerr << settings.corpus.files << " files, " << bytes << " bytes written to " << generateDir
+              << "\n";
+    return 0;
+  }
+
+  auto wanted = [&settings](const char* group) {
+    return settings.filter.empty() || settings.filter.find(group) != std::string::npos
+           || std::string(group).find(settings.filter) != std::string::npos;
+  };
+
+  std::vector<benchResult> results;
+  if (wanted("lexer")) {
+    std::cerr << "lexer\n";
+    benchLexer(settings, results);
+  }
+  if (wanted("walk") || wanted("count")) {
+    std::cerr << "walk and count\n";
+    std::string root = settings.corpusDir;
+    if (root.empty()) {
+      root = (fs::temp_directory_path() / ("slockf_bench." + std::to_string(::getpid()))).string();
+      corpusGenerator generator(settings.corpus.seed);
+      if (generator.writeTree(root, settings.corpus) == 0) {
+        std::cerr << "Could not write the corpus to " << root << "\n";
+        return 1;
+      }
+    }
+    benchTree(settings, root, results);
+    if (settings.corpusDir.empty()) {
+      std::error_code error;
+      fs::remove_all(root, error);
+    }
+  }
+  if (wanted("format")) {
+    std::cerr << "sort and format\n";
+    benchOutput(settings, results);
+  }
+
+  if (jsonPath.empty()) {
+    writeReport(std::cout, results);
+    return 0;
+  }
+  std::ofstream out(jsonPath);
+  writeReport(out, results);
+  if (!out) {
+    std::cerr << "Could not write " << jsonPath << "\n";
+    return 1;
+  }
+  return 0;
+}
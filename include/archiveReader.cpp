@@ -0,0 +1,412 @@
+#include "./archiveReader.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <utility>
+#include <zlib.h>
+#include "./fileBuffer.h"
+#include "./tracer.h"
+
+namespace {
+
+constexpr size_t TAR_BLOCK = 512;
+// zlib reads compressed input in pieces of this size
+constexpr unsigned GZ_BUFFER = 256 * 1024;
+// Deflate never expands its input by more than this: a larger unpacked size is a corrupt header
+constexpr std::uint64_t MAX_DEFLATE_RATIO = 1032;
+// Largest GNU long name or pax header accepted
+constexpr std::uint64_t MAX_TAR_METADATA = 1024 * 1024;
+
+bool endsWith(std::string_view text, std::string_view suffix) {
+  if (text.size() < suffix.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < suffix.size(); i++) {
+    char c = text[text.size() - suffix.size() + i];
+    if (c >= 'A' && c <= 'Z') {
+      c = static_cast<char>(c - 'A' + 'a');
+    }
+    if (c != suffix[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Reads exactly size bytes, or fails
+bool gzReadAll(gzFile file, char* data, size_t size) {
+  while (size > 0) {
+    unsigned piece = static_cast<unsigned>(std::min<size_t>(size, 1u << 30));
+    int got = gzread(file, data, piece);
+    if (got <= 0) {
+      return false;
+    }
+    data += got;
+    size -= static_cast<size_t>(got);
+  }
+  return true;
+}
+
+// A NUL-terminated header field of at most size bytes
+std::string field(const char* header, size_t offset, size_t size) {
+  const char* start = header + offset;
+  return std::string(start, strnlen(start, size));
+}
+
+// Size fields are octal, or base-256 big-endian when the high bit of the first byte is set
+bool tarNumber(const char* header, size_t offset, size_t size, std::uint64_t& value) {
+  const auto* bytes = reinterpret_cast<const unsigned char*>(header + offset);
+  value = 0;
+  if (bytes[0] & 0x80) {
+    for (size_t i = 1; i < size; i++) {
+      value = (value << 8) | bytes[i];
+    }
+    return true;
+  }
+  size_t i = 0;
+  while (i < size && bytes[i] == ' ') {
+    i++;
+  }
+  bool digits = false;
+  for (; i < size && bytes[i] >= '0' && bytes[i] <= '7'; i++) {
+    value = (value << 3) | (bytes[i] - '0');
+    digits = true;
+  }
+  return digits;
+}
+
+bool tarChecksumValid(const char* header) {
+  std::uint64_t stored;
+  if (!tarNumber(header, 148, 8, stored)) {
+    return false;
+  }
+  std::uint64_t sum = 0;
+  for (size_t i = 0; i < TAR_BLOCK; i++) {
+    sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(header[i]);
+  }
+  return sum == stored;
+}
+
+// Gets the path and size overrides of a pax extended header ("length key=value\n" records)
+void parsePax(std::string_view records, std::string& path, std::uint64_t& size, bool& hasSize) {
+  while (!records.empty()) {
+    size_t space = records.find(' ');
+    if (space == std::string_view::npos) {
+      return;
+    }
+    size_t length = 0;
+    for (size_t i = 0; i < space; i++) {
+      if (records[i] < '0' || records[i] > '9') {
+        return;
+      }
+      length = length * 10 + static_cast<size_t>(records[i] - '0');
+    }
+    if (length <= space + 1 || length > records.size()) {
+      return;
+    }
+    std::string_view record = records.substr(space + 1, length - space - 2);  // Without the '\n'
+    size_t equals = record.find('=');
+    if (equals != std::string_view::npos) {
+      std::string_view key = record.substr(0, equals);
+      std::string_view value = record.substr(equals + 1);
+      if (key == "path") {
+        path = std::string(value);
+      } else if (key == "size") {
+        size = 0;
+        for (char c : value) {
+          size = size * 10 + static_cast<std::uint64_t>(c - '0');
+        }
+        hasSize = true;
+      }
+    }
+    records.remove_prefix(length);
+  }
+}
+
+std::uint64_t le(const char* data, size_t bytes) {
+  std::uint64_t value = 0;
+  for (size_t i = bytes; i > 0; i--) {
+    value = (value << 8) | static_cast<unsigned char>(data[i - 1]);
+  }
+  return value;
+}
+
+// Allocates the content of an entry; false if the size taken from its header cannot be allocated
+bool allocate(std::string& content, std::uint64_t size) {
+  try {
+    content.assign(static_cast<size_t>(size), '\0');
+  } catch (const std::bad_alloc&) {
+    return false;
+  } catch (const std::length_error&) {
+    return false;
+  }
+  return true;
+}
+
+// Inflates a raw deflate stream whose size is known, feeding zlib pieces that fit its uInt counts
+bool inflateEntry(const char* data, size_t size, std::string& content) {
+  constexpr size_t PIECE = 1u << 30;
+  z_stream stream{};
+  if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+    return false;
+  }
+  auto* output = reinterpret_cast<Bytef*>(content.data());
+  size_t inputLeft = size;
+  size_t outputLeft = content.size();
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  stream.next_out = output;
+  int status = Z_OK;
+  while (status == Z_OK) {
+    if (stream.avail_in == 0) {
+      stream.avail_in = static_cast<uInt>(std::min(inputLeft, PIECE));
+      inputLeft -= stream.avail_in;
+    }
+    if (stream.avail_out == 0) {
+      stream.avail_out = static_cast<uInt>(std::min(outputLeft, PIECE));
+      outputLeft -= stream.avail_out;
+    }
+    status = inflate(&stream, inputLeft == 0 ? Z_FINISH : Z_NO_FLUSH);
+    if (status == Z_BUF_ERROR && ((stream.avail_in == 0 && inputLeft > 0)
+                                  || (stream.avail_out == 0 && outputLeft > 0))) {
+      status = Z_OK;  // Only out of the current piece
+    }
+  }
+  bool complete = status == Z_STREAM_END
+                  && static_cast<size_t>(stream.next_out - output) == content.size();
+  inflateEnd(&stream);
+  return complete;
+}
+
+}  // namespace
+
+bool archiveReader::isArchive(std::string_view filePath) {
+  return endsWith(filePath, ".tar") || endsWith(filePath, ".tar.gz") || endsWith(filePath, ".tgz")
+         || endsWith(filePath, ".zip");
+}
+
+archiveReader::archiveReader(std::string archivePath) : path(std::move(archivePath)) {}
+
+bool archiveReader::read(const filter_t& wanted, const visit_t& visit) {
+  message.clear();
+  skipped = 0;
+  return endsWith(path, ".zip") ? readZip(wanted, visit) : readTar(wanted, visit);
+}
+
+bool archiveReader::readTar(const filter_t& wanted, const visit_t& visit) {
+  gzFile file = gzopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    message = "cannot open " + path;
+    return false;
+  }
+  gzbuffer(file, GZ_BUFFER);
+
+  // No entry holds more than the archive could unpack to
+  struct stat info {};
+  std::uint64_t largest = stat(path.c_str(), &info) == 0
+                            ? static_cast<std::uint64_t>(info.st_size) * MAX_DEFLATE_RATIO
+                            : UINT64_MAX;
+
+  char header[TAR_BLOCK];
+  std::string longName;  // From a GNU 'L' or a pax header, for the next entry
+  std::uint64_t paxSize = 0;
+  bool hasPaxSize = false;
+  bool ok = true;
+  while (true) {
+    if (!gzReadAll(file, header, TAR_BLOCK)) {
+      break;  // Archives truncated after the last entry are common enough
+    }
+    if (std::all_of(header, header + TAR_BLOCK, [](char c) { return c == 0; })) {
+      break;  // End of archive
+    }
+    std::uint64_t size;
+    if (!tarChecksumValid(header) || !tarNumber(header, 124, 12, size)) {
+      message = path + " is not a tar archive, or is corrupt";
+      ok = false;
+      break;
+    }
+    char type = header[156];
+    if (hasPaxSize) {
+      size = paxSize;
+    }
+    if (size > largest || ((type == 'L' || type == 'x') && size > MAX_TAR_METADATA)) {
+      message = path + " is corrupt (an entry is larger than the archive could hold)";
+      ok = false;
+      break;
+    }
+    size_t padded = (size + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+
+    if (type == 'L' || type == 'x') {
+      // Metadata of the next entry
+      std::string data(static_cast<size_t>(size), '\0');
+      if (!gzReadAll(file, data.data(), size) || gzseek(file, padded - size, SEEK_CUR) < 0) {
+        message = path + " is truncated";
+        ok = false;
+        break;
+      }
+      if (type == 'L') {
+        longName = field(data.data(), 0, data.size());
+      } else {
+        parsePax(data, longName, paxSize, hasPaxSize);
+      }
+      continue;
+    }
+
+    std::string name = longName;
+    if (name.empty()) {
+      name = field(header, 0, 100);
+      std::string prefix = field(header, 345, 155);
+      if (std::memcmp(header + 257, "ustar", 5) == 0 && !prefix.empty()) {
+        name = prefix + '/' + name;
+      }
+    }
+    longName.clear();
+    hasPaxSize = false;
+    while (name.compare(0, 2, "./") == 0) {
+      name.erase(0, 2);
+    }
+
+    bool regular = type == '0' || type == '\0' || type == '7';
+    if (regular && wanted(name)) {
+      traceSpan span("unpack", "io");
+      span.setDetail(name);
+      span.setBytes(size);
+      std::string content;
+      if (!allocate(content, size)) {
+        message = path + " is corrupt (an entry is too large to unpack)";
+        ok = false;
+        break;
+      }
+      if (!gzReadAll(file, content.data(), size) || gzseek(file, padded - size, SEEK_CUR) < 0) {
+        message = path + " is truncated";
+        ok = false;
+        break;
+      }
+      visit(std::move(name), std::move(content));
+    } else if (padded > 0 && gzseek(file, static_cast<z_off_t>(padded), SEEK_CUR) < 0) {
+      message = path + " is truncated";
+      ok = false;
+      break;
+    }
+  }
+  gzclose(file);
+  return ok;
+}
+
+bool archiveReader::readZip(const filter_t& wanted, const visit_t& visit) {
+  fileBuffer archive;
+  if (!archive.open(path)) {
+    message = "cannot open " + path;
+    return false;
+  }
+  const char* data = archive.data();
+  size_t size = archive.size();
+  auto corrupt = [this] {
+    message = path + " is not a zip archive, or is corrupt";
+    return false;
+  };
+
+  // The end of central directory record is in the last 64 KiB + 22 bytes (after the comment)
+  if (size < 22) {
+    return corrupt();
+  }
+  size_t end = size - 22;
+  size_t lowest = size > 22 + 65535 ? size - 22 - 65535 : 0;
+  while (le(data + end, 4) != 0x06054b50) {
+    if (end == lowest) {
+      return corrupt();
+    }
+    end--;
+  }
+  std::uint64_t entries = le(data + end + 10, 2);
+  std::uint64_t directory = le(data + end + 16, 4);
+  if ((entries == 0xFFFF || directory == 0xFFFFFFFF) && end >= 20
+      && le(data + end - 20, 4) == 0x07064b50) {
+    // zip64: the real values are in the zip64 end of central directory record
+    std::uint64_t record = le(data + end - 20 + 8, 8);
+    if (record > size || size - record < 56 || le(data + record, 4) != 0x06064b50) {
+      return corrupt();
+    }
+    entries = le(data + record + 32, 8);
+    directory = le(data + record + 48, 8);
+  }
+
+  // Offsets and sizes come from the archive: compare them with what is left, never add to them
+  if (directory > size) {
+    return corrupt();
+  }
+  size_t position = directory;
+  for (std::uint64_t index = 0; index < entries; index++) {
+    if (position > size || size - position < 46 || le(data + position, 4) != 0x02014b50) {
+      return corrupt();
+    }
+    const char* entry = data + position;
+    std::uint64_t flags = le(entry + 8, 2);
+    std::uint64_t method = le(entry + 10, 2);
+    std::uint64_t packed = le(entry + 20, 4);
+    std::uint64_t unpacked = le(entry + 24, 4);
+    size_t nameLength = le(entry + 28, 2);
+    size_t extraLength = le(entry + 30, 2);
+    size_t commentLength = le(entry + 32, 2);
+    std::uint64_t local = le(entry + 42, 4);
+    if (size - position - 46 < nameLength + extraLength + commentLength) {
+      return corrupt();
+    }
+    std::string name(entry + 46, nameLength);
+    // Sizes and offset that do not fit 32 bits are in the zip64 extra field, in this order
+    const char* extrasEnd = entry + 46 + nameLength + extraLength;
+    for (const char* extra = entry + 46 + nameLength; extrasEnd - extra >= 4;) {
+      std::uint64_t id = le(extra, 2);
+      size_t length = le(extra + 2, 2);
+      if (static_cast<size_t>(extrasEnd - extra - 4) < length) {
+        break;  // A field running past the extra area is ignored
+      }
+      if (id == 0x0001) {
+        const char* value = extra + 4;
+        const char* limit = value + length;
+        for (std::uint64_t* target : { &unpacked, &packed, &local }) {
+          if (*target == 0xFFFFFFFF && value + 8 <= limit) {
+            *target = le(value, 8);
+            value += 8;
+          }
+        }
+      }
+      extra += 4 + length;
+    }
+    position += 46 + nameLength + extraLength + commentLength;
+
+    if (name.empty() || name.back() == '/' || !wanted(name)) {
+      continue;  // Directories and unwanted files
+    }
+    if ((flags & 1) != 0 || (method != 0 && method != 8)) {
+      skipped++;  // Encrypted, or compressed with something else than deflate
+      continue;
+    }
+    if (local > size || size - local < 30 || le(data + local, 4) != 0x04034b50) {
+      return corrupt();
+    }
+    std::uint64_t start = local + 30 + le(data + local + 26, 2) + le(data + local + 28, 2);
+    if (start > size || packed > size - start || (method == 0 && packed != unpacked)
+        || unpacked > packed * MAX_DEFLATE_RATIO + 64) {
+      return corrupt();
+    }
+
+    traceSpan span("unpack", "io");
+    span.setDetail(name);
+    span.setBytes(unpacked);
+    std::string content;
+    if (!allocate(content, unpacked)) {
+      return corrupt();
+    }
+    if (method == 0) {
+      std::memcpy(content.data(), data + start, unpacked);
+    } else if (!inflateEntry(data + start, packed, content)) {
+      skipped++;
+      continue;
+    }
+    visit(std::move(name), std::move(content));
+  }
+  return true;
+}
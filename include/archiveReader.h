@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+
+/**
+ * @class archiveReader
+ * @brief Reads the regular files of a .tar, .tar.gz/.tgz or .zip archive into memory, in order.
+ *
+ * Tar archives are read sequentially through zlib (which passes uncompressed tars through as they
+ * are); ustar, GNU long names and pax paths are understood. Zip archives are mapped and read from
+ * their central directory, zip64 included; stored and deflated entries are supported. Entries the
+ * caller does not want are skipped without being kept in memory.
+ */
+class archiveReader {
+public:
+  /** Decides from its path inside the archive if an entry is read. */
+  using filter_t = std::function<bool(std::string_view name)>;
+  /** Receives the path inside the archive and the content of a wanted entry. */
+  using visit_t = std::function<void(std::string name, std::string content)>;
+
+  /**
+   * @brief Checks from its suffix if a path names an archive this class can read.
+   *
+   * @param filePath Path of the file.
+   * @return True for .tar, .tar.gz, .tgz and .zip.
+   */
+  static bool isArchive(std::string_view filePath);
+
+  /**
+   * @brief Prepares to read an archive.
+   *
+   * @param archivePath Path of the archive.
+   */
+  explicit archiveReader(std::string archivePath);
+
+  /**
+   * @brief Reads the archive, calling visit for every wanted regular file in archive order.
+   *
+   * @param wanted Filter on the path of the entries.
+   * @param visit Called on the calling thread, once per wanted entry.
+   * @return False if the archive could not be opened or is corrupt (see error()); the entries
+   * before the damage were visited.
+   */
+  bool read(const filter_t& wanted, const visit_t& visit);
+
+  /**
+   * @brief Gets why read() failed.
+   *
+   * @return Description of the error.
+   */
+  const std::string& error() const { return message; }
+
+  /**
+   * @brief Gets the number of wanted entries that could not be read (encryption, unknown method).
+   *
+   * @return Number of entries skipped.
+   */
+  size_t unreadable() const { return skipped; }
+
+private:
+  std::string path;    /**< Path of the archive */
+  std::string message; /**< Error of the last read() */
+  size_t skipped = 0;  /**< Wanted entries that could not be read */
+
+  /**
+   * @brief Reads a tar archive, compressed with gzip or not.
+   *
+   * @param wanted Filter on the path of the entries.
+   * @param visit Called once per wanted entry.
+   * @return False on error.
+   */
+  bool readTar(const filter_t& wanted, const visit_t& visit);
+
+  /**
+   * @brief Reads a zip archive.
+   *
+   * @param wanted Filter on the path of the entries.
+   * @param visit Called once per wanted entry.
+   * @return False on error.
+   */
+  bool readZip(const filter_t& wanted, const visit_t& visit);
+};
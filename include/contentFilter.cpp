@@ -0,0 +1,147 @@
+#include "./contentFilter.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "./tracer.h"
+
+namespace {
+
+// Comments that code generators put at the top of their outputs; looser phrases such as a bare
+// "automatically generated" also turn up in the documentation of hand-written headers
+constexpr std::string_view GENERATED_MARKERS[] = {
+  "@generated",                         // Facebook tools, Rust, many others
+  "DO NOT EDIT",                        // Go ("Code generated ... DO NOT EDIT."), protoc, flatc
+  "<auto-generated",                    // .NET
+  "file is automatically generated",    // autoconf, Tcl stubs, X11
+  "file was automatically generated",   // SWIG, bindgen
+  "Generated by the protocol buffer compiler",
+};
+
+}  // namespace
+
+bool contentFilter::enable(std::string_view check) {
+  if (check == "binary") {
+    binary = true;
+  } else if (check == "generated") {
+    generated = true;
+  } else if (check == "minified") {
+    minified = true;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+skipReason contentFilter::check(std::uint64_t size, const char* data) const {
+  if (size > limit) {
+    return skipReason::SIZE;
+  }
+  std::string_view probe(data, static_cast<size_t>(std::min<std::uint64_t>(size, PROBE_SIZE)));
+  if (binary && probe.find('\0') != std::string_view::npos) {
+    return skipReason::BINARY;
+  }
+  if (generated) {
+    for (std::string_view marker : GENERATED_MARKERS) {
+      if (probe.find(marker) != std::string_view::npos) {
+        return skipReason::GENERATED;
+      }
+    }
+  }
+  if (minified && probe.size() >= MINIFIED_LINE) {
+    size_t lines = std::max<size_t>(1, std::count(probe.begin(), probe.end(), '\n'));
+    if (probe.size() / lines >= MINIFIED_LINE) {
+      return skipReason::MINIFIED;
+    }
+  }
+  return skipReason::NONE;
+}
+
+skipReason contentFilter::probe(const std::string& filePath) const {
+  traceSpan span("probe", "io");
+  int fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return skipReason::NONE;  // Counted, so the error is reported where the file is read
+  }
+  struct stat info {};
+  if (fstat(fd, &info) != 0) {
+    ::close(fd);
+    return skipReason::NONE;
+  }
+  auto size = static_cast<std::uint64_t>(info.st_size);
+  if (size > limit || !readsContent()) {
+    ::close(fd);
+    return size > limit ? skipReason::SIZE : skipReason::NONE;
+  }
+  char block[PROBE_SIZE];
+  ssize_t got;
+  do {
+    got = pread(fd, block, sizeof(block), 0);
+  } while (got < 0 && errno == EINTR);
+  ::close(fd);
+  if (got < 0) {
+    return skipReason::NONE;
+  }
+  span.setBytes(static_cast<size_t>(got));
+  // Only the bytes read are looked at, and not the size: a file may have grown since the stat
+  return check(static_cast<std::uint64_t>(got), block);
+}
+
+void contentFilter::record(const std::string& filePath, skipReason reason) {
+  byReason[static_cast<size_t>(reason)]++;
+  std::lock_guard<std::mutex> guard(lock);
+  skipped.emplace_back(filePath, reason);
+}
+
+void contentFilter::printReport(std::ostream& out) const {
+  std::uint64_t total = 0;
+  for (const auto& files : byReason) {
+    total += files.load();
+  }
+  out << "Skipped files: " << total;
+  const char* separator = " (";
+  for (skipReason reason :
+       { skipReason::SIZE, skipReason::BINARY, skipReason::GENERATED, skipReason::MINIFIED }) {
+    std::uint64_t files = byReason[static_cast<size_t>(reason)].load();
+    if (files > 0) {
+      out << separator << name(reason) << ' ' << files;
+      separator = ", ";
+    }
+  }
+  out << (total > 0 ? ")\n" : "\n");
+}
+
+bool contentFilter::writeReport(const std::string& reportPath) const {
+  std::lock_guard<std::mutex> guard(lock);
+  std::vector<const std::pair<std::string, skipReason>*> sorted;
+  sorted.reserve(skipped.size());
+  for (const auto& file : skipped) {
+    sorted.push_back(&file);
+  }
+  std::sort(sorted.begin(), sorted.end(), [](const auto* a, const auto* b) {
+    return a->first < b->first;
+  });
+  std::ofstream report(reportPath, std::ios::binary | std::ios::trunc);
+  for (const auto* file : sorted) {
+    report << name(file->second) << '\t' << file->first << '\n';
+  }
+  return static_cast<bool>(report.flush());
+}
+
+std::string_view contentFilter::name(skipReason reason) {
+  switch (reason) {
+  case skipReason::SIZE:
+    return "size";
+  case skipReason::BINARY:
+    return "binary";
+  case skipReason::GENERATED:
+    return "generated";
+  case skipReason::MINIFIED:
+    return "minified";
+  default:
+    return "none";
+  }
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Why a file was left out of the counts.
+ */
+enum class skipReason : std::uint8_t { NONE, SIZE, BINARY, GENERATED, MINIFIED };
+
+/**
+ * @class contentFilter
+ * @brief Turns down the files that are not worth lexing, from their size and their first bytes.
+ *
+ * A file with a supported extension may still be a generated blob (firmware arrays, protobuf
+ * outputs), a minified bundle or a misnamed binary. The checks look at the size of a file, then at
+ * its first PROBE_SIZE bytes only: a NUL byte makes it binary, a marker such as "@generated" or
+ * "DO NOT EDIT" makes it generated, and lines of MINIFIED_LINE bytes or more on average make it
+ * minified. The files turned down are recorded, with their reason, for a report apart from the
+ * table; recording is safe from several threads.
+ */
+class contentFilter {
+public:
+  /** Bytes of the start of a file the content checks look at. */
+  static constexpr size_t PROBE_SIZE = 8 * 1024;
+  /** Mean length of the lines of a probe from which a file is minified. */
+  static constexpr size_t MINIFIED_LINE = 1000;
+
+  /**
+   * @brief Sets the largest file counted.
+   *
+   * @param bytes Size limit, in bytes.
+   */
+  void setSizeLimit(std::uint64_t bytes) { limit = bytes; }
+
+  /**
+   * @brief Turns a content check on.
+   *
+   * @param check One of binary, generated and minified.
+   * @return False if the check is unknown.
+   */
+  bool enable(std::string_view check);
+
+  /**
+   * @brief Gets the largest file counted.
+   *
+   * @return Size limit, in bytes (UINT64_MAX if there is none).
+   */
+  std::uint64_t sizeLimit() const { return limit; }
+
+  /**
+   * @brief Tells if a check needs the first bytes of the files.
+   *
+   * @return True if binary, generated or minified is on.
+   */
+  bool readsContent() const { return binary || generated || minified; }
+
+  /**
+   * @brief Checks a file from its size and its content, of which the first PROBE_SIZE bytes only
+   * are looked at.
+   *
+   * @param size Size of the file.
+   * @param data Content of the file (at least min(size, PROBE_SIZE) bytes).
+   * @return The reason to skip the file, NONE if it is counted.
+   */
+  skipReason check(std::uint64_t size, const char* data) const;
+
+  /**
+   * @brief Checks a file that was not read: a stat, then one read of its first PROBE_SIZE bytes
+   * if a content check is on.
+   *
+   * @param filePath Path of the file.
+   * @return The reason to skip the file, NONE if it is counted or cannot be read.
+   */
+  skipReason probe(const std::string& filePath) const;
+
+  /**
+   * @brief Records a file turned down.
+   *
+   * @param filePath Path of the file.
+   * @param reason Why it was turned down.
+   */
+  void record(const std::string& filePath, skipReason reason);
+
+  /**
+   * @brief Prints how many files were turned down, by reason.
+   *
+   * @param out Stream to print to.
+   */
+  void printReport(std::ostream& out) const;
+
+  /**
+   * @brief Writes the files turned down, one "reason<TAB>path" line each, sorted by path.
+   *
+   * @param reportPath Path of the report.
+   * @return False if the report cannot be written.
+   */
+  bool writeReport(const std::string& reportPath) const;
+
+  /**
+   * @brief Gets the name of a reason, as written in the reports.
+   *
+   * @param reason The reason.
+   * @return size, binary, generated or minified.
+   */
+  static std::string_view name(skipReason reason);
+
+private:
+  std::uint64_t limit = UINT64_MAX; /**< Largest file counted */
+  bool binary = false;              /**< Turn down files with a NUL byte */
+  bool generated = false;           /**< Turn down files with a generated-code marker */
+  bool minified = false;            /**< Turn down files of very long lines */
+
+  mutable std::mutex lock;                                 /**< Guards skipped */
+  std::vector<std::pair<std::string, skipReason>> skipped; /**< Files turned down */
+  std::array<std::atomic<std::uint64_t>, 5> byReason{};    /**< Files turned down, by reason */
+};
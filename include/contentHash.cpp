@@ -0,0 +1,93 @@
+#include "./contentHash.h"
+#include <cstring>
+
+namespace {
+
+constexpr std::uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+constexpr std::uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr std::uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+constexpr std::uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+constexpr std::uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+inline std::uint64_t rotateLeft(std::uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+// Unaligned little-endian loads (the hash is defined on little-endian words)
+inline std::uint64_t read64(const char* p) {
+  std::uint64_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline std::uint32_t read32(const char* p) {
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline std::uint64_t round(std::uint64_t accumulator, std::uint64_t input) {
+  accumulator += input * PRIME2;
+  accumulator = rotateLeft(accumulator, 31);
+  return accumulator * PRIME1;
+}
+
+inline std::uint64_t mergeRound(std::uint64_t accumulator, std::uint64_t lane) {
+  accumulator ^= round(0, lane);
+  return accumulator * PRIME1 + PRIME4;
+}
+
+}  // namespace
+
+std::uint64_t contentHash::hash(const char* data, size_t length, std::uint64_t seed) {
+  const char* p = data;
+  const char* end = data + length;
+  std::uint64_t h;
+
+  if (length >= 32) {
+    // Four lanes, each folding in 8 bytes of every 32-byte stripe
+    std::uint64_t v1 = seed + PRIME1 + PRIME2;
+    std::uint64_t v2 = seed + PRIME2;
+    std::uint64_t v3 = seed;
+    std::uint64_t v4 = seed - PRIME1;
+    const char* lastStripe = end - 32;
+    do {
+      v1 = round(v1, read64(p));
+      v2 = round(v2, read64(p + 8));
+      v3 = round(v3, read64(p + 16));
+      v4 = round(v4, read64(p + 24));
+      p += 32;
+    } while (p <= lastStripe);
+    h = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+    h = mergeRound(h, v1);
+    h = mergeRound(h, v2);
+    h = mergeRound(h, v3);
+    h = mergeRound(h, v4);
+  } else {
+    h = seed + PRIME5;
+  }
+  h += static_cast<std::uint64_t>(length);
+
+  // Tail: 8, then 4, then 1 byte at a time
+  for (; p + 8 <= end; p += 8) {
+    h ^= round(0, read64(p));
+    h = rotateLeft(h, 27) * PRIME1 + PRIME4;
+  }
+  if (p + 4 <= end) {
+    h ^= static_cast<std::uint64_t>(read32(p)) * PRIME1;
+    h = rotateLeft(h, 23) * PRIME2 + PRIME3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    h ^= static_cast<std::uint64_t>(static_cast<unsigned char>(*p)) * PRIME5;
+    h = rotateLeft(h, 11) * PRIME1;
+  }
+
+  // Avalanche
+  h ^= h >> 33;
+  h *= PRIME2;
+  h ^= h >> 29;
+  h *= PRIME3;
+  h ^= h >> 32;
+  return h;
+}
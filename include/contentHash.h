@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @namespace contentHash
+ * @brief Fast non-cryptographic hash of file contents.
+ *
+ * The hash is XXH64: four independent 64-bit lanes over 32-byte stripes, which runs at memory
+ * speed and is far cheaper than lexing the same bytes. It identifies identical contents, not
+ * adversarial ones.
+ */
+namespace contentHash {
+
+/**
+ * @brief Hashes a block of bytes.
+ *
+ * @param data Start of the bytes.
+ * @param length Number of bytes.
+ * @param seed Seed of the hash.
+ * @return The XXH64 hash of the bytes.
+ */
+std::uint64_t hash(const char* data, size_t length, std::uint64_t seed = 0);
+
+}  // namespace contentHash
@@ -0,0 +1,44 @@
+#include "./dedupTable.h"
+
+bool dedupTable::lookup(std::uint64_t hash,
+                        std::uint64_t size,
+                        langId language,
+                        lineCounts& counts) {
+  shard& part = shardOf(hash);
+  {
+    std::lock_guard<std::mutex> guard(part.lock);
+    auto found = part.counts.find({ hash, size, language });
+    if (found == part.counts.end()) {
+      return false;
+    }
+    counts = found->second;
+  }
+  duplicateFiles++;
+  duplicateLines += counts.lines;
+  return true;
+}
+
+void dedupTable::store(std::uint64_t hash,
+                       std::uint64_t size,
+                       langId language,
+                       const lineCounts& counts) {
+  shard& part = shardOf(hash);
+  bool inserted;
+  {
+    std::lock_guard<std::mutex> guard(part.lock);
+    inserted = part.counts.emplace(key{ hash, size, language }, counts).second;
+  }
+  if (inserted) {
+    distinctFiles++;
+    distinctLines += counts.lines;
+  } else {
+    duplicateFiles++;
+    duplicateLines += counts.lines;
+  }
+}
+
+void dedupTable::printReport(std::ostream& out) const {
+  out << "Distinct files: " << distinctFiles.load() << " (" << distinctLines.load() << " lines)\n"
+      << "Duplicate files: " << duplicateFiles.load() << " (" << duplicateLines.load()
+      << " lines)\n";
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include "./language.h"
+#include "./lexer.h"
+
+/**
+ * @class dedupTable
+ * @brief Memoizes line counts by file content, so copies of a file are lexed only once.
+ *
+ * Files are keyed by the hash of their content (see contentHash), their size and their language:
+ * the same bytes count differently in different languages. The table is split into shards with
+ * a lock each, so workers rarely wait for one another, and it tallies how many of the files seen
+ * were distinct and how many were copies of an earlier one.
+ */
+class dedupTable {
+public:
+  /**
+   * @brief Looks up the counts of a content; a hit counts the file as a duplicate.
+   *
+   * @param hash Hash of the content.
+   * @param size Size of the content.
+   * @param language Language the content is counted as.
+   * @param counts Receives the counts on a hit.
+   * @return True if the content was counted before.
+   */
+  bool lookup(std::uint64_t hash, std::uint64_t size, langId language, lineCounts& counts);
+
+  /**
+   * @brief Records the counts of a content that was just lexed.
+   *
+   * If another thread recorded the same content meanwhile, the file counts as a duplicate.
+   *
+   * @param hash Hash of the content.
+   * @param size Size of the content.
+   * @param language Language the content was counted as.
+   * @param counts Counts of the content.
+   */
+  void store(std::uint64_t hash, std::uint64_t size, langId language, const lineCounts& counts);
+
+  /**
+   * @brief Prints how many files and lines were distinct and how many were duplicates.
+   *
+   * @param out Stream to print to.
+   */
+  void printReport(std::ostream& out) const;
+
+private:
+  struct key {
+    std::uint64_t hash;
+    std::uint64_t size;
+    langId language;
+
+    bool operator==(const key& other) const {
+      return hash == other.hash && size == other.size && language == other.language;
+    }
+  };
+
+  struct keyHash {
+    size_t operator()(const key& k) const { return static_cast<size_t>(k.hash ^ k.language); }
+  };
+
+  struct shard {
+    std::mutex lock;
+    std::unordered_map<key, lineCounts, keyHash> counts;
+  };
+
+  static constexpr size_t SHARDS = 64;
+  std::array<shard, SHARDS> shards;
+
+  std::atomic<count_t> distinctFiles{ 0 };  /**< Files whose content was seen first */
+  std::atomic<count_t> distinctLines{ 0 };  /**< Lines of those files */
+  std::atomic<count_t> duplicateFiles{ 0 }; /**< Files whose content was seen before */
+  std::atomic<count_t> duplicateLines{ 0 }; /**< Lines of those files */
+
+  shard& shardOf(std::uint64_t hash) { return shards[(hash >> 58) % SHARDS]; }
+};
@@ -0,0 +1,266 @@
+#include "./dirWalker.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utility>
+#include "./ignoreRules.h"
+#include "./language.h"
+#include "./threadPool.h"
+#include "./tracer.h"
+
+namespace {
+
+// Bytes asked from the kernel per getdents64 call: a few hundred entries
+constexpr size_t DIRENT_BUFFER_SIZE = 64 * 1024;
+// Files handed out per task: large enough to amortize scheduling, small enough to steal
+constexpr size_t BATCH_SIZE = 32;
+// Files that may wait in the pool per worker before the walk visits them itself
+constexpr size_t MAX_QUEUED_PER_WORKER = 64;
+
+// Entry of a directory, kept until the directory is fully read
+struct foundEntry {
+  std::string path;
+  bool isDirectory;
+};
+
+// Directory path with a trailing slash, as the prefix of the paths of its entries
+std::string withSlash(const std::string& dirPath) {
+  if (dirPath.empty() || dirPath.back() != '/') {
+    return dirPath + '/';
+  }
+  return dirPath;
+}
+
+// Name of the files holding ignore patterns
+constexpr std::string_view GITIGNORE = ".gitignore";
+
+// Reads the entries worth walking: subdirectories (if recursive) and files of known languages
+bool readDirectory(const std::string& dirPath,
+                   bool isRecursive,
+                   std::vector<foundEntry>& entries,
+                   bool& hasGitignore) {
+  traceSpan span("readdir", "dir");
+  span.setDetail(dirPath);
+  int fd = ::open(dirPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    std::cerr << ">>>> Error opening directory: " << dirPath << "\n";
+    return false;
+  }
+  std::string prefix = withSlash(dirPath);
+
+  thread_local std::vector<char> buffer(DIRENT_BUFFER_SIZE);
+  size_t bytesRead = 0;
+  while (true) {
+    long length = syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+    if (length <= 0) {
+      if (length < 0) {
+        std::cerr << ">>>> Error reading directory: " << dirPath << "\n";
+      }
+      break;
+    }
+    bytesRead += static_cast<size_t>(length);
+    for (long offset = 0; offset < length;) {
+      const auto* entry = reinterpret_cast<const struct dirent64*>(buffer.data() + offset);
+      offset += entry->d_reclen;
+      const char* name = entry->d_name;
+      if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+        continue;
+      }
+      if (name == GITIGNORE) {
+        hasGitignore = true;
+        continue;
+      }
+
+      bool isSource = languageRegistry::fromPath(name) != lang::UNDEF;
+      unsigned char type = entry->d_type;
+      struct stat info {};
+      // The filesystem did not say what this is: ask, unless it could not matter anyway
+      if (type == DT_UNKNOWN) {
+        if ((!isRecursive && !isSource) || fstatat(fd, name, &info, AT_SYMLINK_NOFOLLOW) != 0) {
+          continue;
+        }
+        type = S_ISDIR(info.st_mode) ? DT_DIR
+               : S_ISREG(info.st_mode) ? DT_REG
+               : S_ISLNK(info.st_mode) ? DT_LNK
+                                       : DT_UNKNOWN;
+      }
+      // Links count as the file they point to, but are never descended into
+      if (type == DT_LNK) {
+        if (!isSource || fstatat(fd, name, &info, 0) != 0 || !S_ISREG(info.st_mode)) {
+          continue;
+        }
+        type = DT_REG;
+      }
+
+      if (type == DT_DIR && isRecursive) {
+        entries.push_back({ prefix + name, true });
+      } else if (type == DT_REG && isSource) {
+        entries.push_back({ prefix + name, false });
+      }
+    }
+  }
+  ::close(fd);
+  span.setBytes(bytesRead);
+  return true;
+}
+
+}  // namespace
+
+/**
+ * @struct dirWalker::node
+ * @brief Entries of a walked directory, in the order the kernel returned them.
+ */
+struct dirWalker::node {
+  /** A file (index is its id) or a subdirectory (index is its position in children). */
+  struct item {
+    bool isDirectory;
+    size_t index;
+  };
+  std::vector<item> items;                    /**< Entries in directory order */
+  std::vector<std::unique_ptr<node>> children; /**< Subdirectories */
+};
+
+dirWalker::dirWalker(bool recursive, threadPool* workers) : isRecursive(recursive), pool(workers) {}
+
+dirWalker::~dirWalker() = default;
+
+void dirWalker::setFilters(bool gitignore, std::vector<std::string> patterns) {
+  respectGitignore = gitignore;
+  excludePatterns = std::move(patterns);
+}
+
+void dirWalker::setDirectoryVisitor(std::function<void(const std::string&)> visitor) {
+  directoryVisitor = std::move(visitor);
+}
+
+void dirWalker::walk(const std::string& root, const visit_t& visit) {
+  tree = std::make_unique<node>();
+  nextId = 0;
+  excludes.reset();
+  if (!excludePatterns.empty()) {
+    auto rules = std::make_shared<ignoreRules>(nullptr, withSlash(root));
+    for (const std::string& pattern : excludePatterns) {
+      rules->add(pattern);
+    }
+    excludes = std::move(rules);
+  }
+  if (pool == nullptr) {
+    walkDirectory(*tree, root, visit, nullptr);
+    return;
+  }
+  pool->submit([this, &root, &visit] { walkDirectory(*tree, root, visit, nullptr); });
+  pool->wait();
+}
+
+void dirWalker::walkDirectory(node& dir,
+                              const std::string& dirPath,
+                              const visit_t& visit,
+                              std::shared_ptr<const ignoreRules> rules) {
+  // Read the whole directory first: the descriptor is closed before any recursion
+  std::vector<foundEntry> entries;
+  bool hasGitignore = false;
+  if (!readDirectory(dirPath, isRecursive, entries, hasGitignore)) {
+    return;
+  }
+  if (directoryVisitor) {
+    directoryVisitor(dirPath);
+  }
+  if (respectGitignore && hasGitignore) {
+    std::string base = withSlash(dirPath);
+    auto own = std::make_shared<ignoreRules>(std::move(rules), base);
+    own->addFile(base + std::string(GITIGNORE));
+    rules = std::move(own);
+  }
+
+  std::vector<std::pair<std::string, size_t>> batch;
+  for (auto& entry : entries) {
+    // Ignored subtrees are dropped here, before they are ever opened
+    if (isExcluded(entry.path, entry.isDirectory, rules.get())) {
+      continue;
+    }
+    if (entry.isDirectory) {
+      dir.items.push_back({ true, dir.children.size() });
+      dir.children.push_back(std::make_unique<node>());
+      node& child = *dir.children.back();
+      if (pool == nullptr) {
+        walkDirectory(child, entry.path, visit, rules);
+      } else {
+        pool->submit([this, &child, path = std::move(entry.path), &visit, rules] {
+          walkDirectory(child, path, visit, rules);
+        });
+      }
+      continue;
+    }
+
+    size_t id = nextId.fetch_add(1);
+    dir.items.push_back({ false, id });
+    if (pool == nullptr) {
+      visit(entry.path, id);
+      continue;
+    }
+    batch.emplace_back(std::move(entry.path), id);
+    if (batch.size() == BATCH_SIZE) {
+      visitBatch(std::move(batch), visit);
+      batch.clear();
+    }
+  }
+  if (!batch.empty()) {
+    visitBatch(std::move(batch), visit);
+  }
+}
+
+bool dirWalker::isExcluded(const std::string& path,
+                           bool isDirectory,
+                           const ignoreRules* rules) const {
+  if (respectGitignore && isDirectory && path.size() >= 5
+      && path.compare(path.size() - 5, 5, "/.git") == 0) {
+    return true;  // Never tracked, whatever the patterns say
+  }
+  return (excludes && excludes->isIgnored(path, isDirectory))
+         || (rules != nullptr && rules->isIgnored(path, isDirectory));
+}
+
+void dirWalker::visitBatch(std::vector<std::pair<std::string, size_t>>&& batch,
+                           const visit_t& visit) {
+  // Never block a worker: when the pool is full, the walk does the work itself
+  if (queuedFiles.load() >= MAX_QUEUED_PER_WORKER * pool->size()) {
+    for (const auto& [filePath, id] : batch) {
+      visit(filePath, id);
+    }
+    return;
+  }
+  queuedFiles += batch.size();
+  pool->submit([this, files = std::move(batch), &visit] {
+    for (const auto& [filePath, id] : files) {
+      visit(filePath, id);
+    }
+    queuedFiles -= files.size();
+  });
+}
+
+std::vector<size_t> dirWalker::preorder() const {
+  std::vector<size_t> order;
+  if (!tree) {
+    return order;
+  }
+  order.reserve(fileCount());
+  // Explicit stack: deep trees must not exhaust the call stack
+  std::vector<std::pair<const node*, size_t>> stack = { { tree.get(), 0 } };
+  while (!stack.empty()) {
+    auto& [current, position] = stack.back();
+    if (position == current->items.size()) {
+      stack.pop_back();
+      continue;
+    }
+    const node::item& entry = current->items[position++];
+    if (entry.isDirectory) {
+      stack.emplace_back(current->children[entry.index].get(), 0);
+    } else {
+      order.push_back(entry.index);
+    }
+  }
+  return order;
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ignoreRules;
+class threadPool;
+
+/**
+ * @class dirWalker
+ * @brief Finds the source files of a directory tree with raw getdents64 calls.
+ *
+ * Entries are classified by the d_type the kernel reports, so the common case costs no stat at
+ * all; only symbolic links and filesystems that report DT_UNKNOWN are stat'ed. Files are filtered
+ * by extension on the spot and handed to the visitor right away, never collected into a list.
+ *
+ * Without a pool the walk runs on the calling thread, in the order of a sequential recursive walk.
+ * With a pool every subdirectory becomes a task and the files of a directory are visited in
+ * batches spread over the workers; preorder() then tells the order a sequential walk would have
+ * visited them in. Like std::filesystem's default, symbolic links to directories are not followed.
+ *
+ * Entries matched by --exclude patterns or, when enabled, by the .gitignore files met on the way
+ * are dropped as soon as their directory is read: an ignored subdirectory is never opened.
+ */
+class dirWalker {
+public:
+  /** Visitor called with the path of a file and its discovery id. */
+  using visit_t = std::function<void(const std::string& filePath, size_t id)>;
+
+  /**
+   * @brief Creates a walker.
+   *
+   * @param isRecursive Whether to descend into subdirectories.
+   * @param pool Pool to walk and visit on, or nullptr to do everything on the calling thread.
+   */
+  dirWalker(bool isRecursive, threadPool* pool);
+  ~dirWalker();
+  dirWalker(const dirWalker&) = delete;
+  dirWalker& operator=(const dirWalker&) = delete;
+
+  /**
+   * @brief Sets which entries the walk skips.
+   *
+   * @param gitignore Honor the .gitignore files of the tree (and skip .git directories).
+   * @param patterns gitignore-style patterns relative to the walked directory.
+   */
+  void setFilters(bool gitignore, std::vector<std::string> patterns);
+
+  /**
+   * @brief Sets a visitor called with the path of every directory the walk reads.
+   *
+   * With a pool it runs concurrently on the workers.
+   *
+   * @param visitor Called once per directory, the walked one included.
+   */
+  void setDirectoryVisitor(std::function<void(const std::string&)> visitor);
+
+  /**
+   * @brief Walks a directory and visits every file with a supported extension.
+   *
+   * With a pool the visitor runs concurrently on the workers. Returns once every file was visited.
+   *
+   * @param root Directory to walk.
+   * @param visit Called once per file.
+   */
+  void walk(const std::string& root, const visit_t& visit);
+
+  /**
+   * @brief Gets the number of files visited by the last walk.
+   *
+   * @return Number of files; ids run from 0 to this number.
+   */
+  size_t fileCount() const { return nextId.load(); }
+
+  /**
+   * @brief Gets the ids of the files of the last walk in sequential walk order.
+   *
+   * @return File ids, directory entries first to last and each subdirectory where it was found.
+   */
+  std::vector<size_t> preorder() const;
+
+private:
+  struct node;
+
+  bool isRecursive;                 /**< Descend into subdirectories */
+  threadPool* pool;                 /**< Workers, or nullptr for a sequential walk */
+  std::unique_ptr<node> tree;       /**< Directories of the last walk */
+  std::atomic<size_t> nextId{ 0 };  /**< Next file id */
+  std::atomic<size_t> queuedFiles{ 0 }; /**< Files submitted but not yet visited */
+  bool respectGitignore = false;    /**< Honor .gitignore files */
+  std::vector<std::string> excludePatterns;   /**< Patterns given with --exclude */
+  std::shared_ptr<const ignoreRules> excludes; /**< excludePatterns compiled for the walk */
+  std::function<void(const std::string&)> directoryVisitor; /**< Called per directory read */
+
+  /**
+   * @brief Reads one directory, visiting its files and walking its subdirectories.
+   *
+   * @param dir Node of the directory; its entries are recorded into it.
+   * @param dirPath Path of the directory.
+   * @param visit Visitor of the walk.
+   * @param rules Patterns of the .gitignore files of the enclosing directories, or nullptr.
+   */
+  void walkDirectory(node& dir,
+                     const std::string& dirPath,
+                     const visit_t& visit,
+                     std::shared_ptr<const ignoreRules> rules);
+
+  /**
+   * @brief Checks if an entry is skipped by --exclude or by .gitignore patterns.
+   *
+   * @param path Path of the entry.
+   * @param isDirectory Whether the entry is a directory.
+   * @param rules Patterns of the .gitignore files that apply, or nullptr.
+   * @return True if the entry is skipped.
+   */
+  bool isExcluded(const std::string& path, bool isDirectory, const ignoreRules* rules) const;
+
+  /**
+   * @brief Visits a batch of files, on a worker unless too many files are already waiting.
+   *
+   * @param batch Paths and ids of the files.
+   * @param visit Visitor of the walk.
+   */
+  void visitBatch(std::vector<std::pair<std::string, size_t>>&& batch, const visit_t& visit);
+};
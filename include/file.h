@@ -1,12 +1,27 @@
 #pragma once
 
-#include <iomanip>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
-#include <sstream>
 #include <string>
+#include <string_view>
+#include "./language.h"
 
 using count_t = unsigned long;
 
+/**
+ * @brief Formats a percentage with one decimal, like printf's "%.1f%%" of part * 100.0 / total.
+ *
+ * The digits come from integer arithmetic; only an exact tie, where the result depends on how the
+ * double rounds, is left to snprintf. A total of zero gives "0%". Defined in tableWriter.cpp.
+ *
+ * @param out Receives the text (at least 32 bytes); it is not NUL-terminated.
+ * @param part Numerator.
+ * @param total Denominator.
+ * @return Number of characters written.
+ */
+size_t formatPercent(char* out, count_t part, count_t total);
+
 /**
  * @class File
  * @brief Class representing a file with information about its content.
@@ -17,30 +32,33 @@ using count_t = unsigned long;
 class File {
 private:
   std::string fileName; /**< File name */
-  std::string fileType; /**< File type (extension) */
+  langId language;      /**< File language */
   count_t nBlank;       /**< Number of blank lines */
   count_t nComments;    /**< Number of comment lines */
   count_t nCode;        /**< Number of code lines */
   count_t nLines;       /**< Total number of lines */
+  std::uint64_t ordinal = 0; /**< Position of the file in the output of an unsharded run */
+  bool skipped = false;      /**< Turned down by the content filter, not counted */
+  bool unreadable = false;   /**< Could not be opened, so its counts are zeros */
 
 public:
   /**
    * @brief Constructor for the File class.
    *
    * @param name File name.
-   * @param type File type (extension).
+   * @param type File language.
    * @param blankLines Number of blank lines.
    * @param comments Number of comment lines.
    * @param loc Number of code lines.
    * @param lines Total number of lines.
    */
   File(const std::string& name,
-       std::string type,
+       langId type,
        count_t blankLines,
        count_t comments,
        count_t loc,
        count_t lines)
-      : fileName(name), fileType(type), nBlank(blankLines), nComments(comments), nCode(loc),
+      : fileName(name), language(type), nBlank(blankLines), nComments(comments), nCode(loc),
         nLines(lines) {}
 
   /**
@@ -48,14 +66,21 @@ public:
    *
    * @return File name.
    */
-  std::string getFileName() const { return fileName; }
+  const std::string& getFileName() const { return fileName; }
 
   /**
    * @brief Gets the file type.
    *
-   * @return File type.
+   * @return Name of the file language.
    */
-  std::string getFileType() const { return fileType; }
+  std::string_view getFileType() const { return languageRegistry::name(language); }
+
+  /**
+   * @brief Gets the file language.
+   *
+   * @return Language identifier.
+   */
+  langId getLanguage() const { return language; }
 
   /**
    * @brief Gets the number of blank lines.
@@ -85,49 +110,72 @@ public:
    */
   count_t getLines() const { return nLines; }
 
+  /**
+   * @brief Gets the position of the file among all the files of the run, sharded or not.
+   * @return Ordinal of the file (see scanOptions::ordinalBase).
+   */
+  std::uint64_t getOrdinal() const { return ordinal; }
+
+  /**
+   * @brief Sets the position of the file among all the files of the run.
+   * @param position Ordinal of the file.
+   */
+  void setOrdinal(std::uint64_t position) { ordinal = position; }
+
+  /**
+   * @brief Tells if the content filter turned the file down (it is left out of the output).
+   * @return True if the file was not counted.
+   */
+  bool isSkipped() const { return skipped; }
+
+  /**
+   * @brief Marks the file as turned down by the content filter.
+   */
+  void setSkipped() { skipped = true; }
+
+  /**
+   * @brief Tells if the file could not be opened (its counts are zeros, not its content).
+   * @return True if the file was not read.
+   */
+  bool isUnreadable() const { return unreadable; }
+
+  /**
+   * @brief Marks the file as not opened.
+   */
+  void setUnreadable() { unreadable = true; }
+
   /**
    * @brief Gets the percentage of blank lines relative to total lines.
    *
    * @return Formatted string with the percentage of blank lines.
    */
-  std::string getPercentageBlank() const {
-    if (nLines == 0)
-      return "(0%)";
-    return formatPercentage((nBlank * 100.0) / nLines);
-  }
+  std::string getPercentageBlank() const { return formatPercentage(nBlank); }
 
   /**
    * @brief Gets the percentage of comment lines relative to total lines.
    *
    * @return Formatted string with the percentage of comment lines.
    */
-  std::string getPercentageComments() const {
-    if (nLines == 0)
-      return "(0%)";
-    return formatPercentage((nComments * 100.0) / nLines);
-  }
+  std::string getPercentageComments() const { return formatPercentage(nComments); }
 
   /**
    * @brief Gets the percentage of code lines relative to total lines.
    *
    * @return Formatted string with the percentage of code lines.
    */
-  std::string getPercentageCode() const {
-    if (nLines == 0)
-      return "(0%)";
-    return formatPercentage((nCode * 100.0) / nLines);
-  }
+  std::string getPercentageCode() const { return formatPercentage(nCode); }
 
 private:
   /**
-   * @brief Formats a value as a percentage.
+   * @brief Formats a count as a percentage of the total lines.
    *
-   * @param value Value to be formatted.
-   * @return Formatted string with the percentage value.
+   * @param part Count to be formatted.
+   * @return Formatted string with the percentage value, e.g. "(12.5%)".
    */
-  std::string formatPercentage(double value) const {
-    std::ostringstream out;
-    out << std::fixed << std::setprecision(1) << value;
-    return "(" + out.str() + "%)";
+  std::string formatPercentage(count_t part) const {
+    char text[40] = "(";
+    size_t length = 1 + formatPercent(text + 1, part, nLines);
+    text[length++] = ')';
+    return std::string(text, length);
   }
 };
@@ -0,0 +1,79 @@
+#include "./fileBuffer.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+fileBuffer::~fileBuffer() { release(); }
+
+void fileBuffer::release() {
+  if (mapping != nullptr) {
+    munmap(mapping, mappingLength);
+    mapping = nullptr;
+    mappingLength = 0;
+  }
+  bytes = nullptr;
+  length = 0;
+}
+
+bool fileBuffer::open(const std::string& filePath, size_t sizeLimit) {
+  release();
+  int fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat info {};
+  if (fstat(fd, &info) != 0) {
+    ::close(fd);
+    return false;
+  }
+
+  // Regular and large enough: map it
+  size_t expected = S_ISREG(info.st_mode) ? static_cast<size_t>(info.st_size) : 0;
+  if (expected > sizeLimit) {
+    ::close(fd);
+    length = expected;
+    return true;
+  }
+  if (expected >= MMAP_THRESHOLD) {
+    void* address = mmap(nullptr, expected, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address != MAP_FAILED) {
+      madvise(address, expected, MADV_SEQUENTIAL);
+      ::close(fd);
+      mapping = address;
+      mappingLength = expected;
+      bytes = static_cast<const char*>(address);
+      length = expected;
+      return true;
+    }
+  }
+
+  // Otherwise read it into the reusable buffer, growing it if the size hint was short
+  size_t used = 0;
+  if (storage.size() < expected + 1) {
+    storage.resize(expected + 1);
+  }
+  while (true) {
+    if (used == storage.size()) {
+      storage.resize(storage.size() * 2 + 4096);
+    }
+    ssize_t got = ::read(fd, storage.data() + used, storage.size() - used);
+    if (got < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      ::close(fd);
+      return false;
+    }
+    if (got == 0) {
+      break;
+    }
+    used += static_cast<size_t>(got);
+  }
+  ::close(fd);
+  bytes = storage.data();
+  length = used;
+  return true;
+}
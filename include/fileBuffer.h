@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @class fileBuffer
+ * @brief Read-only view over the whole content of a file.
+ *
+ * Large files are memory-mapped so their bytes are never copied. Small files, for which a mapping
+ * costs more than a copy, are read into a buffer that is kept and reused by the next open().
+ */
+class fileBuffer {
+private:
+  const char* bytes = nullptr; /**< Start of the file content */
+  size_t length = 0;           /**< Size of the file content */
+  void* mapping = nullptr;     /**< Active memory mapping, if any */
+  size_t mappingLength = 0;    /**< Size of the active mapping */
+  std::vector<char> storage;   /**< Reusable buffer for small files */
+
+public:
+  /** Files from this size on are memory-mapped instead of read. */
+  static constexpr size_t MMAP_THRESHOLD = 64 * 1024;
+
+  fileBuffer() = default;
+  ~fileBuffer();
+  fileBuffer(const fileBuffer&) = delete;
+  fileBuffer& operator=(const fileBuffer&) = delete;
+
+  /**
+   * @brief Loads a file, releasing the previous one.
+   *
+   * @param filePath Path of the file to be loaded.
+   * @return True on success, false if the file could not be opened or read.
+   */
+  bool open(const std::string& filePath) { return open(filePath, SIZE_MAX); }
+
+  /**
+   * @brief Loads a file unless it is larger than a limit, releasing the previous one.
+   *
+   * A larger regular file is left unread: data() is null and size() gives its size.
+   *
+   * @param filePath Path of the file to be loaded.
+   * @param sizeLimit Largest size loaded.
+   * @return True on success, false if the file could not be opened or read.
+   */
+  bool open(const std::string& filePath, size_t sizeLimit);
+
+  /**
+   * @brief Releases the current mapping (the reusable buffer is kept).
+   */
+  void release();
+
+  /**
+   * @brief Gets the file content.
+   *
+   * @return Pointer to the first byte of the file.
+   */
+  const char* data() const { return bytes; }
+
+  /**
+   * @brief Gets the file size.
+   *
+   * @return Number of bytes in the file.
+   */
+  size_t size() const { return length; }
+};
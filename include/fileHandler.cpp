@@ -1,12 +1,176 @@
 #include "./fileHandler.h"
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include "./archiveReader.h"
+#include "./contentFilter.h"
+#include "./contentHash.h"
+#include "./dedupTable.h"
+#include "./dirWalker.h"
 #include "./file.h"
+#include "./fileBuffer.h"
+#include "./fileList.h"
+#include "./ignoreRules.h"
+#include "./language.h"
+#include "./parallelLexer.h"
+#include "./readPipeline.h"
+#include "./resultCache.h"
+#include "./resultStore.h"
+#include "./sloc.h"
+#include "./threadPool.h"
+#include "./tracer.h"
 
-// Allowed types
-const std::vector<std::string> ALLOWED_EXTENSIONS = { "c", "cpp", "h", "hpp", "py" };
+namespace {
+
+// Bytes of archive entries unpacked and not counted yet
+constexpr size_t MAX_UNPACKED = 64 * 1024 * 1024;
+
+using result_t = std::pair<size_t, File>;
+
+// A file the content filter turned down: in its report, and left out of the output
+File skippedFile(const std::string& filePath, skipReason reason, contentFilter& filter) {
+  filter.record(filePath, reason);
+  File file(filePath, languageRegistry::fromPath(filePath), 0, 0, 0, 0);
+  file.setSkipped();
+  return file;
+}
+
+// Hands a file over unless the content filter turned it down
+std::function<void(const File&)> countedOnly(const std::function<void(const File&)>& sink) {
+  return [&sink](const File& file) {
+    if (!file.isSkipped()) {
+      sink(file);
+    }
+  };
+}
+
+// Hands a listed file over unless it was turned down or could not be opened (a stale list names
+// files gone since, which would otherwise be rows of zeros); countFile reported the latter
+std::function<void(const File&)> listedOnly(const std::function<void(const File&)>& sink) {
+  return [&sink](const File& file) {
+    if (!file.isSkipped() && !file.isUnreadable()) {
+      sink(file);
+    }
+  };
+}
+
+// Appends the results gathered by the workers in the order of their ids (ids of other shards lack)
+void appendInOrder(resultStore& Db, const std::vector<std::vector<result_t>>& localResults) {
+  std::vector<const File*> byId;
+  for (const auto& results : localResults) {
+    for (const auto& [id, file] : results) {
+      if (id >= byId.size()) {
+        byId.resize(id + 1, nullptr);
+      }
+      byId[id] = &file;
+    }
+  }
+  Db.reserve(Db.size() + byId.size());
+  for (const File* file : byId) {
+    if (file != nullptr && !file->isSkipped()) {
+      Db.append(*file);
+    }
+  }
+}
+
+// Hands results over in the order of their ids, holding back the ones that finish early
+class reorderBuffer {
+public:
+  explicit reorderBuffer(const std::function<void(const File&)>& destination)
+      : sink(destination) {}
+
+  void put(size_t id, const File& file) { settle(id, file); }
+
+  // Nothing comes for this id (a file of another shard)
+  void skip(size_t id) { settle(id, std::nullopt); }
+
+  // Blocks until id is less than window files ahead of the next one to hand over
+  void waitFor(size_t id, size_t window) {
+    std::unique_lock<std::mutex> guard(lock);
+    drained.wait(guard, [&] { return id - next < window; });
+  }
+
+private:
+  struct slot {
+    bool settled = false;
+    std::optional<File> file;
+  };
+  const std::function<void(const File&)>& sink;
+  std::mutex lock;
+  std::condition_variable drained;
+  std::deque<slot> waiting;  // Results of ids next, next + 1, ...
+  size_t next = 0;
+
+  void settle(size_t id, std::optional<File> file) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (id - next >= waiting.size()) {
+      waiting.resize(id - next + 1);
+    }
+    waiting[id - next] = { true, std::move(file) };
+    while (!waiting.empty() && waiting.front().settled) {
+      if (waiting.front().file.has_value()) {
+        sink(*waiting.front().file);
+      }
+      waiting.pop_front();
+      next++;
+    }
+    drained.notify_all();
+  }
+};
+
+// Counts the content of a file already in memory
+lineCounts countContent(langId language, const char* data, size_t size, dedupTable* dedup) {
+  lineCounts counts;
+  // Copies of a content already counted skip the lexer; the hash reads the bytes just loaded
+  std::uint64_t hash = 0;
+  if (dedup != nullptr) {
+    traceSpan hashSpan("hash", "lex");
+    hashSpan.setBytes(size);
+    hash = contentHash::hash(data, size);
+    if (dedup->lookup(hash, size, language, counts)) {
+      return counts;
+    }
+  }
+  traceSpan lexSpan("lex", "lex");
+  lexSpan.setBytes(size);
+  threadPool* pool = threadPool::current();
+  if (size >= parallelLexer::THRESHOLD && pool != nullptr && pool->size() > 1) {
+    // A large file alone would keep one worker busy while the others idle: split it
+    counts = parallelLexer::count(languageRegistry::tables(language), data, size, *pool);
+  } else {
+    counts = sloc::count(std::string_view(data, size), language);
+  }
+  if (dedup != nullptr) {
+    dedup->store(hash, size, language, counts);
+  }
+  return counts;
+}
+
+// Counts a file given on its own; a large one is counted on a pool, to lex its chunks in parallel
+File countAlone(const fileHandler& handler,
+                const std::string& filePath,
+                const scanOptions& options) {
+  std::error_code error;
+  File file(filePath, lang::UNDEF, 0, 0, 0, 0);
+  if (options.jobs == 1 || fs::file_size(filePath, error) < parallelLexer::THRESHOLD || error) {
+    file = handler.countFile(filePath, options);
+  } else {
+    threadPool pool(options.jobs);
+    pool.submit([&] { file = handler.countFile(filePath, options); });
+    pool.wait();
+  }
+  file.setOrdinal(options.ordinalBase);
+  return file;
+}
+
+}  // namespace
 
 fileHandler::fileHandler(const std::string& inputPath) : path(inputPath) {}
 
@@ -15,173 +179,543 @@ bool fileHandler::isValidPath() const { return fs::exists(path); }
 bool fileHandler::isDirectory() const { return fs::is_directory(path); }
 
 bool fileHandler::isValidExtension(const std::string& filePath) const {
-  size_t dotPos = filePath.rfind('.');
-  if (dotPos == std::string::npos)
-    return false;
+  // Check if the extension belongs to a known language.
+  return languageRegistry::fromPath(filePath) != lang::UNDEF;
+}
+
+// Processes a file to count the number of lines, blank lines, comment lines, and code lines
+File fileHandler::processFile(const std::string& filePath,
+                              dedupTable* dedup,
+                              contentFilter* filter) const {
+  // One buffer per thread, so small files reuse the same memory
+  thread_local fileBuffer buffer;
+
+  // Determine the language based on the extension
+  langId language = languageRegistry::fromPath(filePath);
 
-  std::string extension = filePath.substr(dotPos + 1);
-  std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+  traceSpan span("file", "file");
+  span.setDetail(filePath);
+  lineCounts counts;
+  bool opened;
+  {
+    traceSpan readSpan("read", "io");
+    // A file over the size limit is only stat'ed
+    opened = buffer.open(filePath, filter != nullptr ? filter->sizeLimit() : SIZE_MAX);
+    readSpan.setBytes(buffer.data() != nullptr ? buffer.size() : 0);
+  }
+  skipReason reason = opened && filter != nullptr ? filter->check(buffer.size(), buffer.data())
+                                                  : skipReason::NONE;
+  if (reason != skipReason::NONE) {
+    buffer.release();
+    return skippedFile(filePath, reason, *filter);
+  }
+  if (opened) {
+    span.setBytes(buffer.size());
+    counts = countContent(language, buffer.data(), buffer.size(), dedup);
+    buffer.release();
+  }
 
-  // Check if the extension is allowed.
-  return std::find(ALLOWED_EXTENSIONS.begin(), ALLOWED_EXTENSIONS.end(), extension)
-         != ALLOWED_EXTENSIONS.end();
+  File file(filePath, language, counts.blank, counts.comments, counts.code, counts.lines);
+  if (!opened) {
+    file.setUnreadable();
+  }
+  return file;
 }
 
-// Processes a file to count the number of lines, blank lines, comment lines, and code lines
-File fileHandler::processFile(const std::string& filePath) const {
-  std::fstream cfile(filePath);
-  using count_t = unsigned long;
-  bool inBlockComment = false;  // Bool to indicate if we're inside a block comment
-  bool inString = false;        // Bool to indicate if we're inside a string
-  count_t lineCount{};
-  count_t blankLines{};
-  count_t commentLines{};
-  count_t codeLines{};
-  std::string line{};
-
-  // Determine the file type based on the extension
-  size_t dotPos = filePath.rfind('.');
-  std::string fileType = "UNDEF";
-
-  if (dotPos != std::string::npos) {
-    std::string extension = filePath.substr(dotPos + 1);
-    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
-
-    if (extension == "c")
-      fileType = "C";
-    else if (extension == "py")
-      fileType = "PYTHON";
-    else if (extension == "cpp")
-      fileType = "CPP";
-    else if (extension == "h")
-      fileType = "H";
-    else if (extension == "hpp")
-      fileType = "HPP";
-  }
-
-  // If the file is open, start processing each line
-  if (cfile.is_open()) {
-    while (std::getline(cfile, line)) {
-      lineCount++;  // Increment the total line count
-
-      // Check if the line is blank (completely empty or just whitespace)
-      if (line.empty() || std::all_of(line.begin(), line.end(), isspace)) {
-        if (inBlockComment) {
-          // If we're in a block comment, count it as a comment line but do not increment blankLines
-          commentLines++;
-        } else {
-          blankLines++;  // Only count as a blank line if not in a block comment
-        }
-        continue;
-      }
+File fileHandler::countFile(const std::string& filePath, const scanOptions& options) const {
+  cacheKey key;
+  if (options.cache == nullptr || !resultCache::makeKey(filePath, key)) {
+    File file = processFile(filePath, options.dedup, options.filter);
+    if (file.isUnreadable()) {
+      *options.messages << (">>>> Error opening file: " + filePath + "\n");
+    }
+    return file;
+  }
+  if (options.filter != nullptr) {
+    // The key gives the size; the content checks cost one small read, even on a hit
+    skipReason reason = key.size > options.filter->sizeLimit() ? skipReason::SIZE
+                        : options.filter->readsContent()        ? options.filter->probe(filePath)
+                                                                : skipReason::NONE;
+    if (reason != skipReason::NONE) {
+      return skippedFile(filePath, reason, *options.filter);
+    }
+  }
 
-      bool hasCode = false;
-      bool hasComment = false;
-      size_t i = 0;
+  langId language = lang::UNDEF;
+  lineCounts counts;
+  bool hit;
+  {
+    traceSpan span("cache lookup", "file");
+    hit = options.cache->lookup(key, language, counts);
+  }
+  if (hit) {
+    return File(filePath, language, counts.blank, counts.comments, counts.code, counts.lines);
+  }
 
-      // Parse each character in the line to identify code, comments, or strings
-      while (i < line.size()) {
-        if (line[i] == '"') {
-          inString = !inString;  // Toggle the string state
-        }
+  File file = processFile(filePath, options.dedup);  // Checked by the filter above
+  if (file.isUnreadable()) {
+    *options.messages << (">>>> Error opening file: " + filePath + "\n");
+    return file;  // Not cached: a chmod keeps the key, and the zeros would stay
+  }
+  counts.blank = file.getBlankLines();
+  counts.comments = file.getComments();
+  counts.code = file.getnCodes();
+  counts.lines = file.getLines();
+  options.cache->store(key, filePath, file.getLanguage(), counts);
+  return file;
+}
 
-        if (!inString) {
-          // Detect line comments (//) and block comments (/* ... */)
-          if (!inBlockComment && line[i] == '/' && i + 1 < line.size()) {
-            if (line[i + 1] == '/') {  // Single-line comment
-              hasComment = true;
-              break;                          // The rest of the line is a comment
-            } else if (line[i + 1] == '*') {  // Start of a block comment
-              inBlockComment = true;
-              hasComment = true;
-              i += 2;  // Move past the beginning of the block comment
-              continue;
-            }
-          }
-
-          // If in a block comment, check if it ends in the current line
-          if (inBlockComment) {
-            size_t endBlockPos = line.find("*/", i);
-            if (endBlockPos != std::string::npos) {
-              inBlockComment = false;
-              hasComment = true;    // Block comment ended
-              i = endBlockPos + 2;  // Move past the end of the block comment
-              continue;
-            } else {
-              hasComment = true;  // The entire line is a block comment
-              break;
-            }
-          }
-
-          if (!isspace(line[i])) {
-            hasCode = true;  // Found code
-          }
-        }
+bool fileHandler::lookupCache(const std::string& filePath,
+                              const scanOptions& options,
+                              langId& language,
+                              lineCounts& counts) const {
+  cacheKey key;
+  if (options.cache == nullptr || !resultCache::makeKey(filePath, key)) {
+    return false;
+  }
+  traceSpan span("cache lookup", "file");
+  return options.cache->lookup(key, language, counts);
+}
 
-        i++;
-      }
+File fileHandler::countLoaded(const std::string& filePath,
+                              const char* data,
+                              size_t size,
+                              const scanOptions& options) const {
+  skipReason reason
+    = options.filter != nullptr ? options.filter->check(size, data) : skipReason::NONE;
+  if (reason != skipReason::NONE) {
+    return skippedFile(filePath, reason, *options.filter);
+  }
+  langId language = languageRegistry::fromPath(filePath);
+  traceSpan span("file", "file");
+  span.setDetail(filePath);
+  span.setBytes(size);
+  lineCounts counts = countContent(language, data, size, options.dedup);
+  cacheKey key;
+  if (options.cache != nullptr && resultCache::makeKey(filePath, key)) {
+    options.cache->store(key, filePath, language, counts);
+  }
+  return File(filePath, language, counts.blank, counts.comments, counts.code, counts.lines);
+}
 
-      // Final count: a line with both code and comment is counted for both
-      if (hasCode) {
-        codeLines++;
+bool fileHandler::walkAsync(const scanOptions& options,
+                            threadPool& pool,
+                            const std::function<void(size_t, const File&)>& result,
+                            const std::function<void(size_t)>& skipped) const {
+  using readStatus = readPipeline::readStatus;
+  readPipeline pipeline(pool, [&](const std::string& filePath, size_t id, const char* data,
+                                  size_t size, readStatus status) {
+    // Large files are mapped and failed ones reopened (to report the error) the usual way
+    File file = status == readStatus::OK ? countLoaded(filePath, data, size, options)
+                                         : countFile(filePath, options);
+    file.setOrdinal(options.ordinalBase + id);
+    result(id, file);
+  });
+  if (!pipeline.valid()) {
+    return false;
+  }
+
+  // The walk stays on this thread, so ids come in the order of a sequential walk
+  dirWalker walker(options.isRecursive, nullptr);
+  walker.setFilters(options.respectGitignore, options.excludes);
+  walker.walk(path, [&](const std::string& filePath, size_t id) {
+    if (!options.inShard(filePath)) {
+      if (skipped) {
+        skipped(id);
       }
-      if (hasComment) {
-        commentLines++;
+      return;
+    }
+    langId language = lang::UNDEF;
+    lineCounts counts;
+    if (lookupCache(filePath, options, language, counts)) {
+      // Unchanged files are not even opened
+      File file(filePath, language, counts.blank, counts.comments, counts.code, counts.lines);
+      file.setOrdinal(options.ordinalBase + id);
+      result(id, file);
+    } else {
+      pipeline.add(filePath, id);
+    }
+  });
+  pipeline.finish();
+  return true;
+}
+
+void fileHandler::countArchive(const scanOptions& options,
+                               threadPool* pool,
+                               const std::function<void(size_t, const File&)>& result) const {
+  // Entries are filtered like the files of a walk: by extension, then by --exclude
+  ignoreRules excludes(nullptr, "");
+  for (const std::string& pattern : options.excludes) {
+    excludes.add(pattern);
+  }
+  auto supported = [&](std::string_view name) {
+    if (languageRegistry::fromPath(name) == lang::UNDEF) {
+      return false;
+    }
+    for (size_t slash = name.find('/'); slash != std::string_view::npos;
+         slash = name.find('/', slash + 1)) {
+      if (excludes.isIgnored(name.substr(0, slash), true)) {
+        return false;  // As if the walk had pruned the directory
       }
     }
+    return !excludes.isIgnored(name, false);
+  };
+  // Entries of other shards still take their position; the next visit is of the last one wanted
+  size_t position = 0;
+  size_t wantedPosition = 0;
+  auto wanted = [&](std::string_view name) {
+    if (!supported(name)) {
+      return false;
+    }
+    wantedPosition = position++;
+    return options.shardCount == 1 || options.inShard(path + ':' + std::string(name));
+  };
+
+  // The archive is unpacked on a thread of its own, at most MAX_UNPACKED bytes ahead of counting
+  struct entry {
+    std::string name;
+    std::string content;
+    std::uint64_t ordinal;
+  };
+  std::mutex lock;
+  std::condition_variable changed;
+  std::deque<entry> queue;
+  size_t unpacked = 0;
+  bool done = false;
+  archiveReader archive(path);
+  bool read = true;
+  std::thread unpacker([&] {
+    read = archive.read(wanted, [&](std::string name, std::string content) {
+      std::unique_lock<std::mutex> guard(lock);
+      changed.wait(guard,
+                   [&] { return unpacked == 0 || unpacked + content.size() <= MAX_UNPACKED; });
+      unpacked += content.size();
+      queue.push_back(
+        { path + ':' + name, std::move(content), options.ordinalBase + wantedPosition });
+      changed.notify_all();
+    });
+    std::lock_guard<std::mutex> guard(lock);
+    done = true;
+    changed.notify_all();
+  });
 
-    // If the file ends while still in a block comment, increment comment lines
-    if (inBlockComment) {
-      commentLines++;
+  auto count = [&](size_t id, const entry& file) {
+    langId language = languageRegistry::fromPath(file.name);
+    traceSpan span("file", "file");
+    span.setDetail(file.name);
+    span.setBytes(file.content.size());
+    skipReason reason = options.filter != nullptr
+                          ? options.filter->check(file.content.size(), file.content.data())
+                          : skipReason::NONE;
+    lineCounts counts;
+    if (reason == skipReason::NONE) {
+      counts = countContent(language, file.content.data(), file.content.size(), options.dedup);
+    }
+    File counted
+      = reason == skipReason::NONE
+          ? File(file.name, language, counts.blank, counts.comments, counts.code, counts.lines)
+          : skippedFile(file.name, reason, *options.filter);
+    counted.setOrdinal(file.ordinal);
+    result(id, counted);
+    std::lock_guard<std::mutex> guard(lock);
+    unpacked -= file.content.size();
+    changed.notify_all();
+  };
+  for (size_t id = 0;; id++) {
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [&] { return !queue.empty() || done; });
+    if (queue.empty()) {
+      break;
+    }
+    auto file = std::make_shared<entry>(std::move(queue.front()));
+    queue.pop_front();
+    guard.unlock();
+    if (pool == nullptr) {
+      count(id, *file);
+    } else {
+      pool->submit([&count, id, file] { count(id, *file); });
     }
-  } else {
-    std::cerr << ">>>> Error opening file!\n";
+  }
+  unpacker.join();
+  if (pool != nullptr) {
+    pool->wait();
   }
 
-  return File(filePath, fileType, blankLines, commentLines, codeLines, lineCount);
+  if (!read) {
+    *options.messages << ">>>> Error: " << archive.error() << "\n";
+  }
+  if (archive.unreadable() > 0) {
+    *options.messages << ">>>> Warning: " << archive.unreadable() << " entries of " << path
+                      << " are encrypted or use an unsupported compression method\n";
+  }
 }
+
 std::vector<std::string> fileHandler::getFilesInDirectoryRecursive() const {
   std::vector<std::string> files;
-  for (const auto& entry : fs::recursive_directory_iterator(path)) {
-    if (fs::is_regular_file(entry.path())) {
-      files.push_back(entry.path().string());
-    }
-  }
+  dirWalker walker(true, nullptr);
+  walker.walk(path, [&files](const std::string& filePath, size_t) { files.push_back(filePath); });
   return files;
 }
 
 std::vector<std::string> fileHandler::getFilesInDirectory() const {
   std::vector<std::string> files;
-  for (const auto& entry : fs::directory_iterator(path)) {
-    if (fs::is_regular_file(entry.path())) {
-      files.push_back(entry.path().string());
+  dirWalker walker(false, nullptr);
+  walker.walk(path, [&files](const std::string& filePath, size_t) { files.push_back(filePath); });
+  return files;
+}
+
+void fileHandler::countDirectory(resultStore& Db, const scanOptions& options) const {
+  if (options.jobs == 1 && !options.asyncIo) {
+    // A sequential walk visits the files in order: append them as they come
+    dirWalker walker(options.isRecursive, nullptr);
+    walker.setFilters(options.respectGitignore, options.excludes);
+    walker.walk(path, [&](const std::string& filePath, size_t id) {
+      if (options.inShard(filePath)) {
+        File file = countFile(filePath, options);
+        file.setOrdinal(options.ordinalBase + id);
+        if (!file.isSkipped()) {
+          Db.append(file);
+        }
+      }
+    });
+    return;
+  }
+
+  threadPool pool(options.jobs);
+  std::vector<std::vector<result_t>> localResults(pool.size());
+
+  if (options.asyncIo) {
+    // One more buffer for the files the walking thread answers from the cache
+    localResults.resize(pool.size() + 1);
+    bool read = walkAsync(options, pool, [&](size_t id, const File& file) {
+      int worker = threadPool::currentWorker();
+      localResults[worker < 0 ? pool.size() : static_cast<size_t>(worker)].emplace_back(id, file);
+    });
+    if (read) {
+      appendInOrder(Db, localResults);
+      return;
     }
+    localResults.resize(pool.size());  // No io_uring: read on the workers instead
+  }
+
+  dirWalker walker(options.isRecursive, &pool);
+  walker.setFilters(options.respectGitignore, options.excludes);
+  walker.walk(path, [&](const std::string& filePath, size_t id) {
+    if (options.inShard(filePath)) {
+      localResults[threadPool::currentWorker()].emplace_back(id, countFile(filePath, options));
+    }
+  });
+
+  // Merge the worker buffers back into the order of a sequential walk
+  std::vector<File*> byId(walker.fileCount(), nullptr);
+  for (auto& results : localResults) {
+    for (auto& [id, file] : results) {
+      byId[id] = &file;
+    }
+  }
+  Db.reserve(Db.size() + byId.size());
+  std::uint64_t position = 0;
+  for (size_t id : walker.preorder()) {
+    File* file = byId[id];
+    if (file != nullptr && !file->isSkipped()) {
+      file->setOrdinal(options.ordinalBase + position);
+      Db.append(*file);
+    }
+    position++;
   }
-  return files;
 }
 
-void fileHandler::setFilesInDatabase(std::vector<File>& Db, bool isRecursive) const {
+void fileHandler::setFilesInDatabase(resultStore& Db, const scanOptions& options) const {
+  traceSpan span("scan", "phase");
+  span.setDetail(path);
   if (!isValidPath()) {
     return;
   }
-  std::vector<std::string> paths;
   // Check if it is a directory and set the mode
   if (isDirectory()) {
-    paths = isRecursive ? getFilesInDirectoryRecursive() : getFilesInDirectory();
+    countDirectory(Db, options);
+  }
+  // Archives are read in memory, entry by entry
+  else if (archiveReader::isArchive(path)) {
+    if (options.jobs == 1) {
+      countArchive(options, nullptr, [&Db](size_t, const File& file) {
+        if (!file.isSkipped()) {
+          Db.append(file);
+        }
+      });
+    } else {
+      threadPool pool(options.jobs);
+      std::vector<std::vector<result_t>> localResults(pool.size());
+      countArchive(options, &pool, [&](size_t id, const File& file) {
+        localResults[threadPool::currentWorker()].emplace_back(id, file);
+      });
+      appendInOrder(Db, localResults);
+    }
   }
   // Check if it is a file with a valid extension
   else if (isValidExtension(path)) {
-    paths.push_back(path);
+    if (options.inShard(path)) {
+      File file = countAlone(*this, path, options);
+      if (!file.isSkipped()) {
+        Db.append(file);
+      }
+    }
   }
   // If it is neither a valid directory nor a valid file, display an error.
   else {
-    std::cout << ">>>> Error: File with invalid extension: " << path << "\n";
+    *options.messages << ">>>> Error: File with invalid extension: " << path << "\n";
+  }
+}
+
+void fileHandler::streamFiles(const scanOptions& options,
+                              const std::function<void(const File&)>& destination) const {
+  auto sink = countedOnly(destination);
+  traceSpan span("scan", "phase");
+  span.setDetail(path);
+  if (!isValidPath()) {
+    return;
+  }
+  if (archiveReader::isArchive(path) && !isDirectory()) {
+    if (options.jobs == 1) {
+      countArchive(options, nullptr, [&sink](size_t, const File& file) { sink(file); });
+      return;
+    }
+    threadPool pool(options.jobs);
+    if (options.ordered) {
+      reorderBuffer inOrder(sink);
+      countArchive(options, &pool, [&](size_t id, const File& file) { inOrder.put(id, file); });
+      return;
+    }
+    std::mutex lock;
+    countArchive(options, &pool, [&](size_t, const File& file) {
+      std::lock_guard<std::mutex> guard(lock);
+      sink(file);
+    });
+    return;
+  }
+  if (!isDirectory()) {
+    if (!isValidExtension(path)) {
+      *options.messages << ">>>> Error: File with invalid extension: " << path << "\n";
+    } else if (options.inShard(path)) {
+      sink(countAlone(*this, path, options));
+    }
+    return;
+  }
+
+  if (options.jobs == 1 && !options.asyncIo) {
+    dirWalker walker(options.isRecursive, nullptr);
+    walker.setFilters(options.respectGitignore, options.excludes);
+    walker.walk(path, [&](const std::string& filePath, size_t id) {
+      if (options.inShard(filePath)) {
+        File file = countFile(filePath, options);
+        file.setOrdinal(options.ordinalBase + id);
+        sink(file);
+      }
+    });
+    return;
+  }
+
+  // The walker keeps a bounded number of files queued, so memory stays flat
+  threadPool pool(options.jobs);
+  if (options.ordered) {
+    reorderBuffer inOrder(sink);
+    auto skip = [&inOrder](size_t id) { inOrder.skip(id); };
+    if (options.asyncIo && walkAsync(options, pool, [&](size_t id, const File& file) {
+          inOrder.put(id, file);
+        }, skip)) {
+      return;
+    }
+    // Walked on this thread, so ids come in order; at most ORDER_WINDOW files are held back
+    dirWalker walker(options.isRecursive, nullptr);
+    walker.setFilters(options.respectGitignore, options.excludes);
+    walker.walk(path, [&](const std::string& filePath, size_t id) {
+      if (!options.inShard(filePath)) {
+        inOrder.skip(id);
+        return;
+      }
+      inOrder.waitFor(id, ORDER_WINDOW);
+      pool.submit([&, filePath, id] {
+        File file = countFile(filePath, options);
+        file.setOrdinal(options.ordinalBase + id);
+        inOrder.put(id, file);
+      });
+    });
+    pool.wait();
+    return;
+  }
+  std::mutex lock;
+  if (options.asyncIo && walkAsync(options, pool, [&](size_t, const File& file) {
+        std::lock_guard<std::mutex> guard(lock);
+        sink(file);
+      })) {
     return;
   }
-  // Process each found file
-  for (const auto& filePath : paths) {
-    if (isValidExtension(filePath)) {
-      Db.push_back(processFile(filePath));
+  dirWalker walker(options.isRecursive, &pool);
+  walker.setFilters(options.respectGitignore, options.excludes);
+  walker.walk(path, [&](const std::string& filePath, size_t) {
+    if (!options.inShard(filePath)) {
+      return;
     }
+    File file = countFile(filePath, options);
+    std::lock_guard<std::mutex> guard(lock);
+    sink(file);
+  });
+}
+
+void fileHandler::countList(char delimiter,
+                            const scanOptions& options,
+                            const std::function<void(const File&)>& destination) const {
+  auto sink = listedOnly(destination);
+  traceSpan span("scan", "phase");
+  span.setDetail(path);
+  fileList list(path, delimiter);
+  if (!list.open()) {
+    *options.messages << ">>>> Error: " << list.error() << "\n";
+    return;
   }
+
+  // Ids are positions among the supported entries, the ones of other shards included
+  std::string filePath;
+  if (options.jobs == 1) {
+    for (size_t id = 0; list.next(filePath);) {
+      if (!isValidExtension(filePath)) {
+        continue;
+      }
+      if (options.inShard(filePath)) {
+        File file = countFile(filePath, options);
+        file.setOrdinal(options.ordinalBase + id);
+        sink(file);
+      }
+      id++;
+    }
+  } else {
+    // The list is in the order of appearance: at most ORDER_WINDOW files are held back
+    threadPool pool(options.jobs);
+    reorderBuffer inOrder(sink);
+    for (size_t id = 0; list.next(filePath);) {
+      if (!isValidExtension(filePath)) {
+        continue;
+      }
+      if (!options.inShard(filePath)) {
+        inOrder.skip(id++);
+        continue;
+      }
+      inOrder.waitFor(id, ORDER_WINDOW);
+      pool.submit([&, filePath, id] {
+        File file = countFile(filePath, options);
+        file.setOrdinal(options.ordinalBase + id);
+        inOrder.put(id, file);
+      });
+      id++;
+    }
+    pool.wait();
+  }
+  if (!list.error().empty()) {
+    *options.messages << ">>>> Error: " << list.error() << "\n";
+  }
+}
+
+bool scanOptions::inShard(std::string_view filePath) const {
+  return shardCount <= 1
+         || contentHash::hash(filePath.data(), filePath.size()) % shardCount == shardIndex;
 }
@@ -1,13 +1,53 @@
 #pragma once
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "./file.h"
+#include "./lexer.h"
 
 namespace fs = std::filesystem;
 
+class contentFilter;
+class dedupTable;
+class resultCache;
+class threadPool;
+class resultStore;
+
+/**
+ * @struct scanOptions
+ * @brief Settings that control how files are discovered and counted.
+ */
+struct scanOptions {
+  bool isRecursive = false; /**< Look for files recursively */
+  unsigned jobs = 1;        /**< Number of counting threads (0 = one per hardware thread) */
+  resultCache* cache = nullptr; /**< Persistent result cache, if enabled */
+  std::ostream* messages = &std::cout; /**< Where the messages about skipped or unreadable
+                                            files go */
+  bool respectGitignore = false;       /**< Skip what .gitignore files ignore */
+  std::vector<std::string> excludes;   /**< gitignore-style patterns of entries to skip */
+  dedupTable* dedup = nullptr;         /**< Counts by content, if duplicates are skipped */
+  bool asyncIo = false;                /**< Read files through io_uring (see readPipeline) */
+  bool ordered = false;                /**< streamFiles keeps the order of a sequential walk */
+  unsigned shardIndex = 0;             /**< Shard counted, from 0 */
+  unsigned shardCount = 1;             /**< Number of shards the files are split into */
+  std::uint64_t ordinalBase = 0;       /**< Added to the position of each file of the path */
+  contentFilter* filter = nullptr;     /**< Turns down files before they are lexed, if enabled */
+
+  /**
+   * @brief Tells if a file belongs to the shard counted: the shard is its path hash modulo
+   * shardCount, so every machine that walks the same tree makes the same split.
+   *
+   * @param filePath Path of the file, as listed.
+   * @return True if the file is counted.
+   */
+  bool inShard(std::string_view filePath) const;
+};
+
 /**
  * @class fileHandler
  * @brief Class for handling file operations, including validation and processing.
@@ -20,6 +60,9 @@ private:
   std::string path; /**< Path to the input directory or file */
 
 public:
+  /** Files an ordered stream counts ahead of the first one it has not handed over yet. */
+  static constexpr size_t ORDER_WINDOW = 4096;
+
   /**
    * @brief Constructor for the fileHandler class.
    *
@@ -44,32 +87,154 @@ public:
   /**
    * @brief Processes a document from the specified path.
    *
+   * With a dedupTable, the content is hashed right after it is read and a copy of a content
+   * already counted takes its counts instead of being lexed. With a contentFilter, a file over
+   * its size limit is not read, and the first bytes of the others are checked before lexing.
+   *
    * @param filePath The path to the file to be processed.
-   * @return A File object containing information about the processed file.
+   * @param dedup Counts by content, or nullptr to lex every file.
+   * @param filter Checks before lexing, or nullptr to lex every file.
+   * @return A File object containing information about the processed file (see File::isSkipped
+   * and File::isUnreadable).
    */
-  File processFile(const std::string& filePath) const;
+  File processFile(const std::string& filePath,
+                   dedupTable* dedup = nullptr,
+                   contentFilter* filter = nullptr) const;
 
   /**
-   * @brief Searches for files in the specified directory recursively.
+   * @brief Counts a file, going through the result cache when one is enabled.
+   *
+   * On a cache hit the file is only stat'ed, never opened. A file that cannot be opened is not
+   * cached.
+   *
+   * @param filePath The path to the file to be counted.
+   * @param options Counting settings (the cache, if any).
+   * @return A File object containing information about the file.
+   */
+  File countFile(const std::string& filePath, const scanOptions& options) const;
+
+  /**
+   * @brief Looks a file up in the result cache, if one is enabled.
+   *
+   * @param filePath The path to the file.
+   * @param options Counting settings (the cache, if any).
+   * @param language Receives the language of the file on a hit.
+   * @param counts Receives the counts of the file on a hit.
+   * @return True on a hit.
+   */
+  bool lookupCache(const std::string& filePath,
+                   const scanOptions& options,
+                   langId& language,
+                   lineCounts& counts) const;
+
+  /**
+   * @brief Counts a file whose content was already read, and records it in the cache.
+   *
+   * @param filePath The path to the file.
+   * @param data Content of the file.
+   * @param size Size of the content.
+   * @param options Counting settings (cache, deduplication).
+   * @return A File object containing information about the file.
+   */
+  File countLoaded(const std::string& filePath,
+                   const char* data,
+                   size_t size,
+                   const scanOptions& options) const;
+
+  /**
+   * @brief Walks the directory on the calling thread and reads its files through a readPipeline.
+   *
+   * The files are counted on the pool as their reads complete, in no particular order; files found
+   * in the cache are answered on the calling thread.
+   *
+   * @param options Discovery and counting settings.
+   * @param pool Workers that count the files.
+   * @param result Called once per file with its discovery id.
+   * @param skipped Called instead, if set, with the id of each file of another shard.
+   * @return False, having done nothing, if io_uring is not available.
+   */
+  bool walkAsync(const scanOptions& options,
+                 threadPool& pool,
+                 const std::function<void(size_t, const File&)>& result,
+                 const std::function<void(size_t)>& skipped = nullptr) const;
+
+  /**
+   * @brief Counts the source files inside the archive (.tar, .tar.gz/.tgz, .zip) at the path.
+   *
+   * Nothing is extracted to disk: a thread unpacks the entries into memory while they are counted,
+   * on the pool if there is one. Entries are named "archive:path/in/archive" and filtered by
+   * extension and by the exclude patterns.
+   *
+   * @param options Counting settings (exclude patterns, deduplication).
+   * @param pool Workers that count the entries, or nullptr to count them on the calling thread.
+   * @param result Called once per entry with its position in the archive.
+   */
+  void countArchive(const scanOptions& options,
+                    threadPool* pool,
+                    const std::function<void(size_t, const File&)>& result) const;
+
+  /**
+   * @brief Searches for files with a supported extension in the directory, recursively.
    *
    * @return A vector of strings representing the paths of found files.
    */
   std::vector<std::string> getFilesInDirectoryRecursive() const;
 
   /**
-   * @brief Searches for files only in the specified directory.
+   * @brief Searches for files with a supported extension only in the specified directory.
    *
    * @return A vector of strings representing the paths of found files.
    */
   std::vector<std::string> getFilesInDirectory() const;
 
+  /**
+   * @brief Counts the files of the path and hands each result over as soon as it is ready.
+   *
+   * Nothing is accumulated: only a bounded number of files wait to be counted. With more than
+   * one job, sink is called under a lock and results arrive in completion order, or in the order
+   * of a sequential walk with options.ordered: the walk then stays on the calling thread and
+   * holds back the results that finish early, at most ORDER_WINDOW files ahead.
+   *
+   * @param options Discovery and counting settings.
+   * @param sink Called once per counted file.
+   */
+  void streamFiles(const scanOptions& options, const std::function<void(const File&)>& sink) const;
+
+  /**
+   * @brief Counts the files named by the list at the path ("-" for the standard input).
+   *
+   * The list is read on a thread of its own (see fileList) while its files are counted, on a
+   * thread pool with more than one job; sink receives them in the order of the list either way.
+   * Entries without a supported extension are skipped, as in a walk, and so are entries that
+   * cannot be opened (a stale list names files removed since), after a message.
+   *
+   * @param delimiter '\n' for one path per line, '\0' for NUL-terminated paths.
+   * @param options Counting settings (number of jobs, cache, deduplication).
+   * @param sink Called once per counted file.
+   */
+  void countList(char delimiter,
+                 const scanOptions& options,
+                 const std::function<void(const File&)>& sink) const;
+
   /**
    * @brief Main workflow to set files in the database.
    *
-   * @param Db Reference to a vector of File objects where the processed files will be stored.
-   * @param isRecursive Boolean flag to indicate if the search should be recursive.
+   * @param Db Reference to the store where the processed files will be appended.
+   * @param options Discovery and counting settings (recursion, number of jobs).
+   */
+  void setFilesInDatabase(resultStore& Db, const scanOptions& options) const;
+
+  /**
+   * @brief Counts the files of the directory while it is being walked.
+   *
+   * With more than one job, the walk and the counting share a work-stealing thread pool and every
+   * worker counts into its own buffer; the buffers are merged at the end so that Db receives the
+   * files in the order of a sequential walk, whatever the number of jobs.
+   *
+   * @param Db Reference to the store where the processed files will be appended.
+   * @param options Discovery and counting settings (recursion, number of jobs, cache).
    */
-  void setFilesInDatabase(std::vector<File>& Db, bool isRecursive) const;
+  void countDirectory(resultStore& Db, const scanOptions& options) const;
 
   /**
    * @brief Verifies if the file has a valid extension.
@@ -0,0 +1,97 @@
+#include "./fileList.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include "./tracer.h"
+
+fileList::fileList(std::string listSource, char entryDelimiter)
+    : source(std::move(listSource)), delimiter(entryDelimiter) {}
+
+fileList::~fileList() {
+  if (reader.joinable()) {
+    reader.join();
+  }
+  if (fd > STDIN_FILENO) {
+    ::close(fd);
+  }
+}
+
+bool fileList::open() {
+  fd = source == "-" ? STDIN_FILENO : ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    message = "cannot open the list " + source + ": " + std::strerror(errno);
+    return false;
+  }
+  reader = std::thread([this] { readAll(); });
+  return true;
+}
+
+void fileList::readAll() {
+  std::vector<char> block(READ_SIZE);
+  std::string partial;  // Entry split by the end of a block
+  std::string failure;
+  while (true) {
+    ssize_t got = ::read(fd, block.data(), block.size());
+    if (got < 0 && errno == EINTR) {
+      continue;
+    }
+    if (got < 0) {
+      failure = "cannot read the list " + source + ": " + std::strerror(errno);
+      break;
+    }
+    if (got == 0) {
+      break;
+    }
+    const char* start = block.data();
+    const char* end = start + got;
+    while (start < end) {
+      const void* found = std::memchr(start, delimiter, static_cast<size_t>(end - start));
+      if (found == nullptr) {
+        partial.append(start, end);
+        break;
+      }
+      const char* stop = static_cast<const char*>(found);
+      partial.append(start, stop);
+      push(std::move(partial));
+      partial.clear();
+      start = stop + 1;
+    }
+  }
+  push(std::move(partial));  // The last entry may lack its delimiter
+
+  std::lock_guard<std::mutex> guard(lock);
+  message = failure;
+  done = true;
+  changed.notify_all();
+}
+
+void fileList::push(std::string entry) {
+  if (delimiter == '\n' && !entry.empty() && entry.back() == '\r') {
+    entry.pop_back();
+  }
+  if (entry.empty()) {
+    return;
+  }
+  std::unique_lock<std::mutex> guard(lock);
+  changed.wait(guard, [this] { return queue.size() < QUEUE_PATHS; });
+  queue.push_back(std::move(entry));
+  changed.notify_all();
+}
+
+bool fileList::next(std::string& filePath) {
+  std::unique_lock<std::mutex> guard(lock);
+  if (queue.empty() && !done) {
+    traceSpan span("list wait", "io");  // The counting is ahead of the producer of the list
+    changed.wait(guard, [this] { return !queue.empty() || done; });
+  }
+  if (queue.empty()) {
+    return false;
+  }
+  filePath = std::move(queue.front());
+  queue.pop_front();
+  changed.notify_all();
+  return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * @class fileList
+ * @brief Reads a list of paths (one per line, or NUL-terminated) while its entries are counted.
+ *
+ * A reader thread reads the list in large blocks, splits it and hands the paths over through a
+ * bounded queue: the counting starts with the first path, a producer that is still writing the list
+ * (find, git ls-files) is never waited for as a whole, and a fast producer is held back instead of
+ * filling the memory. Empty entries are skipped, and a '\r' before a newline is dropped.
+ */
+class fileList {
+public:
+  /** Paths read ahead of the counting. */
+  static constexpr size_t QUEUE_PATHS = 4096;
+  /** Bytes asked for by each read of the list. */
+  static constexpr size_t READ_SIZE = 64 * 1024;
+
+  /**
+   * @brief Prepares to read a list.
+   *
+   * @param source Path of the list, or "-" for the standard input.
+   * @param delimiter '\n' or '\0'.
+   */
+  fileList(std::string source, char delimiter);
+
+  /**
+   * @brief Waits for the reader thread (the list must have been read to its end).
+   */
+  ~fileList();
+
+  fileList(const fileList&) = delete;
+  fileList& operator=(const fileList&) = delete;
+
+  /**
+   * @brief Opens the list and starts reading it.
+   *
+   * @return False if the list cannot be opened (see error()).
+   */
+  bool open();
+
+  /**
+   * @brief Takes the next path, waiting for the reader if the queue is empty.
+   *
+   * @param filePath Receives the path.
+   * @return False once the list is exhausted (or could not be read further, see error()).
+   */
+  bool next(std::string& filePath);
+
+  /**
+   * @brief Gets why the list could not be opened or read to its end.
+   *
+   * @return Description of the error, empty if there was none.
+   */
+  const std::string& error() const { return message; }
+
+private:
+  std::string source;            /**< Path of the list, or "-" */
+  char delimiter;                /**< End of an entry */
+  int fd = -1;                   /**< Descriptor of the list */
+  std::thread reader;            /**< Reads and splits the list */
+  std::mutex lock;               /**< Guards the fields below */
+  std::condition_variable changed; /**< Signals a new path, a taken path or the end */
+  std::deque<std::string> queue; /**< Paths read and not taken yet */
+  bool done = false;             /**< The reader has reached the end of the list */
+  std::string message;           /**< Error, written by the reader before done */
+
+  /**
+   * @brief Reads the whole list, queueing its entries.
+   */
+  void readAll();
+
+  /**
+   * @brief Queues an entry, waiting for room.
+   *
+   * @param entry The entry, without its delimiter.
+   */
+  void push(std::string entry);
+};
@@ -0,0 +1,233 @@
+#include "./ignoreRules.h"
+#include <fstream>
+#include <utility>
+
+namespace {
+
+// Matches a bracket expression at the start of pattern against c; advances pattern past it
+bool matchClass(std::string_view& pattern, char c, bool& valid) {
+  size_t position = 1;
+  bool negated
+    = position < pattern.size() && (pattern[position] == '!' || pattern[position] == '^');
+  if (negated) {
+    position++;
+  }
+  bool found = false;
+  bool first = true;
+  while (position < pattern.size() && (pattern[position] != ']' || first)) {
+    first = false;
+    char low = pattern[position];
+    if (low == '\\' && position + 1 < pattern.size()) {
+      low = pattern[++position];
+    }
+    char high = low;
+    if (position + 2 < pattern.size() && pattern[position + 1] == '-'
+        && pattern[position + 2] != ']') {
+      high = pattern[position + 2];
+      position += 2;
+    }
+    if (c >= low && c <= high) {
+      found = true;
+    }
+    position++;
+  }
+  valid = position < pattern.size();
+  if (!valid) {
+    return false;  // No closing bracket: the caller matches '[' literally
+  }
+  pattern.remove_prefix(position + 1);
+  return found != negated;
+}
+
+// Matches a gitignore glob against a path: `*` and `?` stop at '/', `**` does not
+bool matchGlob(std::string_view pattern, std::string_view text) {
+  while (!pattern.empty()) {
+    char c = pattern[0];
+    if (c == '*') {
+      if (pattern.size() >= 2 && pattern[1] == '*') {
+        pattern.remove_prefix(2);
+        if (pattern.empty()) {
+          return true;
+        }
+        if (pattern[0] == '/') {
+          // "**/" matches zero or more whole directories
+          pattern.remove_prefix(1);
+          for (size_t start = 0;;) {
+            if (matchGlob(pattern, text.substr(start))) {
+              return true;
+            }
+            size_t slash = text.find('/', start);
+            if (slash == std::string_view::npos) {
+              return false;
+            }
+            start = slash + 1;
+          }
+        }
+        for (size_t start = 0; start <= text.size(); start++) {
+          if (matchGlob(pattern, text.substr(start))) {
+            return true;
+          }
+        }
+        return false;
+      }
+      pattern.remove_prefix(1);
+      for (size_t start = 0; start <= text.size(); start++) {
+        if (matchGlob(pattern, text.substr(start))) {
+          return true;
+        }
+        if (start < text.size() && text[start] == '/') {
+          break;
+        }
+      }
+      return false;
+    }
+    if (text.empty() || (text[0] == '/' && (c == '?' || c == '['))) {
+      return false;
+    }
+    if (c == '?') {
+      pattern.remove_prefix(1);
+    } else if (c == '[') {
+      bool valid;
+      std::string_view rest = pattern;
+      bool found = matchClass(rest, text[0], valid);
+      if (valid) {
+        if (!found) {
+          return false;
+        }
+        pattern = rest;
+      } else {
+        if (text[0] != '[') {
+          return false;
+        }
+        pattern.remove_prefix(1);
+      }
+    } else {
+      if (c == '\\' && pattern.size() > 1) {
+        pattern.remove_prefix(1);
+        c = pattern[0];
+      }
+      if (text[0] != c) {
+        return false;
+      }
+      pattern.remove_prefix(1);
+    }
+    text.remove_prefix(1);
+  }
+  return text.empty();
+}
+
+bool hasWildcard(std::string_view text) {
+  return text.find_first_of("*?[\\") != std::string_view::npos;
+}
+
+}  // namespace
+
+ignoreRules::ignoreRules(std::shared_ptr<const ignoreRules> enclosing, std::string directory)
+  : parent(std::move(enclosing)), base(std::move(directory)) {}
+
+void ignoreRules::add(std::string_view line) {
+  if (!line.empty() && line.back() == '\r') {
+    line.remove_suffix(1);
+  }
+  // Trailing spaces do not count unless escaped
+  while (!line.empty() && line.back() == ' '
+         && !(line.size() >= 2 && line[line.size() - 2] == '\\')) {
+    line.remove_suffix(1);
+  }
+  if (line.empty() || line[0] == '#') {
+    return;
+  }
+
+  pattern rule{};
+  rule.negated = line[0] == '!';
+  if (rule.negated) {
+    line.remove_prefix(1);
+  } else if (line.size() >= 2 && line[0] == '\\' && (line[1] == '#' || line[1] == '!')) {
+    line.remove_prefix(1);
+  }
+  rule.directoryOnly = !line.empty() && line.back() == '/';
+  if (rule.directoryOnly) {
+    line.remove_suffix(1);
+  }
+  rule.anchored = line.find('/') != std::string_view::npos;
+  if (!line.empty() && line[0] == '/') {
+    line.remove_prefix(1);
+  }
+  if (line.empty()) {
+    return;
+  }
+  rule.text = std::string(line);
+
+  // The shapes most .gitignore lines have are matched without the glob matcher
+  if (!hasWildcard(line)) {
+    rule.how = kind::EXACT;
+    rule.literal = rule.text;
+  } else if (line[0] == '*' && line.size() > 1 && !hasWildcard(line.substr(1))
+             && line.find('/') == std::string_view::npos) {
+    rule.how = kind::SUFFIX;
+    rule.literal = std::string(line.substr(1));
+  } else if (line.back() == '*' && line.size() > 1
+             && !hasWildcard(line.substr(0, line.size() - 1))) {
+    rule.how = kind::PREFIX;
+    rule.literal = std::string(line.substr(0, line.size() - 1));
+  } else {
+    rule.how = kind::GLOB;
+  }
+  patterns.push_back(std::move(rule));
+}
+
+bool ignoreRules::addFile(const std::string& filePath) {
+  std::ifstream file(filePath);
+  if (!file) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    add(line);
+  }
+  return true;
+}
+
+int ignoreRules::match(std::string_view relative, bool isDirectory) const {
+  std::string_view name = relative.substr(relative.rfind('/') + 1);
+  for (auto rule = patterns.rbegin(); rule != patterns.rend(); ++rule) {
+    if (rule->directoryOnly && !isDirectory) {
+      continue;
+    }
+    std::string_view subject = rule->anchored ? relative : name;
+    bool matched = false;
+    switch (rule->how) {
+    case kind::EXACT:
+      matched = subject == rule->literal;
+      break;
+    case kind::SUFFIX:
+      matched = subject.size() >= rule->literal.size()
+                && subject.substr(subject.size() - rule->literal.size()) == rule->literal;
+      break;
+    case kind::PREFIX:
+      matched = subject.substr(0, rule->literal.size()) == rule->literal
+                && subject.find('/', rule->literal.size()) == std::string_view::npos;
+      break;
+    case kind::GLOB:
+      matched = matchGlob(rule->text, subject);
+      break;
+    }
+    if (matched) {
+      return rule->negated ? 0 : 1;
+    }
+  }
+  return -1;
+}
+
+bool ignoreRules::isIgnored(std::string_view path, bool isDirectory) const {
+  for (const ignoreRules* rules = this; rules != nullptr; rules = rules->parent.get()) {
+    if (path.size() <= rules->base.size()) {
+      continue;
+    }
+    int result = rules->match(path.substr(rules->base.size()), isDirectory);
+    if (result >= 0) {
+      return result == 1;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @class ignoreRules
+ * @brief The patterns of one .gitignore file (or of --exclude), compiled for fast matching.
+ *
+ * Patterns follow gitignore(5): `#` comments, `!` negation, a trailing `/` for directories only,
+ * a leading or inner `/` to anchor the pattern at the directory of the file, and the `*`, `?`,
+ * `[...]` and `**` wildcards. Patterns that are a plain name, `*.ext` or `name*` are matched with
+ * a single comparison; only the others go through the glob matcher.
+ *
+ * Rules chain to the rules of the parent directory: the last pattern that matches a path decides,
+ * and patterns of deeper directories win over those of shallower ones. Rules are immutable once
+ * built, so any number of threads may match against them.
+ */
+class ignoreRules {
+public:
+  /**
+   * @brief Creates an empty set of rules.
+   *
+   * @param parent Rules of the enclosing directory, or nullptr.
+   * @param base Directory the patterns are relative to, with a trailing slash.
+   */
+  ignoreRules(std::shared_ptr<const ignoreRules> parent, std::string base);
+
+  /**
+   * @brief Adds one pattern (a line of a .gitignore file).
+   *
+   * @param line The pattern; blank lines and comments are ignored.
+   */
+  void add(std::string_view line);
+
+  /**
+   * @brief Adds every pattern of a .gitignore file.
+   *
+   * @param filePath Path of the file.
+   * @return False if the file could not be read.
+   */
+  bool addFile(const std::string& filePath);
+
+  /**
+   * @brief Checks if a path is ignored by these rules or by those of the enclosing directories.
+   *
+   * @param path Path of the entry, starting with the base of these rules.
+   * @param isDirectory Whether the entry is a directory.
+   * @return True if the entry must be skipped.
+   */
+  bool isIgnored(std::string_view path, bool isDirectory) const;
+
+  /**
+   * @brief Checks if the rules hold no pattern, including those of the enclosing directories.
+   *
+   * @return True if nothing can be ignored.
+   */
+  bool empty() const { return patterns.empty() && (!parent || parent->empty()); }
+
+private:
+  /** How a pattern is matched. */
+  enum class kind { EXACT, SUFFIX, PREFIX, GLOB };
+
+  struct pattern {
+    std::string text;    /**< Pattern without `!`, the leading `/` and the trailing `/` */
+    std::string literal; /**< Literal part for EXACT, SUFFIX and PREFIX */
+    kind how;            /**< How the pattern is matched */
+    bool negated;        /**< `!`: the pattern re-includes what it matches */
+    bool directoryOnly;  /**< Trailing `/`: the pattern only matches directories */
+    bool anchored;       /**< Matched against the path relative to base, not the name only */
+  };
+
+  std::shared_ptr<const ignoreRules> parent; /**< Rules of the enclosing directory */
+  std::string base;                          /**< Directory the patterns are relative to */
+  std::vector<pattern> patterns;             /**< Patterns, in file order */
+
+  /**
+   * @brief Finds the last pattern of these rules that matches a path.
+   *
+   * @param relative Path relative to base.
+   * @param isDirectory Whether the entry is a directory.
+   * @return 1 if ignored, 0 if re-included, -1 if no pattern matched.
+   */
+  int match(std::string_view relative, bool isDirectory) const;
+};
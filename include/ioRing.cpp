@@ -0,0 +1,150 @@
+#include "./ioRing.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+template <typename T>
+T* at(void* base, std::uint32_t offset) {
+  return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+}  // namespace
+
+ioRing::ioRing(unsigned size) {
+#if defined(SYS_io_uring_setup)
+  struct io_uring_params params {};
+  int fd = static_cast<int>(syscall(SYS_io_uring_setup, size, &params));
+  if (fd < 0) {
+    return;
+  }
+
+  sqMappingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqMappingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool shared = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (shared) {
+    sqMappingSize = cqMappingSize = std::max(sqMappingSize, cqMappingSize);
+  }
+  sqMapping = mmap(nullptr, sqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                   IORING_OFF_SQ_RING);
+  if (sqMapping == MAP_FAILED) {
+    sqMapping = nullptr;
+    ::close(fd);
+    return;
+  }
+  if (shared) {
+    cqMapping = sqMapping;
+  } else {
+    cqMapping = mmap(nullptr, cqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     fd, IORING_OFF_CQ_RING);
+    if (cqMapping == MAP_FAILED) {
+      cqMapping = nullptr;
+      munmap(sqMapping, sqMappingSize);
+      sqMapping = nullptr;
+      ::close(fd);
+      return;
+    }
+  }
+  entriesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  void* sqes = mmap(nullptr, entriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                    IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    if (cqMapping != sqMapping) {
+      munmap(cqMapping, cqMappingSize);
+    }
+    munmap(sqMapping, sqMappingSize);
+    sqMapping = cqMapping = nullptr;
+    ::close(fd);
+    return;
+  }
+  entries = static_cast<struct io_uring_sqe*>(sqes);
+
+  sqHead = at<unsigned>(sqMapping, params.sq_off.head);
+  sqTail = at<unsigned>(sqMapping, params.sq_off.tail);
+  sqMask = *at<unsigned>(sqMapping, params.sq_off.ring_mask);
+  sqEntries = *at<unsigned>(sqMapping, params.sq_off.ring_entries);
+  sqArray = at<unsigned>(sqMapping, params.sq_off.array);
+  localTail = *sqTail;
+
+  cqHead = at<unsigned>(cqMapping, params.cq_off.head);
+  cqTail = at<unsigned>(cqMapping, params.cq_off.tail);
+  cqMask = *at<unsigned>(cqMapping, params.cq_off.ring_mask);
+  completions = at<struct io_uring_cqe>(cqMapping, params.cq_off.cqes);
+  ringFd = fd;
+#else
+  (void)size;
+#endif
+}
+
+ioRing::~ioRing() {
+  if (entries != nullptr) {
+    munmap(entries, entriesSize);
+  }
+  if (cqMapping != nullptr && cqMapping != sqMapping) {
+    munmap(cqMapping, cqMappingSize);
+  }
+  if (sqMapping != nullptr) {
+    munmap(sqMapping, sqMappingSize);
+  }
+  if (ringFd >= 0) {
+    ::close(ringFd);
+  }
+}
+
+bool ioRing::registerBuffers(const struct iovec* buffers, unsigned count) {
+#if defined(SYS_io_uring_register)
+  return syscall(SYS_io_uring_register, ringFd, IORING_REGISTER_BUFFERS, buffers, count) == 0;
+#else
+  return false;
+#endif
+}
+
+struct io_uring_sqe* ioRing::nextEntry() {
+  unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+  if (localTail - head >= sqEntries) {
+    return nullptr;
+  }
+  unsigned index = localTail & sqMask;
+  sqArray[index] = index;
+  localTail++;
+  struct io_uring_sqe* entry = &entries[index];
+  std::memset(entry, 0, sizeof(*entry));
+  return entry;
+}
+
+bool ioRing::submit(unsigned waitFor) {
+  // Publish the new entries before the kernel may look at the tail
+  __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+  // Whatever the kernel has not consumed yet, including entries an earlier call left behind
+  unsigned toSubmit = localTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+#if defined(SYS_io_uring_enter)
+  while (true) {
+    long result = syscall(SYS_io_uring_enter, ringFd, toSubmit, waitFor,
+                          waitFor > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+    if (result >= 0) {
+      return true;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    // EAGAIN/EBUSY: too many completions pending; the caller drains them and calls again
+    return errno == EAGAIN || errno == EBUSY;
+  }
+#else
+  return false;
+#endif
+}
+
+bool ioRing::nextCompletion(struct io_uring_cqe& completion) {
+  unsigned head = *cqHead;
+  if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+  completion = completions[head & cqMask];
+  __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
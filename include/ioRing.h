@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+
+/**
+ * @class ioRing
+ * @brief Minimal io_uring instance driven through the raw system calls (no liburing).
+ *
+ * Holds the submission and completion rings mapped from the kernel. It is meant for a single
+ * thread: that thread takes entries with nextEntry(), fills them, hands them to the kernel with
+ * submit() and drains the results with nextCompletion().
+ */
+class ioRing {
+public:
+  /**
+   * @brief Sets up a ring; check valid() before use.
+   *
+   * @param entries Size of the submission queue (rounded up to a power of two by the kernel).
+   */
+  explicit ioRing(unsigned entries);
+  ~ioRing();
+  ioRing(const ioRing&) = delete;
+  ioRing& operator=(const ioRing&) = delete;
+
+  /**
+   * @brief Checks if the kernel let the ring be set up (io_uring may be missing or disabled).
+   *
+   * @return True if the ring is usable.
+   */
+  bool valid() const { return ringFd >= 0; }
+
+  /**
+   * @brief Registers fixed buffers, so reads into them skip the per-call page pinning.
+   *
+   * @param buffers The buffers.
+   * @param count Number of buffers.
+   * @return False if the kernel refused them (plain reads still work).
+   */
+  bool registerBuffers(const struct iovec* buffers, unsigned count);
+
+  /**
+   * @brief Gets a zeroed submission entry to fill.
+   *
+   * @return The entry, or nullptr if the submission queue is full.
+   */
+  struct io_uring_sqe* nextEntry();
+
+  /**
+   * @brief Submits the filled entries and optionally waits for completions.
+   *
+   * @param waitFor Number of completions to wait for (0 returns at once).
+   * @return False on an unexpected error of io_uring_enter.
+   */
+  bool submit(unsigned waitFor);
+
+  /**
+   * @brief Takes the next completion, if any.
+   *
+   * @param completion Receives the completion.
+   * @return False if no completion is ready.
+   */
+  bool nextCompletion(struct io_uring_cqe& completion);
+
+private:
+  int ringFd = -1;                      /**< io_uring descriptor */
+  void* sqMapping = nullptr;            /**< Submission ring (also the completion ring if shared) */
+  size_t sqMappingSize = 0;
+  void* cqMapping = nullptr;            /**< Completion ring, when mapped on its own */
+  size_t cqMappingSize = 0;
+  struct io_uring_sqe* entries = nullptr; /**< Submission entries */
+  size_t entriesSize = 0;
+
+  unsigned* sqHead = nullptr;  /**< Advanced by the kernel as it consumes entries */
+  unsigned* sqTail = nullptr;  /**< Advanced by us as we publish entries */
+  unsigned sqMask = 0;
+  unsigned sqEntries = 0;
+  unsigned* sqArray = nullptr; /**< Indices of the published entries */
+  unsigned localTail = 0;      /**< Entries handed out, published on submit() */
+
+  unsigned* cqHead = nullptr;  /**< Advanced by us as we consume completions */
+  unsigned* cqTail = nullptr;  /**< Advanced by the kernel as it posts completions */
+  unsigned cqMask = 0;
+  struct io_uring_cqe* completions = nullptr;
+};
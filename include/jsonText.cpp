@@ -0,0 +1,33 @@
+#include "./jsonText.h"
+
+namespace jsonText {
+
+size_t utf8Length(const unsigned char* p, const unsigned char* end) {
+  unsigned char lead = p[0];
+  size_t length;
+  unsigned char low = 0x80, high = 0xBF;  // Range of the second byte
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    length = 2;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    length = 3;
+    low = lead == 0xE0 ? 0xA0 : 0x80;  // No overlong forms
+    high = lead == 0xED ? 0x9F : 0xBF; // No surrogates
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    length = 4;
+    low = lead == 0xF0 ? 0x90 : 0x80;
+    high = lead == 0xF4 ? 0x8F : 0xBF;
+  } else {
+    return 0;
+  }
+  if (static_cast<size_t>(end - p) < length || p[1] < low || p[1] > high) {
+    return 0;
+  }
+  for (size_t k = 2; k < length; k++) {
+    if (p[k] < 0x80 || p[k] > 0xBF) {
+      return 0;
+    }
+  }
+  return length;
+}
+
+}  // namespace jsonText
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+
+/**
+ * @namespace jsonText
+ * @brief Escaping of text for JSON documents, shared by the record formats and the trace.
+ */
+namespace jsonText {
+
+/**
+ * @brief Gets the length of the UTF-8 sequence at a position.
+ *
+ * @param p Start of the sequence.
+ * @param end End of the text.
+ * @return 2 to 4 for a valid multi-byte sequence, 0 if the bytes there are not valid UTF-8.
+ */
+size_t utf8Length(const unsigned char* p, const unsigned char* end);
+
+/**
+ * @brief Appends the body of a JSON string (without the quotes); bytes that are not UTF-8 become
+ * U+FFFD, so the output is valid JSON whatever the input.
+ *
+ * @param out Destination, with a text(std::string_view) member (e.g. a tableWriter).
+ * @param text Text to escape.
+ */
+template <typename Sink>
+void escape(Sink& out, std::string_view text) {
+  const auto* p = reinterpret_cast<const unsigned char*>(text.data());
+  const auto* end = p + text.size();
+  while (p < end) {
+    // Copy runs that need no escaping in one go
+    const unsigned char* run = p;
+    while (p < end && *p >= 0x20 && *p < 0x80 && *p != '"' && *p != '\\') {
+      p++;
+    }
+    out.text(std::string_view(reinterpret_cast<const char*>(run), static_cast<size_t>(p - run)));
+    if (p == end) {
+      break;
+    }
+    unsigned char c = *p;
+    if (c >= 0x80) {
+      size_t length = utf8Length(p, end);
+      if (length == 0) {
+        out.text("\\ufffd");
+        p++;
+      } else {
+        out.text(std::string_view(reinterpret_cast<const char*>(p), length));
+        p += length;
+      }
+      continue;
+    }
+    p++;
+    switch (c) {
+    case '"':
+      out.text("\\\"");
+      break;
+    case '\\':
+      out.text("\\\\");
+      break;
+    case '\n':
+      out.text("\\n");
+      break;
+    case '\r':
+      out.text("\\r");
+      break;
+    case '\t':
+      out.text("\\t");
+      break;
+    default: {
+      const char* hex = "0123456789abcdef";
+      char escaped[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+      out.text(std::string_view(escaped, sizeof(escaped)));
+    }
+    }
+  }
+}
+
+}  // namespace jsonText
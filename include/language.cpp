@@ -0,0 +1,474 @@
+#include "./language.h"
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Rules shared by the C family: `//`, `/* */`, escaped string and character literals
+constexpr languageSpec cFamily(std::string_view name, std::string_view extension) {
+  return languageSpec{ name,
+                       { extension },
+                       { "//" },
+                       { blockRule{ "/*", "*/" } },
+                       { quoteRule{ "\"" }, quoteRule{ "'" } } };
+}
+
+constexpr std::array<languageSpec, lang::BUILTIN_COUNT> LANGUAGES = {
+  languageSpec{ "UNDEF" },
+  cFamily("C", "c"),
+  cFamily("CPP", "cpp"),
+  cFamily("H", "h"),
+  cFamily("HPP", "hpp"),
+  // Triple-quoted strings that open a statement are docstrings, counted as comments
+  languageSpec{ "PYTHON",
+                { "py" },
+                { "#" },
+                { blockRule{ "\"\"\"", "\"\"\"", true }, blockRule{ "'''", "'''", true } },
+                { quoteRule{ "\"\"\"", true },
+                  quoteRule{ "'''", true },
+                  quoteRule{ "\"" },
+                  quoteRule{ "'" } } },
+  languageSpec{ "JAVA",
+                { "java" },
+                { "//" },
+                { blockRule{ "/*", "*/" } },
+                { quoteRule{ "\"\"\"", true }, quoteRule{ "\"" }, quoteRule{ "'" } } },
+  languageSpec{ "JAVASCRIPT",
+                { "js", "mjs", "cjs" },
+                { "//" },
+                { blockRule{ "/*", "*/" } },
+                { quoteRule{ "\"" }, quoteRule{ "'" }, quoteRule{ "`", true } } },
+  languageSpec{ "GO",
+                { "go" },
+                { "//" },
+                { blockRule{ "/*", "*/" } },
+                { quoteRule{ "\"" }, quoteRule{ "'" }, quoteRule{ "`", true, false } } },
+  // No quote rule for character literals, as a quote also starts lifetimes ('a, 'static); the
+  // ones holding a double quote are matched whole, so that it does not open a string
+  languageSpec{ "RUST",
+                { "rs" },
+                { "//" },
+                { blockRule{ "/*", "*/" } },
+                { quoteRule{ "\"", true } },
+                { "'\"'", "'\\\"'" } },
+};
+
+// Every table is built by the compiler; nothing is computed at startup
+template <size_t... I>
+constexpr std::array<lexTables, sizeof...(I)> makeAllTables(std::index_sequence<I...>) {
+  return { { makeLexTables(LANGUAGES[I])... } };
+}
+
+constexpr std::array<lexTables, lang::BUILTIN_COUNT> TABLES
+  = makeAllTables(std::make_index_sequence<lang::BUILTIN_COUNT>{});
+
+static_assert(TABLES[lang::C].action[lexMode::CODE]['/'] == lexAction::TOKEN);
+static_assert(TABLES[lang::PYTHON].action[lexMode::CODE]['/'] == lexAction::CODE);
+static_assert(TABLES[lang::PYTHON].tokens[lexMode::CODE][0].length == 3);
+static_assert(TABLES[lang::RUST].tokens[lexMode::CODE][0].length == 4);  // '\"' before '"' and "
+static_assert(TABLES[lang::RUST].tokens[lexMode::CODE][1].nextMode == lexMode::CODE);
+static_assert(TABLES[lang::RUST].action[lexMode::STRING]['\''] == lexAction::STRING);
+
+// Case-insensitive comparison against a lower-case extension
+bool sameExtension(std::string_view extension, std::string_view lowered) {
+  if (extension.size() != lowered.size()) {
+    return false;
+  }
+  for (size_t k = 0; k < extension.size(); k++) {
+    char c = extension[k];
+    if (c >= 'A' && c <= 'Z') {
+      c = static_cast<char>(c - 'A' + 'a');
+    }
+    if (c != lowered[k]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// FNV-1a of the lower-cased text
+std::uint64_t hashLowered(std::string_view text) {
+  std::uint64_t hash = 0xcbf29ce484222325ull;
+  for (char c : text) {
+    if (c >= 'A' && c <= 'Z') {
+      c = static_cast<char>(c - 'A' + 'a');
+    }
+    hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+// Spreads the bits of a hash, so that its low bits can index a table
+std::uint64_t mix(std::uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+std::uint64_t slotHash(std::uint64_t hash, std::uint32_t seed) {
+  return mix(hash + seed * 0x9e3779b97f4a7c15ull);
+}
+
+/**
+ * Perfect hash of the extensions ("hash and displace"): the hash picks a bucket, and the seed of
+ * the bucket, chosen when the table is built, sends each of its keys to a slot of its own.
+ */
+class extensionIndex {
+public:
+  void build(const std::unordered_map<std::string, langId>& extensions) {
+    keys.clear();
+    std::vector<std::pair<std::string_view, langId>> entries;
+    std::vector<std::uint64_t> hashes;
+    for (const auto& [extension, id] : extensions) {
+      entries.emplace_back(extension, id);
+      hashes.push_back(hashLowered(extension));
+    }
+    for (size_t slotCount = 16;; slotCount *= 2) {
+      if (slotCount >= 2 * entries.size() && tryBuild(entries, hashes, slotCount)) {
+        return;
+      }
+    }
+  }
+
+  langId find(std::string_view extension) const {
+    std::uint64_t hash = hashLowered(extension);
+    std::uint32_t seed = seeds[mix(hash) & (seeds.size() - 1)];
+    const slot& candidate = slots[slotHash(hash, seed) & (slots.size() - 1)];
+    return candidate.hash == hash
+               && sameExtension(extension, std::string_view(keys).substr(candidate.offset,
+                                                                          candidate.length))
+             ? candidate.id
+             : lang::UNDEF;
+  }
+
+private:
+  struct slot {
+    std::uint64_t hash = 0;   // hashLowered of the key
+    std::uint32_t offset = 0; // Key in keys
+    std::uint16_t length = 0;
+    langId id = lang::UNDEF;  // UNDEF for a free slot
+  };
+  std::vector<std::uint32_t> seeds; // Per bucket
+  std::vector<slot> slots;
+  std::string keys;                 // Lower-case keys, end to end
+
+  bool tryBuild(const std::vector<std::pair<std::string_view, langId>>& entries,
+                const std::vector<std::uint64_t>& hashes,
+                size_t slotCount) {
+    size_t bucketCount = 1;
+    while (bucketCount * 2 <= entries.size()) {
+      bucketCount *= 2;
+    }
+    // Keys grouped by bucket (counting sort), buckets ordered by size, fullest first
+    std::vector<std::uint32_t> start(bucketCount + 1, 0);
+    for (std::uint64_t hash : hashes) {
+      start[(mix(hash) & (bucketCount - 1)) + 1]++;
+    }
+    std::vector<std::uint32_t> sizes(start.begin() + 1, start.end());
+    for (size_t b = 0; b < bucketCount; b++) {
+      start[b + 1] += start[b];
+    }
+    std::vector<std::uint32_t> grouped(entries.size());
+    std::vector<std::uint32_t> fill(start.begin(), start.end() - 1);
+    for (std::uint32_t k = 0; k < entries.size(); k++) {
+      grouped[fill[mix(hashes[k]) & (bucketCount - 1)]++] = k;
+    }
+    std::vector<std::uint32_t> order;
+    for (std::uint32_t b = 0; b < bucketCount; b++) {
+      if (sizes[b] > 0) {
+        order.push_back(b);
+      }
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](std::uint32_t a, std::uint32_t b) { return sizes[a] > sizes[b]; });
+
+    // Fullest buckets first, while most slots are free
+    seeds.assign(bucketCount, 0);
+    slots.assign(slotCount, slot{});
+    keys.clear();
+    std::array<size_t, 16> taken{};
+    for (std::uint32_t b : order) {
+      size_t count = sizes[b];
+      if (count > taken.size()) {
+        return false;
+      }
+      bool placed = false;
+      for (std::uint32_t seed = 1; seed < 4096 && !placed; seed++) {
+        placed = true;
+        for (size_t i = 0; i < count && placed; i++) {
+          size_t at = slotHash(hashes[grouped[start[b] + i]], seed) & (slotCount - 1);
+          placed = slots[at].id == lang::UNDEF
+                   && std::find(taken.begin(), taken.begin() + i, at) == taken.begin() + i;
+          taken[i] = at;
+        }
+        if (placed) {
+          seeds[b] = seed;
+          for (size_t i = 0; i < count; i++) {
+            const auto& [key, id] = entries[grouped[start[b] + i]];
+            slots[taken[i]] = { hashes[grouped[start[b] + i]],
+                                static_cast<std::uint32_t>(keys.size()),
+                                static_cast<std::uint16_t>(key.size()),
+                                id };
+            keys += key;
+          }
+        }
+      }
+      if (!placed) {
+        return false;  // Unlucky: the caller retries with more slots
+      }
+    }
+    return true;
+  }
+};
+
+// A language of a configuration file
+struct userLanguage {
+  std::string name;
+  lexTables tables;
+};
+
+struct registryState {
+  std::vector<userLanguage> languages;               // Identifiers from BUILTIN_COUNT on
+  std::unordered_map<std::string, langId> keys;      // Extensions, later ones winning
+  extensionIndex index;
+  std::uint32_t rulesVersion = LEX_RULES_VERSION;
+};
+
+// Adds or moves an extension, then leaves the index to be rebuilt
+void setExtension(registryState& state, std::string extension, langId id) {
+  for (char& c : extension) {
+    if (c >= 'A' && c <= 'Z') {
+      c = static_cast<char>(c - 'A' + 'a');
+    }
+  }
+  state.keys[std::move(extension)] = id;
+}
+
+registryState& registry() {
+  static registryState state = [] {
+    registryState built;
+    for (langId id = 1; id < lang::BUILTIN_COUNT; id++) {
+      for (std::string_view extension : LANGUAGES[id].extensions) {
+        if (!extension.empty()) {
+          setExtension(built, std::string(extension), id);
+        }
+      }
+    }
+    built.index.build(built.keys);
+    return built;
+  }();
+  return state;
+}
+
+std::vector<std::string> splitWords(std::string_view text) {
+  std::vector<std::string> words;
+  size_t position = 0;
+  while (position < text.size()) {
+    size_t start = text.find_first_not_of(" \t", position);
+    if (start == std::string_view::npos) {
+      break;
+    }
+    size_t end = std::min(text.find_first_of(" \t", start), text.size());
+    words.emplace_back(text.substr(start, end - start));
+    position = end;
+  }
+  return words;
+}
+
+std::string_view trim(std::string_view text) {
+  while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty()
+         && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r')) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+// A language being read from a configuration file; spec points into the strings it owns
+struct pendingLanguage {
+  std::string name;
+  std::vector<std::string> extensions;
+  std::deque<std::string> strings;
+  languageSpec spec{};
+  size_t lineCount = 0;
+  size_t blockCount = 0;
+  size_t quoteCount = 0;
+  size_t line = 0;  // Line of its header
+};
+
+// Checks and stores the values of a key of a section; returns an error, or an empty string
+std::string addValues(pendingLanguage& language,
+                      std::string_view key,
+                      std::vector<std::string> words) {
+  for (const std::string& word : words) {
+    if (key != "extensions" && word.size() > 4) {
+      return "delimiter longer than 4 bytes: " + word;
+    }
+  }
+  if (key == "extensions") {
+    for (std::string& word : words) {
+      if (!word.empty() && word[0] == '.') {
+        word.erase(0, 1);
+      }
+      if (word.empty()) {
+        return "empty extension";
+      }
+      language.extensions.push_back(std::move(word));
+    }
+  } else if (key == "line") {
+    for (std::string& word : words) {
+      if (language.lineCount == language.spec.lineComments.size()) {
+        return "more than 2 line comment tokens";
+      }
+      language.spec.lineComments[language.lineCount++]
+        = language.strings.emplace_back(std::move(word));
+    }
+  } else if (key == "block") {
+    if (words.size() % 2 != 0) {
+      return "block takes pairs of open and close delimiters";
+    }
+    for (size_t k = 0; k < words.size(); k += 2) {
+      if (language.blockCount == language.spec.blocks.size()) {
+        return "more than 2 block comments";
+      }
+      blockRule& block = language.spec.blocks[language.blockCount++];
+      block.open = language.strings.emplace_back(std::move(words[k]));
+      block.close = language.strings.emplace_back(std::move(words[k + 1]));
+    }
+  } else if (key == "string" || key == "multiline_string" || key == "raw_string") {
+    for (std::string& word : words) {
+      if (language.quoteCount == language.spec.quotes.size()) {
+        return "more than 4 string delimiters";
+      }
+      quoteRule& quote = language.spec.quotes[language.quoteCount++];
+      quote.delimiter = language.strings.emplace_back(std::move(word));
+      quote.multiline = key != "string";
+      quote.escapes = key != "raw_string";
+    }
+  } else {
+    return "unknown key: " + std::string(key);
+  }
+  return "";
+}
+
+}  // namespace
+
+langId languageRegistry::fromExtension(std::string_view extension) {
+  return registry().index.find(extension);
+}
+
+langId languageRegistry::fromPath(std::string_view filePath) {
+  size_t dotPos = filePath.rfind('.');
+  if (dotPos == std::string_view::npos) {
+    return lang::UNDEF;
+  }
+  return fromExtension(filePath.substr(dotPos + 1));
+}
+
+std::string_view languageRegistry::name(langId id) {
+  if (id < lang::BUILTIN_COUNT) {
+    return LANGUAGES[id].name;
+  }
+  const registryState& state = registry();
+  return id - lang::BUILTIN_COUNT < static_cast<int>(state.languages.size())
+           ? std::string_view(state.languages[id - lang::BUILTIN_COUNT].name)
+           : LANGUAGES[lang::UNDEF].name;
+}
+
+const lexTables& languageRegistry::tables(langId id) {
+  if (id != lang::UNDEF && id < lang::BUILTIN_COUNT) {
+    return TABLES[id];
+  }
+  const registryState& state = registry();
+  return id >= lang::BUILTIN_COUNT
+             && id - lang::BUILTIN_COUNT < static_cast<int>(state.languages.size())
+           ? state.languages[id - lang::BUILTIN_COUNT].tables
+           : TABLES[lang::C];
+}
+
+langId languageRegistry::count() {
+  return static_cast<langId>(lang::BUILTIN_COUNT + registry().languages.size());
+}
+
+bool languageRegistry::loadFile(const std::string& filePath, std::string& error) {
+  std::ifstream file(filePath, std::ios::binary);
+  if (!file) {
+    error = "cannot read " + filePath;
+    return false;
+  }
+  std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  std::deque<pendingLanguage> found;
+  size_t lineNumber = 0;
+  for (size_t start = 0; start < content.size();) {
+    size_t end = std::min(content.find('\n', start), content.size());
+    std::string_view text = trim(std::string_view(content).substr(start, end - start));
+    start = end + 1;
+    lineNumber++;
+    auto fail = [&](const std::string& what) {
+      error = filePath + ":" + std::to_string(lineNumber) + ": " + what;
+      return false;
+    };
+    if (text.empty() || text[0] == '#') {
+      continue;
+    }
+    if (text.front() == '[') {
+      if (text.back() != ']' || trim(text.substr(1, text.size() - 2)).empty()) {
+        return fail("expected [NAME]");
+      }
+      pendingLanguage& language = found.emplace_back();
+      language.name = std::string(trim(text.substr(1, text.size() - 2)));
+      language.line = lineNumber;
+      continue;
+    }
+    size_t equals = text.find('=');
+    if (equals == std::string_view::npos) {
+      return fail("expected key = values");
+    }
+    if (found.empty()) {
+      return fail("key outside a [NAME] section");
+    }
+    std::string problem = addValues(found.back(), trim(text.substr(0, equals)),
+                                    splitWords(text.substr(equals + 1)));
+    if (!problem.empty()) {
+      return fail(problem);
+    }
+  }
+
+  registryState& state = registry();
+  if (lang::BUILTIN_COUNT + state.languages.size() + found.size() > 255) {
+    error = filePath + ": too many languages";
+    return false;
+  }
+  for (const pendingLanguage& language : found) {
+    if (language.extensions.empty()) {
+      error = filePath + ":" + std::to_string(language.line) + ": [" + language.name
+              + "] has no extensions";
+      return false;
+    }
+  }
+
+  // Everything is valid: compile the languages and the new index
+  std::uint64_t fingerprint = hashLowered(content);
+  for (pendingLanguage& language : found) {
+    auto id = static_cast<langId>(lang::BUILTIN_COUNT + state.languages.size());
+    state.languages.push_back({ language.name, makeLexTables(language.spec) });
+    for (std::string& extension : language.extensions) {
+      setExtension(state, std::move(extension), id);
+    }
+  }
+  state.index.build(state.keys);
+  state.rulesVersion = static_cast<std::uint32_t>(mix(state.rulesVersion ^ fingerprint)) | 1u << 31;
+  return true;
+}
+
+std::uint32_t languageRegistry::rulesVersion() { return registry().rulesVersion; }
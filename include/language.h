@@ -0,0 +1,287 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/** Small integer identifying a language of the registry. */
+using langId = std::uint8_t;
+
+/**
+ * @namespace lang
+ * @brief Identifiers of the built-in languages.
+ */
+namespace lang {
+constexpr langId UNDEF = 0;
+constexpr langId C = 1;
+constexpr langId CPP = 2;
+constexpr langId H = 3;
+constexpr langId HPP = 4;
+constexpr langId PYTHON = 5;
+constexpr langId JAVA = 6;
+constexpr langId JAVASCRIPT = 7;
+constexpr langId GO = 8;
+constexpr langId RUST = 9;
+constexpr langId BUILTIN_COUNT = 10; /**< Number of built-in identifiers, UNDEF included */
+}  // namespace lang
+
+/** Version of the counting rules; bump it whenever a change alters the counts of some file. */
+constexpr std::uint32_t LEX_RULES_VERSION = 2;
+
+/**
+ * @struct quoteRule
+ * @brief A string or character literal: same delimiter on both ends.
+ */
+struct quoteRule {
+  std::string_view delimiter; /**< Opening and closing delimiter, e.g. `"` or `"""` */
+  bool multiline = false;     /**< Whether the literal may span lines without escaping the newline */
+  bool escapes = true;        /**< Whether a backslash escapes the next character */
+};
+
+/**
+ * @struct blockRule
+ * @brief A block comment.
+ */
+struct blockRule {
+  std::string_view open;      /**< Opening delimiter, e.g. slash-star */
+  std::string_view close;     /**< Closing delimiter, e.g. star-slash */
+  bool lineStartOnly = false; /**< Only opens when nothing but whitespace precedes it (docstrings) */
+};
+
+/**
+ * @struct languageSpec
+ * @brief Declarative description of the lexical rules of a language.
+ */
+struct languageSpec {
+  std::string_view name;                        /**< Name shown in the Language column */
+  std::array<std::string_view, 4> extensions;   /**< Lower-case extensions, without the dot */
+  std::array<std::string_view, 2> lineComments; /**< Tokens that comment out the rest of the line */
+  std::array<blockRule, 2> blocks;              /**< Block comments */
+  std::array<quoteRule, 4> quotes;              /**< Literals, longest delimiters first */
+  std::array<std::string_view, 2> literals;     /**< Whole literals that hold a delimiter, lexed as
+                                                     code (e.g. '"', whose quote opens no string) */
+};
+
+/**
+ * @namespace lexMode
+ * @brief States of the table-driven lexer.
+ */
+namespace lexMode {
+constexpr std::uint8_t CODE = 0;
+constexpr std::uint8_t LINE_COMMENT = 1;
+constexpr std::uint8_t BLOCK = 2;  /**< First of two block comment modes */
+constexpr std::uint8_t STRING = 4; /**< First of four literal modes */
+constexpr std::uint8_t COUNT = 8;
+}  // namespace lexMode
+
+/**
+ * @namespace lexAction
+ * @brief What the lexer does with a byte in a given mode.
+ */
+namespace lexAction {
+constexpr std::uint8_t CODE = 0;    /**< Non-blank byte of code */
+constexpr std::uint8_t COMMENT = 1; /**< Non-blank byte inside a comment */
+constexpr std::uint8_t STRING = 2;  /**< Non-blank byte inside a literal */
+constexpr std::uint8_t SPACE = 3;   /**< Whitespace other than newline */
+constexpr std::uint8_t NEWLINE = 4; /**< End of line */
+constexpr std::uint8_t TOKEN = 5;   /**< May start a delimiter: try the mode's tokens */
+constexpr std::uint8_t ESCAPE = 6;  /**< Backslash inside an escaping literal */
+}  // namespace lexAction
+
+/**
+ * @struct lexToken
+ * @brief A delimiter recognized in some mode, and the mode it switches to.
+ */
+struct lexToken {
+  char text[4] = {};          /**< Delimiter bytes */
+  std::uint8_t length = 0;    /**< Delimiter length */
+  std::uint8_t nextMode = 0;  /**< Mode entered after the delimiter */
+  bool lineStartOnly = false; /**< Only matches before any code on the line */
+};
+
+/**
+ * @struct lexTables
+ * @brief Transition tables compiled from a languageSpec.
+ *
+ * For every mode, action maps each byte to what the lexer does with it; tokens lists the delimiters
+ * to try on a TOKEN byte, and skipSet holds the bytes a mode cannot skip over, so the lexer can
+ * jump past runs of uninteresting bytes with a vectorized search.
+ */
+struct lexTables {
+  std::array<std::array<std::uint8_t, 256>, lexMode::COUNT> action{};
+  std::array<std::array<lexToken, 8>, lexMode::COUNT> tokens{};
+  std::array<std::uint8_t, lexMode::COUNT> tokenCount{};
+  std::array<std::array<char, 8>, lexMode::COUNT> skipSet{};
+  std::array<std::uint8_t, lexMode::COUNT> skipCount{};
+  std::array<bool, lexMode::COUNT> multiline{}; /**< Literal modes that survive a newline */
+  std::uint8_t maxTokenLength = 1;              /**< Longest delimiter of the language */
+};
+
+namespace detail {
+
+constexpr bool isBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r';
+}
+
+// Adds a delimiter to a mode, keeping the longest delimiters first
+constexpr void addToken(lexTables& t,
+                        std::uint8_t mode,
+                        std::string_view text,
+                        std::uint8_t nextMode,
+                        bool lineStartOnly) {
+  if (text.empty()) {
+    return;
+  }
+  lexToken token{};
+  for (size_t k = 0; k < text.size() && k < 4; k++) {
+    token.text[k] = text[k];
+  }
+  token.length = static_cast<std::uint8_t>(text.size());
+  token.nextMode = nextMode;
+  token.lineStartOnly = lineStartOnly;
+
+  std::uint8_t at = t.tokenCount[mode];
+  while (at > 0 && t.tokens[mode][at - 1].length < token.length) {
+    t.tokens[mode][at] = t.tokens[mode][at - 1];
+    at--;
+  }
+  t.tokens[mode][at] = token;
+  t.tokenCount[mode]++;
+  t.action[mode][static_cast<unsigned char>(text[0])] = lexAction::TOKEN;
+  if (token.length > t.maxTokenLength) {
+    t.maxTokenLength = token.length;
+  }
+}
+
+}  // namespace detail
+
+/**
+ * @brief Compiles a language description into lexer tables.
+ *
+ * @param spec Language description.
+ * @return Tables for the lexer (usable in constant expressions).
+ */
+constexpr lexTables makeLexTables(languageSpec spec) {
+  lexTables t{};
+
+  // Default actions: what a plain byte means in every mode
+  for (std::uint8_t mode = 0; mode < lexMode::COUNT; mode++) {
+    std::uint8_t plain = mode == lexMode::CODE    ? lexAction::CODE
+                         : mode < lexMode::STRING ? lexAction::COMMENT
+                                                  : lexAction::STRING;
+    for (unsigned byte = 0; byte < 256; byte++) {
+      t.action[mode][byte] = detail::isBlank(static_cast<char>(byte)) ? lexAction::SPACE : plain;
+    }
+    t.action[mode]['\n'] = lexAction::NEWLINE;
+  }
+
+  // Delimiters: code opens comments and literals, which close back to code
+  for (const auto& token : spec.lineComments) {
+    detail::addToken(t, lexMode::CODE, token, lexMode::LINE_COMMENT, false);
+  }
+  for (std::uint8_t k = 0; k < spec.blocks.size(); k++) {
+    const blockRule& block = spec.blocks[k];
+    std::uint8_t mode = lexMode::BLOCK + k;
+    detail::addToken(t, lexMode::CODE, block.open, mode, block.lineStartOnly);
+    detail::addToken(t, mode, block.close, lexMode::CODE, false);
+  }
+  for (std::uint8_t k = 0; k < spec.quotes.size(); k++) {
+    const quoteRule& quote = spec.quotes[k];
+    std::uint8_t mode = lexMode::STRING + k;
+    detail::addToken(t, lexMode::CODE, quote.delimiter, mode, false);
+    detail::addToken(t, mode, quote.delimiter, lexMode::CODE, false);
+    t.multiline[mode] = quote.multiline;
+    if (quote.escapes && !quote.delimiter.empty()) {
+      t.action[mode]['\\'] = lexAction::ESCAPE;
+    }
+  }
+  for (const auto& literal : spec.literals) {
+    detail::addToken(t, lexMode::CODE, literal, lexMode::CODE, false);
+  }
+
+  // Bytes each mode must stop at: newline plus anything that is not plain content
+  for (std::uint8_t mode = 0; mode < lexMode::COUNT; mode++) {
+    for (unsigned byte = 0; byte < 256; byte++) {
+      std::uint8_t act = t.action[mode][byte];
+      if (act == lexAction::NEWLINE || act == lexAction::TOKEN || act == lexAction::ESCAPE) {
+        if (t.skipCount[mode] < t.skipSet[mode].size()) {
+          t.skipSet[mode][t.skipCount[mode]] = static_cast<char>(byte);
+        }
+        t.skipCount[mode]++;
+      }
+    }
+  }
+  return t;
+}
+
+/**
+ * @class languageRegistry
+ * @brief Lookup of the known languages by identifier or file extension.
+ *
+ * The built-in languages can be joined by the ones of a configuration file, which take the
+ * identifiers from lang::BUILTIN_COUNT on. Extensions are found through a perfect hash, compiled
+ * when the registry is first used and again after a file is loaded: a lookup hashes the extension
+ * once, in any case, and compares it to a single candidate.
+ */
+class languageRegistry {
+public:
+  /**
+   * @brief Finds the language of a file extension.
+   *
+   * @param extension Extension without the dot, in any case.
+   * @return Identifier of the language, or lang::UNDEF if the extension is unknown.
+   */
+  static langId fromExtension(std::string_view extension);
+
+  /**
+   * @brief Finds the language of a file path from its extension.
+   *
+   * @param filePath Path of the file.
+   * @return Identifier of the language, or lang::UNDEF if the extension is unknown.
+   */
+  static langId fromPath(std::string_view filePath);
+
+  /**
+   * @brief Gets the display name of a language.
+   *
+   * @param id Identifier of the language.
+   * @return Name shown in the Language column ("UNDEF" for unknown identifiers).
+   */
+  static std::string_view name(langId id);
+
+  /**
+   * @brief Gets the compiled lexer tables of a language.
+   *
+   * @param id Identifier of the language (unknown identifiers get the C rules).
+   * @return Lexer tables.
+   */
+  static const lexTables& tables(langId id);
+
+  /**
+   * @brief Gets the number of language identifiers, UNDEF included.
+   *
+   * @return One past the largest identifier.
+   */
+  static langId count();
+
+  /**
+   * @brief Adds the languages of a configuration file; call it before any file is counted.
+   *
+   * Each language is a "[NAME]" section with "key = values" lines: extensions (any number),
+   * line (up to 2 tokens), block (up to 2 open/close pairs), and string, multiline_string and
+   * raw_string (up to 4 delimiters in all). Delimiters have 1 to 4 bytes. An extension of an
+   * earlier language moves to the new one.
+   *
+   * @param filePath Path of the configuration file.
+   * @param error Receives what is wrong with the file, with the line number.
+   * @return False if the file cannot be read or is invalid; nothing is added then.
+   */
+  static bool loadFile(const std::string& filePath, std::string& error);
+
+  /**
+   * @brief Gets the version of the counting rules in effect, for caches and binary outputs.
+   *
+   * @return LEX_RULES_VERSION, changed by any language loaded from a file.
+   */
+  static std::uint32_t rulesVersion();
+};
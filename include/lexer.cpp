@@ -0,0 +1,173 @@
+#include "./lexer.h"
+#include "./simdScan.h"
+
+namespace {
+
+inline bool isCommentMode(std::uint8_t mode) {
+  return mode >= lexMode::LINE_COMMENT && mode < lexMode::STRING;
+}
+
+inline bool isStringMode(std::uint8_t mode) { return mode >= lexMode::STRING; }
+
+// Jumps over the bytes that cannot change the state of the given mode
+inline const char* skipPlain(const lexTables& tables,
+                             std::uint8_t mode,
+                             const char* p,
+                             const char* end) {
+  if (tables.skipCount[mode] > simd::MAX_SET) {
+    return p;
+  }
+  return simd::findFirstOf(p, end, tables.skipSet[mode].data(), tables.skipCount[mode]);
+}
+
+// Adds the current line to the counts and gets ready for the next one
+inline void closeLine(const lexTables& tables, lexState& state, lineCounts& counts) {
+  std::uint8_t mode = state.mode;
+  if (mode >= lexMode::BLOCK && mode < lexMode::STRING) {
+    state.hasComment = true;  // Still inside a block comment
+  } else if (mode == lexMode::LINE_COMMENT) {
+    state.mode = lexMode::CODE;
+  } else if (isStringMode(mode)) {
+    if (tables.multiline[mode] || state.continued) {
+      state.hasCode = true;  // The literal goes on in the next line
+    } else {
+      state.mode = lexMode::CODE;  // Unterminated literal: do not let it leak into the next line
+    }
+  }
+
+  // Final count: a line with both code and comment is counted for both
+  counts.lines++;
+  if (state.hasCode) {
+    counts.code++;
+  }
+  if (state.hasComment) {
+    counts.comments++;
+  }
+  if (!state.hasCode && !state.hasComment) {
+    counts.blank++;
+  }
+  state.lineOpen = false;
+  state.hasCode = false;
+  state.hasComment = false;
+  state.continued = false;
+}
+
+// Tries the delimiters of the current mode at p; returns the length matched, or 0
+inline size_t matchToken(const lexTables& tables, lexState& state, const char* p, const char* end) {
+  std::uint8_t mode = state.mode;
+  const auto& tokens = tables.tokens[mode];
+  for (std::uint8_t k = 0; k < tables.tokenCount[mode]; k++) {
+    const lexToken& token = tokens[k];
+    if (token.length > end - p || (token.lineStartOnly && state.hasCode)) {
+      continue;
+    }
+    bool same = true;
+    for (std::uint8_t j = 0; j < token.length; j++) {
+      if (p[j] != token.text[j]) {
+        same = false;
+        break;
+      }
+    }
+    if (!same) {
+      continue;
+    }
+
+    // Opening or closing a comment marks the line as comment, anything else (a literal) as code
+    std::uint8_t next = token.nextMode;
+    if (isCommentMode(mode) || isCommentMode(next)) {
+      state.hasComment = true;
+    } else {
+      state.hasCode = true;
+    }
+    state.mode = next;
+    return token.length;
+  }
+  return 0;
+}
+
+}  // namespace
+
+size_t lexer::scan(const lexTables& tables,
+                   lexState& state,
+                   const char* data,
+                   size_t size,
+                   lineCounts& counts,
+                   bool last) {
+  const char* p = data;
+  const char* end = data + size;
+
+  while (p < end) {
+    std::uint8_t mode = state.mode;
+    switch (tables.action[mode][static_cast<unsigned char>(*p)]) {
+    case lexAction::CODE:
+    case lexAction::STRING:
+      state.hasCode = true;
+      state.lineOpen = true;
+      p = skipPlain(tables, mode, p + 1, end);
+      break;
+    case lexAction::COMMENT:
+      state.hasComment = true;
+      state.lineOpen = true;
+      p = skipPlain(tables, mode, p + 1, end);
+      break;
+    case lexAction::SPACE:
+      state.lineOpen = true;
+      p++;
+      break;
+    case lexAction::NEWLINE:
+      closeLine(tables, state, counts);
+      p++;
+      break;
+    case lexAction::TOKEN: {
+      // A delimiter may continue in the next piece of input
+      if (!last && end - p < tables.maxTokenLength) {
+        return static_cast<size_t>(p - data);
+      }
+      state.lineOpen = true;
+      size_t length = matchToken(tables, state, p, end);
+      if (length == 0) {
+        // Not a delimiter after all: an ordinary byte of the mode
+        if (isCommentMode(mode)) {
+          state.hasComment = true;
+        } else {
+          state.hasCode = true;
+        }
+        length = 1;
+      }
+      p += length;
+      break;
+    }
+    case lexAction::ESCAPE:
+      if (!last && end - p < 3) {
+        return static_cast<size_t>(p - data);
+      }
+      state.hasCode = true;
+      state.lineOpen = true;
+      if (p + 1 < end && p[1] == '\n') {
+        state.continued = true;  // Escaped newline: the newline itself still ends the line
+        p++;
+      } else if (p + 2 < end && p[1] == '\r' && p[2] == '\n') {
+        state.continued = true;
+        p += 2;
+      } else {
+        p += (p + 1 < end) ? 2 : 1;
+      }
+      break;
+    }
+  }
+  return size;
+}
+
+void lexer::finish(const lexTables& tables, lexState& state, lineCounts& counts) {
+  if (state.lineOpen) {
+    closeLine(tables, state, counts);
+  }
+}
+
+lineCounts lexer::count(const lexTables& tables, const char* data, size_t size) {
+  lineCounts counts;
+  lexState state;
+  scan(tables, state, data, size, counts, true);
+  finish(tables, state, counts);
+  return counts;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "./file.h"
+#include "./language.h"
+
+/**
+ * @struct lineCounts
+ * @brief Line classification of a piece of source code.
+ */
+struct lineCounts {
+  count_t blank = 0;    /**< Number of blank lines */
+  count_t comments = 0; /**< Number of comment lines */
+  count_t code = 0;     /**< Number of code lines */
+  count_t lines = 0;    /**< Total number of lines */
+};
+
+/**
+ * @struct lexState
+ * @brief Everything the lexer carries from one piece of input to the next.
+ */
+struct lexState {
+  std::uint8_t mode = lexMode::CODE; /**< Current lexer mode */
+  bool lineOpen = false;             /**< Some byte of the current line was seen */
+  bool hasCode = false;              /**< The current line has code */
+  bool hasComment = false;           /**< The current line has a comment */
+  bool continued = false;            /**< A literal's newline was escaped */
+};
+
+/**
+ * @class lexer
+ * @brief Table-driven classifier of lines into blank, comment and code lines.
+ *
+ * The lexer runs one table lookup per byte (see lexTables) and jumps over runs of bytes that cannot
+ * change its state with the vectorized searches of simdScan.h. A line counts as code if it has any
+ * non-blank byte outside comments, as comment if it has any part of a comment, as both when it has
+ * both, and as blank otherwise; whitespace-only lines inside a block comment count as comments.
+ */
+class lexer {
+public:
+  /**
+   * @brief Classifies the lines of a piece of input, carrying state across calls.
+   *
+   * @param tables Tables of the language.
+   * @param state Lexer state, updated in place.
+   * @param data Start of the input.
+   * @param size Number of bytes in the input.
+   * @param counts Counts to add the completed lines to.
+   * @param last True if no input follows; otherwise the lexer may stop short of the end when a
+   * delimiter could straddle the boundary.
+   * @return Number of bytes consumed; the caller must feed the rest again with the next input.
+   */
+  static size_t scan(const lexTables& tables,
+                     lexState& state,
+                     const char* data,
+                     size_t size,
+                     lineCounts& counts,
+                     bool last);
+
+  /**
+   * @brief Counts the line left unterminated at the end of the input, if any.
+   *
+   * @param tables Tables of the language.
+   * @param state Lexer state.
+   * @param counts Counts to add the line to.
+   */
+  static void finish(const lexTables& tables, lexState& state, lineCounts& counts);
+
+  /**
+   * @brief Classifies every line of a buffer.
+   *
+   * @param tables Tables of the language.
+   * @param data Start of the buffer.
+   * @param size Number of bytes in the buffer.
+   * @return Counts of blank, comment, code and total lines.
+   */
+  static lineCounts count(const lexTables& tables, const char* data, size_t size);
+};
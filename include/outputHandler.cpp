@@ -1,9 +1,10 @@
 #include "./outputHandler.h"
 #include <algorithm>
 #include <fstream>
-#include <iomanip>
 #include <iostream>
 #include "./file.h"
+#include "./sortEngine.h"
+#include "./tracer.h"
 
 // Function to print help message from a specified help file
 void outputHandler::printHelpMessage(const std::string& HELP_FILE_PATH) {
@@ -29,28 +30,68 @@ void outputHandler::printErrorAndExit(const std::string message) {
   std::exit(-1);  // Exit with an error status
 }
 
+namespace {
+
+const std::string_view SEPARATOR
+  = "-----------------------------------------------------------------------------------"
+    "--------------------------------------------------------\n";
+
+// Streamed rows are written at least this often when the output is not a terminal
+constexpr size_t STREAM_FLUSH_BYTES = 64 * 1024;
+
+}  // namespace
+
+outputHandler::outputHandler(int fd) : out(fd) {}
+
+outputHandler::outputHandler(std::string& sink) : out(sink) {}
+
+// Function to limit the sorted output to its first rows
+void outputHandler::setTop(size_t rows) { topRows = rows; }
+
+// Function to choose the output format
+void outputHandler::setFormat(outputFormat selected) {
+  format = selected;
+  records = recordWriter::create(format, out);
+}
+
+// Function to tag machine-readable output with the shard it holds
+void outputHandler::setShard(unsigned index,
+                             unsigned count,
+                             std::uint32_t arguments,
+                             std::uint64_t scope) {
+  if (records) {
+    records->setShard(index, count, arguments, scope);
+  }
+}
+
 // Function to print the header of the output table
 void outputHandler::printHeader(int filesProcessed, int fileNameWidth) {
-  std::cout << "Files processed: " << filesProcessed << "\n";
-  std::cout << "-----------------------------------------------------------------------------------"
-               "--------------------------------------------------------\n";
+  out.text("Files processed: ");
+  out.cell(static_cast<count_t>(filesProcessed), 0);
+  out.put('\n');
+  printColumnHeaders(fileNameWidth);
+}
+
+// Function to print the column headers between separator lines
+void outputHandler::printColumnHeaders(int fileNameWidth) {
+  out.text(SEPARATOR);
   // Print column headers with specified widths
-  std::cout << std::left << std::setw(fileNameWidth) << "Filename";
-  std::cout << std::left << std::setw(20) << "Language";
-  std::cout << std::left << std::setw(15) << "Comments";
-  std::cout << std::left << std::setw(15) << "Blank";
-  std::cout << std::left << std::setw(15) << "Code";
-  std::cout << std::left << std::setw(15) << "All"
-            << "\n";
-  std::cout << "-----------------------------------------------------------------------------------"
-               "--------------------------------------------------------\n";
+  out.cell("Filename", fileNameWidth);
+  out.cell("Language", 20);
+  out.cell("Comments", 15);
+  out.cell("Blank", 15);
+  out.cell("Code", 15);
+  out.cell("All", 15);
+  out.put('\n');
+  out.text(SEPARATOR);
 }
 
 // Function to determine the maximum width of file names for table formatting
-int outputHandler::getLargestFileNameWidth(const std::vector<File>& files) {
+int outputHandler::getLargestFileNameWidth(const resultStore& files,
+                                           const std::vector<size_t>& rows) {
   int maxWidth = 8;  // Minimum width for "Filename"
-  for (const auto& file : files) {
-    int length = file.getFileName().length();
+  for (size_t row : rows) {
+    int length = static_cast<int>(files.pathLength(row));
     if (length > maxWidth) {
       maxWidth = length;  // Update maxWidth if a longer filename is found
     }
@@ -58,59 +99,204 @@ int outputHandler::getLargestFileNameWidth(const std::vector<File>& files) {
   return maxWidth + 2;  // Add some padding
 }
 
+// Function to sort an index of the rows according to the selected option
+std::vector<size_t> outputHandler::sortRows(const resultStore& Db,
+                                            const std::pair<std::string, std::string>& options) {
+  traceSpan span("sort", "phase");
+  bool reverseOrder = (options.first == "-S");  // `-S` indicates reverse sorting
+  char sortOption
+    = options.second[0];  // The first character of the second option defines the sort field
+
+  if (sortOption != '\0') {
+    return sortEngine(Db).order(sortOption, reverseOrder, topRows);
+  }
+  // No sort option: keep the order of appearance
+  std::vector<size_t> order(Db.size());
+  for (size_t row = 0; row < order.size(); row++) {
+    order[row] = row;
+  }
+  return order;
+}
+
 // Function to output formatted data about processed files
-void outputHandler::outputFormatted(std::vector<File>& Db,
+void outputHandler::outputFormatted(const resultStore& Db,
                                     int filesProcessed,
                                     std::pair<std::string, std::string> options) {
-  int largestFileNameWidth = getLargestFileNameWidth(Db);
+  std::vector<size_t> order = sortRows(Db, options);
+  if (format != outputFormat::TABLE) {
+    outputRecords(Db, order);
+    return;
+  }
+
+  int largestFileNameWidth = getLargestFileNameWidth(Db, order);
   printHeader(filesProcessed, largestFileNameWidth);
-  // Check the sorting option
-  bool reverseOrder = (options.first == "-S");  // `-S` indicates reverse sorting
-  char sortOption
-    = options.second[0];  // The first character of the second option defines the sort field
 
-  // Comparison lambda function for sorting files based on the selected criteria
-  auto compare = [sortOption](const File& a, const File& b) {
-    switch (sortOption) {
-    case 'f':
-      return a.getFileName() < b.getFileName();
-    case 't':
-      return a.getFileType() < b.getFileType();
-    case 'c':
-      return a.getComments() < b.getComments();
-    case 'b':
-      return a.getBlankLines() < b.getBlankLines();
-    case 's':
-      return a.getnCodes() < b.getnCodes();
-    case 'a':
-      return a.getLines() < b.getLines();
-    default:
-      return false;  // Safety case for unexpected sort option
+  // Output the formatted data for each file
+  traceSpan span("print", "phase");
+  for (size_t row : order) {
+    printRow(
+      Db.directory(row), Db.name(row), Db.language(row), Db.counts(row), largestFileNameWidth);
+  }
+
+  out.text(SEPARATOR);
+  out.flush();  // Inside the span, so the trace shows the real cost of printing
+}
+
+// Function to output the rows in a machine-readable format
+void outputHandler::outputRecords(const resultStore& Db, const std::vector<size_t>& order) {
+  traceSpan span("print", "phase");
+  size_t pathBytes = 0;
+  for (size_t row : order) {
+    pathBytes += Db.pathLength(row);
+  }
+  records->begin(order.size(), pathBytes);
+  for (size_t row : order) {
+    records->row(
+      Db.directory(row), Db.name(row), Db.language(row), Db.counts(row), Db.ordinal(row));
+  }
+  records->end(Db.size(), Db.totals());
+  out.flush();
+}
+
+// Function to output the rows of a spillSorter, merged from its runs
+bool outputHandler::outputMerged(spillSorter& sorter) {
+  size_t shown = sorter.size();
+  size_t longest = sorter.longestPath();
+  size_t pathBytes = sorter.pathBytes();
+  if (topRows > 0 && topRows < sorter.size()) {
+    shown = topRows;
+    longest = 0;
+    pathBytes = 0;
+    bool measured = sorter.merge([&](std::string_view path, langId, const lineCounts&, auto) {
+      longest = std::max(longest, path.size());
+      pathBytes += path.size();
+    });
+    if (!measured) {
+      return false;
     }
-  };
+  }
 
-  // Sort the Db vector according to the selected option
-  if (reverseOrder) {
-    std::sort(Db.begin(), Db.end(), [compare](const File& a, const File& b) {
-      return !compare(a, b);  // Invert the comparison for reverse order
+  bool merged;
+  if (format != outputFormat::TABLE) {
+    records->begin(shown, pathBytes);
+    merged = sorter.merge([&](std::string_view path,
+                              langId language,
+                              const lineCounts& counts,
+                              std::uint64_t ordinal) {
+      records->row("", path, language, counts, ordinal);
     });
+    records->end(sorter.size(), sorter.totals());
+  } else {
+    int width = static_cast<int>(std::max<size_t>(longest, 8)) + 2;  // As getLargestFileNameWidth
+    printHeader(static_cast<int>(sorter.size()), width);
+    merged = sorter.merge(
+      [&](std::string_view path, langId language, const lineCounts& counts, std::uint64_t) {
+        printRow("", path, language, counts, width);
+      });
+    out.text(SEPARATOR);
+  }
+  out.flush();
+  return merged;
+}
+
+// Function to print the row of a single file
+void outputHandler::printRow(std::string_view prefix,
+                             std::string_view name,
+                             langId language,
+                             const lineCounts& counts,
+                             int fileNameWidth) {
+  out.text(prefix);
+  out.cell(name, fileNameWidth - static_cast<int>(prefix.size()));
+  out.cell(languageRegistry::name(language), 20);
+  out.percentCell(counts.comments, counts.lines, 15);
+  out.percentCell(counts.blank, counts.lines, 15);
+  out.percentCell(counts.code, counts.lines, 15);
+  out.cell(counts.lines, 15);
+  out.put('\n');
+}
+
+// Function to start a streamed table
+void outputHandler::beginStream() {
+  streamFiles = 0;
+  streamTotals = lineCounts();
+  if (records) {
+    records->begin(0, 0);
   } else {
-    std::sort(Db.begin(), Db.end(), compare);  // Normal sorting
+    printColumnHeaders(STREAM_NAME_WIDTH);
   }
+  out.flush();
+}
 
-  // Output the formatted data for each file
-  for (size_t i = 0; i < Db.size(); i++) {
-    std::cout << std::left << std::setw(largestFileNameWidth) << Db[i].getFileName();
-    std::cout << std::left << std::setw(20) << Db[i].getFileType();
-    std::cout << std::left << std::setw(15)
-              << std::to_string(Db[i].getComments()) + " " + Db[i].getPercentageComments();
-    std::cout << std::left << std::setw(15)
-              << std::to_string(Db[i].getBlankLines()) + " " + Db[i].getPercentageBlank();
-    std::cout << std::left << std::setw(15)
-              << std::to_string(Db[i].getnCodes()) + " " + Db[i].getPercentageCode();
-    std::cout << std::left << std::setw(15) << Db[i].getLines() << "\n";
-  }
-
-  std::cout << "-----------------------------------------------------------------------------------"
-               "--------------------------------------------------------\n";
+// Function to print one row of a streamed table and update the running totals
+void outputHandler::streamRow(const File& file) {
+  std::string_view name = file.getFileName();
+  lineCounts counts;
+  counts.blank = file.getBlankLines();
+  counts.comments = file.getComments();
+  counts.code = file.getnCodes();
+  counts.lines = file.getLines();
+
+  // Keep the columns aligned: long names lose their head, which is the least useful part
+  const size_t maxLength = STREAM_NAME_WIDTH - 2;
+  if (records) {
+    records->row("", name, file.getLanguage(), counts, file.getOrdinal());
+  } else if (name.size() > maxLength) {
+    std::string_view tail = name.substr(name.size() - (maxLength - 3));
+    printRow("...", tail, file.getLanguage(), counts, STREAM_NAME_WIDTH);
+  } else {
+    printRow("", name, file.getLanguage(), counts, STREAM_NAME_WIDTH);
+  }
+
+  streamFiles++;
+  streamTotals.blank += counts.blank;
+  streamTotals.comments += counts.comments;
+  streamTotals.code += counts.code;
+  streamTotals.lines += counts.lines;
+
+  // Rows show up as they are counted: at once on a terminal, in large writes otherwise
+  if (out.isInteractive() || out.buffered() >= STREAM_FLUSH_BYTES) {
+    out.flush();
+  }
+}
+
+// Function to write out the rows printed so far
+void outputHandler::flush() { out.flush(); }
+
+// Function to end a streamed table with the totals footer
+void outputHandler::endStream() {
+  if (records) {
+    records->end(streamFiles, streamTotals);
+    out.flush();
+    return;
+  }
+  printTotals(streamFiles, streamTotals);
+  out.flush();
+}
+
+// Function to print the SUM row and the number of files
+void outputHandler::printTotals(count_t files, const lineCounts& totals) {
+  out.text(SEPARATOR);
+  out.cell("SUM", STREAM_NAME_WIDTH);
+  out.cell("", 20);
+  out.cell(totals.comments, 15);
+  out.cell(totals.blank, 15);
+  out.cell(totals.code, 15);
+  out.cell(totals.lines, 15);
+  out.put('\n');
+  out.text(SEPARATOR);
+  out.text("Files processed: ");
+  out.cell(files, 0);
+  out.put('\n');
+}
+
+// Function to output only the totals of the processed files
+void outputHandler::outputTotals(const resultStore& Db) {
+  if (records) {
+    records->begin(0, 0);
+    records->end(Db.size(), Db.totals());
+  } else {
+    printColumnHeaders(STREAM_NAME_WIDTH);
+    printTotals(Db.size(), Db.totals());
+  }
+  out.flush();
 }
@@ -3,8 +3,14 @@
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <unistd.h>
 #include <vector>
 #include "./file.h"
+#include "./lexer.h"
+#include "./recordWriter.h"
+#include "./resultStore.h"
+#include "./spillSorter.h"
+#include "./tableWriter.h"
 
 /**
  * @class outputHandler
@@ -14,18 +20,113 @@
  * error messages, and help information.
  */
 class outputHandler {
+private:
+  tableWriter out;          /**< Buffered destination of the table */
+  outputFormat format = outputFormat::TABLE; /**< Format of the output */
+  std::unique_ptr<recordWriter> records;     /**< Writer of the other formats */
+  size_t topRows = 0;       /**< Rows shown by a sorted output (0 = all) */
+  count_t streamFiles = 0; /**< Files printed by streamRow */
+  lineCounts streamTotals;  /**< Running totals of the streamed files */
+
+  /**
+   * @brief Sorts an index of the rows according to the sort option.
+   *
+   * @param db Reference to the store containing the processed files.
+   * @param options A pair of strings representing sorting options.
+   * @return Row indices in output order.
+   */
+  std::vector<size_t> sortRows(const resultStore& db,
+                               const std::pair<std::string, std::string>& options);
+
+  /**
+   * @brief Writes the rows in the selected machine-readable format.
+   *
+   * @param db Reference to the store containing the processed files.
+   * @param order Row indices in output order.
+   */
+  void outputRecords(const resultStore& db, const std::vector<size_t>& order);
+
+  /**
+   * @brief Prints the SUM row and the number of files processed.
+   *
+   * @param files Number of files.
+   * @param totals Sum of their counts.
+   */
+  void printTotals(count_t files, const lineCounts& totals);
+
 public:
+  /** Width of the Filename column in streaming mode; longer names are shortened from the left. */
+  static constexpr int STREAM_NAME_WIDTH = 48;
+
+  /**
+   * @brief Constructor for the outputHandler class.
+   *
+   * @param fd Descriptor the table is written to (the standard output by default).
+   */
+  explicit outputHandler(int fd = STDOUT_FILENO);
+
+  /**
+   * @brief Creates a handler that renders into a string, e.g. to send it later.
+   *
+   * @param sink String the output is appended to.
+   */
+  explicit outputHandler(std::string& sink);
+
+  /**
+   * @brief Selects the output format; the default is the text table.
+   *
+   * @param selected Format of the output.
+   */
+  void setFormat(outputFormat selected);
+
+  /**
+   * @brief Records the shard the rows belong to in the binary format; call it after setFormat.
+   *
+   * @param index Shard, from 0.
+   * @param count Number of shards.
+   * @param arguments Number of paths and lists counted.
+   * @param scope Hash of the paths, lists and options that choose the files.
+   */
+  void setShard(unsigned index, unsigned count, std::uint32_t arguments, std::uint64_t scope);
+
+  /**
+   * @brief Shows only the first rows of a sorted output, selected without sorting the others.
+   *
+   * @param rows Number of rows to show (0 shows all of them).
+   */
+  void setTop(size_t rows);
+
   /**
    * @brief Outputs formatted information about the processed files.
    *
-   * @param db Reference to a vector of File objects containing the processed files.
+   * The store itself is not reordered: the rows are printed through a sorted index.
+   *
+   * @param db Reference to the store containing the processed files.
    * @param filesProcessed The number of files that have been processed.
    * @param options A pair of strings representing sorting options.
    */
-  void outputFormatted(std::vector<File>& db,
+  void outputFormatted(const resultStore& db,
                        int filesProcessed,
                        std::pair<std::string, std::string> options);
 
+  /**
+   * @brief Outputs the rows of a spillSorter, in its order, like outputFormatted.
+   *
+   * With --top, a first merge measures the rows shown (the table width, the paths of the binary
+   * format) before the one that prints them.
+   *
+   * @param sorter Rows, finished.
+   * @return False if the runs could not be read back (see spillSorter::error()).
+   */
+  bool outputMerged(spillSorter& sorter);
+
+  /**
+   * @brief Outputs only the totals: a SUM row in the table, the totals object in JSON.
+   *
+   * @param db Reference to the store containing the processed files.
+   */
+  void outputTotals(const resultStore& db);
+
   /**
    * @brief Prints the header for the output table.
    *
@@ -34,13 +135,67 @@ public:
    */
   void printHeader(int filesProcessed, int fileNameWidth);
 
+  /**
+   * @brief Prints the column headers between two separator lines.
+   *
+   * @param fileNameWidth The width for formatting file names in the output.
+   */
+  void printColumnHeaders(int fileNameWidth);
+
+  /**
+   * @brief Prints the table row of a file.
+   *
+   * The Filename column shows prefix followed by name, so a stored path never has to be rebuilt.
+   *
+   * @param prefix First part of the name shown in the Filename column (e.g. the directory).
+   * @param name Second part of the name shown in the Filename column.
+   * @param language Language of the file.
+   * @param counts Line counts of the file.
+   * @param fileNameWidth The width for formatting file names in the output.
+   */
+  void printRow(std::string_view prefix,
+                std::string_view name,
+                langId language,
+                const lineCounts& counts,
+                int fileNameWidth);
+
+  /**
+   * @brief Starts a streamed table: prints the column headers right away.
+   */
+  void beginStream();
+
+  /**
+   * @brief Prints the row of a file as soon as it is counted and adds it to the running totals.
+   *
+   * @param file The file just counted.
+   */
+  void streamRow(const File& file);
+
+  /**
+   * @brief Ends a streamed table with the totals footer and the number of files processed.
+   */
+  void endStream();
+
+  /**
+   * @brief Writes out the rows printed so far, so later messages cannot overtake them.
+   */
+  void flush();
+
+  /**
+   * @brief Gets the number of rows streamed so far.
+   *
+   * @return Number of files printed by streamRow.
+   */
+  count_t streamedFiles() const { return streamFiles; }
+
   /**
    * @brief Gets the width of the largest file name for formatting purposes.
    *
-   * @param db Reference to a vector of File objects.
+   * @param db Reference to the store of processed files.
+   * @param rows Rows that will be printed.
    * @return The width of the largest file name.
    */
-  int getLargestFileNameWidth(const std::vector<File>& db);
+  int getLargestFileNameWidth(const resultStore& db, const std::vector<size_t>& rows);
 
   /**
    * @brief Prints the help message from the specified file.
@@ -0,0 +1,142 @@
+#include "./parallelLexer.h"
+#include <array>
+#include <cstring>
+#include <vector>
+#include "./threadPool.h"
+#include "./tracer.h"
+
+namespace {
+
+// Counts of a run, or of a run with the counts of another taken off (a suffix of a run)
+lineCounts operator+(const lineCounts& a, const lineCounts& b) {
+  return { a.blank + b.blank, a.comments + b.comments, a.code + b.code, a.lines + b.lines };
+}
+
+lineCounts operator-(const lineCounts& a, const lineCounts& b) {
+  return { a.blank - b.blank, a.comments - b.comments, a.code - b.code, a.lines - b.lines };
+}
+
+// Cuts [begin, end) just after the first newline past every spacing bytes
+std::vector<size_t> lineCuts(const char* data, size_t begin, size_t end, size_t spacing) {
+  std::vector<size_t> cuts;
+  for (size_t position = begin; position < end;) {
+    size_t target = position + spacing;
+    if (target >= end) {
+      cuts.push_back(end);
+      break;
+    }
+    const void* newline = std::memchr(data + target, '\n', end - target);
+    position = newline != nullptr
+                 ? static_cast<size_t>(static_cast<const char*>(newline) - data) + 1
+                 : end;
+    cuts.push_back(position);
+  }
+  return cuts;
+}
+
+// Result of lexing a chunk from a given mode
+struct outcome {
+  lineCounts counts;
+  std::uint8_t exitMode = lexMode::CODE;
+  bool ready = false;
+};
+
+struct chunk {
+  size_t begin = 0;
+  bool last = false;
+  std::vector<size_t> cuts;                       // Ends of the pieces between checkpoints
+  std::vector<std::uint8_t> codeModes;            // Run from code: mode at each cut
+  std::vector<lineCounts> codeCounts;             // Run from code: counts up to each cut
+  std::array<outcome, lexMode::COUNT> byEntry{};  // Indexed by entry mode
+};
+
+// Lexes a chunk from the code mode, recording its state at every cut
+void runFromCode(const lexTables& tables, const char* data, chunk& part) {
+  lexState state;
+  lineCounts counts;
+  size_t position = part.begin;
+  for (size_t cut : part.cuts) {
+    lexer::scan(tables, state, data + position, cut - position, counts, true);
+    position = cut;
+    part.codeModes.push_back(state.mode);
+    part.codeCounts.push_back(counts);
+  }
+  if (part.last) {
+    lexer::finish(tables, state, counts);
+  }
+  part.byEntry[lexMode::CODE] = { counts, state.mode, true };
+}
+
+// Lexes a chunk from another mode until it meets the run from code at a cut
+void runFrom(const lexTables& tables, const char* data, chunk& part, std::uint8_t mode) {
+  const outcome& fromCode = part.byEntry[lexMode::CODE];
+  lexState state;
+  state.mode = mode;
+  lineCounts counts;
+  size_t position = part.begin;
+  for (size_t index = 0; index < part.cuts.size(); index++) {
+    size_t cut = part.cuts[index];
+    lexer::scan(tables, state, data + position, cut - position, counts, true);
+    position = cut;
+    // At a line start the mode is the whole state: same mode, same run from here on
+    if (state.mode == part.codeModes[index] && index + 1 < part.cuts.size()) {
+      part.byEntry[mode]
+        = { counts + (fromCode.counts - part.codeCounts[index]), fromCode.exitMode, true };
+      return;
+    }
+  }
+  if (part.last) {
+    lexer::finish(tables, state, counts);
+  }
+  part.byEntry[mode] = { counts, state.mode, true };
+}
+
+}  // namespace
+
+lineCounts parallelLexer::count(const lexTables& tables,
+                                const char* data,
+                                size_t size,
+                                threadPool& pool) {
+  std::vector<chunk> parts;
+  size_t begin = 0;
+  for (size_t end : lineCuts(data, 0, size, CHUNK_SIZE)) {
+    chunk part;
+    part.begin = begin;
+    part.last = end == size;
+    part.cuts = lineCuts(data, begin, end, CHECKPOINT_SPACING);
+    parts.push_back(std::move(part));
+    begin = end;
+  }
+
+  // The modes a line can start in: code, and the ones a newline does not end
+  std::vector<std::uint8_t> guesses;
+  for (std::uint8_t mode = lexMode::BLOCK; mode < lexMode::COUNT; mode++) {
+    if (tables.tokenCount[mode] > 0) {
+      guesses.push_back(mode);
+    }
+  }
+
+  pool.forEach(parts.size(), [&](size_t index) {
+    traceSpan span("lex chunk", "lex");
+    chunk& part = parts[index];
+    span.setBytes((part.cuts.empty() ? part.begin : part.cuts.back()) - part.begin);
+    runFromCode(tables, data, part);
+    if (index > 0) {
+      for (std::uint8_t mode : guesses) {
+        runFrom(tables, data, part, mode);
+      }
+    }
+  });
+
+  // Follow the actual mode from chunk to chunk
+  lineCounts total;
+  std::uint8_t mode = lexMode::CODE;
+  for (chunk& part : parts) {
+    if (!part.byEntry[mode].ready) {
+      runFrom(tables, data, part, mode);  // Not guessed: lex it now
+    }
+    total = total + part.byEntry[mode].counts;
+    mode = part.byEntry[mode].exitMode;
+  }
+  return total;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include "./lexer.h"
+
+class threadPool;
+
+/**
+ * @class parallelLexer
+ * @brief Counts a single large buffer on several threads, with the exact counts of lexer::count.
+ *
+ * The buffer is cut into chunks at line boundaries. Where a line starts, the whole lexer state is
+ * its mode (code, block comment, multiline literal), so every chunk is lexed in parallel from each
+ * mode it could start in. A run from a guessed mode stops as soon as it is in the same mode as the
+ * run from code at one of its checkpoints (every CHECKPOINT_SPACING bytes) and takes the rest from
+ * it; a wrong guess thus costs a few kilobytes past the end of the comment or literal. A sequential
+ * pass then follows the actual mode from chunk to chunk and adds up the matching runs.
+ */
+class parallelLexer {
+public:
+  /** Buffers from this size on are worth splitting. */
+  static constexpr size_t THRESHOLD = 4 * 1024 * 1024;
+  /** Bytes per chunk (chunks end at the first newline past it). */
+  static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+  /** Bytes between the checkpoints of a chunk. */
+  static constexpr size_t CHECKPOINT_SPACING = 32 * 1024;
+
+  /**
+   * @brief Classifies every line of a buffer on the workers of a pool and the calling thread.
+   *
+   * @param tables Tables of the language.
+   * @param data Start of the buffer.
+   * @param size Number of bytes in the buffer.
+   * @param pool Workers to share the chunks with; may be the pool of the calling thread.
+   * @return Counts of blank, comment, code and total lines.
+   */
+  static lineCounts count(const lexTables& tables, const char* data, size_t size, threadPool& pool);
+};
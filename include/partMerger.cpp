@@ -0,0 +1,166 @@
+#include "./partMerger.h"
+#include <algorithm>
+#include <cstring>
+#include "./language.h"
+#include "./recordWriter.h"
+#include "./tracer.h"
+
+namespace {
+
+// Reads a T at an offset that may not be aligned for it
+template <typename T>
+T load(const char* data, std::uint64_t offset) {
+  T value;
+  std::memcpy(&value, data + offset, sizeof(T));
+  return value;
+}
+
+// Tells if count items of size bytes from offset fit in a file of length bytes
+bool fits(std::uint64_t offset, std::uint64_t count, std::uint64_t size, std::uint64_t length) {
+  return offset <= length && (size == 0 || count <= (length - offset) / size);
+}
+
+}  // namespace
+
+bool partMerger::add(const std::string& partPath) {
+  traceSpan span("read part", "io");
+  auto content = std::make_unique<fileBuffer>();
+  if (!content->open(partPath)) {
+    message = "cannot read the part " + partPath;
+    return false;
+  }
+  const char* data = content->data();
+  std::uint64_t length = content->size();
+  span.setBytes(length);
+
+  auto fail = [&](const std::string& reason) {
+    message = partPath + ": " + reason;
+    return false;
+  };
+  if (length < sizeof(binFormat::header)
+      || std::memcmp(data, binFormat::MAGIC, sizeof(binFormat::MAGIC)) != 0) {
+    return fail("not a file written with --format bin");
+  }
+  auto head = load<binFormat::header>(data, 0);
+  if (head.formatVersion == __builtin_bswap32(binFormat::VERSION)) {
+    return fail("written on a machine with the other byte order");
+  }
+  if (head.formatVersion != binFormat::VERSION || head.rowSize != sizeof(binFormat::row)) {
+    return fail("written by another version of slockf (format " + std::to_string(head.formatVersion)
+                + ", this one reads " + std::to_string(binFormat::VERSION) + ")");
+  }
+  if (!fits(head.languagesOffset, head.languageCount, sizeof(binFormat::language), length)
+      || !fits(head.rowsOffset, head.rowCount, sizeof(binFormat::row), length)
+      || !fits(head.stringsOffset, head.stringsSize, 1, length)
+      || !fits(head.totalsOffset, 1, sizeof(binFormat::totals), length)) {
+    return fail("truncated or damaged");
+  }
+
+  // Rows name their language by index: the table must be the one of this run
+  bool sameLanguages = head.languageCount == languageRegistry::count();
+  for (langId id = 0; sameLanguages && id < head.languageCount; id++) {
+    std::uint64_t offset = head.languagesOffset + id * sizeof(binFormat::language);
+    auto entry = load<binFormat::language>(data, offset);
+    std::string_view name(entry.name, strnlen(entry.name, sizeof(entry.name)));
+    sameLanguages = name == languageRegistry::name(id).substr(0, sizeof(entry.name) - 1);
+  }
+  if (!sameLanguages) {
+    return fail("counted with other languages (merge with the same --languages)");
+  }
+
+  auto sums = load<binFormat::totals>(data, head.totalsOffset);
+  if (sums.files != head.rowCount) {
+    return fail("holds " + std::to_string(head.rowCount) + " of its " + std::to_string(sums.files)
+                + " files (written with --top?)");
+  }
+  if (head.shardCount == 0 || head.shardIndex >= head.shardCount) {
+    return fail("truncated or damaged");
+  }
+  if (parts.empty()) {
+    shardCount = head.shardCount;
+    rulesVersion = head.rulesVersion;
+    argumentCount = head.argumentCount;
+    scopeHash = head.scopeHash;
+  }
+  if (head.shardCount != shardCount) {
+    return fail("shard of a run in " + std::to_string(head.shardCount) + " shards, not "
+                + std::to_string(shardCount));
+  }
+  if (head.rulesVersion != rulesVersion) {
+    return fail("counted with other rules than " + parts.front().path);
+  }
+  if (head.argumentCount != argumentCount || head.scopeHash != scopeHash) {
+    return fail("counted other paths, lists or -r/--exclude/--respect-gitignore than "
+                + parts.front().path);
+  }
+  for (const part& other : parts) {
+    if (other.shardIndex == head.shardIndex) {
+      return fail("same shard (" + std::to_string(head.shardIndex + 1) + "/"
+                  + std::to_string(shardCount) + ") as " + other.path);
+    }
+  }
+
+  auto index = static_cast<std::uint32_t>(parts.size());
+  entries.reserve(entries.size() + head.rowCount);
+  for (std::uint64_t row = 0; row < head.rowCount; row++) {
+    auto record = load<binFormat::row>(data, head.rowsOffset + row * sizeof(binFormat::row));
+    if (record.language >= head.languageCount
+        || (record.ordinal >> 40) >= head.argumentCount
+        || !fits(record.pathOffset, record.pathLength, 1, head.stringsSize)) {
+      entries.resize(entries.size() - row);
+      return fail("truncated or damaged");
+    }
+    entries.push_back({ record.ordinal, index, row });
+  }
+
+  part added;
+  added.path = partPath;
+  added.content = std::move(content);
+  added.rowCount = head.rowCount;
+  added.rowsOffset = head.rowsOffset;
+  added.stringsOffset = head.stringsOffset;
+  added.shardIndex = head.shardIndex;
+  parts.push_back(std::move(added));
+  return true;
+}
+
+bool partMerger::finish(resultStore& Db) {
+  if (parts.size() != shardCount) {
+    std::vector<bool> present(shardCount, false);
+    for (const part& added : parts) {
+      present[added.shardIndex] = true;
+    }
+    size_t missing = static_cast<size_t>(std::find(present.begin(), present.end(), false)
+                                         - present.begin());
+    message = "shard " + std::to_string(missing + 1) + "/" + std::to_string(shardCount)
+              + " is missing";
+    return false;
+  }
+
+  traceSpan span("merge", "phase");
+  std::sort(entries.begin(), entries.end(), [](const entry& a, const entry& b) {
+    return a.ordinal < b.ordinal;
+  });
+  for (size_t k = 1; k < entries.size(); k++) {
+    if (entries[k].ordinal == entries[k - 1].ordinal) {
+      message = parts[entries[k].part].path + " and " + parts[entries[k - 1].part].path
+                + " hold the same file (parts of different runs?)";
+      return false;
+    }
+  }
+
+  Db.reserve(entries.size());
+  for (const entry& at : entries) {
+    const part& from = parts[at.part];
+    const char* data = from.content->data();
+    auto record = load<binFormat::row>(data, from.rowsOffset + at.row * sizeof(binFormat::row));
+    lineCounts counts;
+    counts.blank = record.blank;
+    counts.comments = record.comments;
+    counts.code = record.code;
+    counts.lines = record.lines;
+    std::string_view path(data + from.stringsOffset + record.pathOffset, record.pathLength);
+    Db.append(path, record.language, counts, at.ordinal);
+  }
+  return true;
+}
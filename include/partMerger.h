@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "./fileBuffer.h"
+#include "./resultStore.h"
+
+/**
+ * @class partMerger
+ * @brief Combines the `--format bin` outputs of the shards of a run (`--shard I/N`).
+ *
+ * Each part is mapped and checked: its header, the bounds of its tables, its language table
+ * against the rules of this run, and its totals against its rows (a part written with --top lacks
+ * rows and is refused). The parts must be the N shards of one run, each once: same paths and lists
+ * in the same order, and the same options choosing the files. Their rows are then
+ * put back in the order of their ordinals, which is the order of appearance of an unsharded run, so
+ * a sort or an output of the merged rows is the one of that run.
+ */
+class partMerger {
+public:
+  /**
+   * @brief Maps a part and checks it.
+   *
+   * @param partPath Path of a file written with --format bin.
+   * @return False if the part cannot be read, is damaged or does not fit the others (see error()).
+   */
+  bool add(const std::string& partPath);
+
+  /**
+   * @brief Checks that every shard was added and appends all the rows to a store, in order.
+   *
+   * @param Db Empty store that receives the rows.
+   * @return False if a shard is missing or two rows share an ordinal (see error()).
+   */
+  bool finish(resultStore& Db);
+
+  /**
+   * @brief Gets why add() or finish() failed.
+   *
+   * @return Description of the error.
+   */
+  const std::string& error() const { return message; }
+
+private:
+  /** A mapped part and where its tables start. */
+  struct part {
+    std::string path;
+    std::unique_ptr<fileBuffer> content;
+    std::uint64_t rowCount = 0;
+    std::uint64_t rowsOffset = 0;
+    std::uint64_t stringsOffset = 0;
+    std::uint32_t shardIndex = 0;
+  };
+
+  /** Where a row is: its ordinal first, the order of the merge. */
+  struct entry {
+    std::uint64_t ordinal;
+    std::uint32_t part;
+    std::uint64_t row;
+  };
+
+  std::vector<part> parts;      /**< Parts added */
+  std::vector<entry> entries;   /**< Rows of every part */
+  std::uint32_t shardCount = 0; /**< Number of shards of the run (0 before the first part) */
+  std::uint32_t rulesVersion = 0; /**< Rules the counts of the parts were made with */
+  std::uint32_t argumentCount = 0; /**< Paths and lists the parts counted */
+  std::uint64_t scopeHash = 0;  /**< What the parts counted (see binFormat::header) */
+  std::string message;          /**< Last error */
+};
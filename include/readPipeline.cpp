@@ -0,0 +1,228 @@
+#include "./readPipeline.h"
+#include <fcntl.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "./ioRing.h"
+#include "./threadPool.h"
+#include "./tracer.h"
+
+namespace {
+
+// Operation of a submission, kept in the high half of its user data (the slot is the low half)
+enum operation : std::uint64_t { OPEN = 0, READ = 1, CLOSE = 2 };
+
+// Paths waiting to be opened, per read buffer
+constexpr size_t QUEUED_PER_SLOT = 4;
+
+std::uint64_t tag(operation op, unsigned index) {
+  return (static_cast<std::uint64_t>(op) << 32) | index;
+}
+
+}  // namespace
+
+readPipeline::readPipeline(threadPool& workers, consume_t consumer)
+  : pool(workers), consume(std::move(consumer)), ring(std::make_unique<ioRing>(2 * DEPTH)) {
+  if (!ring->valid()) {
+    return;
+  }
+  buffers.reset(new char[DEPTH * BUFFER_SIZE]);
+  std::vector<struct iovec> vectors(DEPTH);
+  for (unsigned index = 0; index < DEPTH; index++) {
+    vectors[index].iov_base = buffers.get() + index * BUFFER_SIZE;
+    vectors[index].iov_len = BUFFER_SIZE;
+  }
+  registered = ring->registerBuffers(vectors.data(), DEPTH);
+
+  slots.resize(DEPTH);
+  for (unsigned index = DEPTH; index > 0; index--) {
+    freeSlots.push_back(index - 1);
+  }
+  reader = std::thread(&readPipeline::run, this);
+}
+
+readPipeline::~readPipeline() { finish(); }
+
+void readPipeline::add(std::string filePath, size_t id) {
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    spaceFree.wait(guard, [this] { return queue.size() < QUEUED_PER_SLOT * DEPTH; });
+    queue.emplace_back(std::move(filePath), id);
+  }
+  readerWake.notify_one();
+}
+
+void readPipeline::finish() {
+  if (!reader.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    done = true;
+  }
+  readerWake.notify_one();
+  reader.join();
+  pool.wait();
+}
+
+void readPipeline::dispatch(unsigned index, size_t size, readStatus status) {
+  slots[index].busy = false;
+  pool.submit([this, index, size, status] {
+    const slot& file = slots[index];
+    const char* data = status == readStatus::OK ? buffers.get() + index * BUFFER_SIZE : nullptr;
+    consume(file.path, file.id, data, size, status);
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      freeSlots.push_back(index);
+    }
+    readerWake.notify_one();
+  });
+}
+
+void readPipeline::run() {
+  // A full submission queue only means the kernel has not taken the entries yet
+  auto entry = [this] {
+    struct io_uring_sqe* sqe;
+    while ((sqe = ring->nextEntry()) == nullptr) {
+      ring->submit(0);
+    }
+    return sqe;
+  };
+  // Reads the rest of a file into its buffer, after the bytes already there
+  auto submitRead = [&](unsigned index) {
+    slot& file = slots[index];
+    struct io_uring_sqe* sqe = entry();
+    sqe->opcode = registered ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = file.fd;
+    sqe->addr = reinterpret_cast<std::uint64_t>(buffers.get() + index * BUFFER_SIZE + file.filled);
+    sqe->len = static_cast<std::uint32_t>(BUFFER_SIZE - file.filled);
+    sqe->off = file.filled;
+    sqe->buf_index = static_cast<std::uint16_t>(registered ? index : 0);
+    sqe->user_data = tag(READ, index);
+  };
+  auto submitClose = [&](unsigned index) {
+    slot& file = slots[index];
+    struct io_uring_sqe* sqe = entry();
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = file.fd;
+    sqe->user_data = tag(CLOSE, index);
+    file.fd = -1;
+  };
+
+  unsigned inFlight = 0;  // Operations submitted and not completed yet
+  while (true) {
+    // Open the queued files there are buffers for
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      if (broken) {
+        // Leave every remaining file to the workers, which read it the ordinary way
+        readerWake.wait(guard, [this] { return !queue.empty() || done; });
+        if (queue.empty()) {
+          return;
+        }
+        auto [filePath, id] = std::move(queue.front());
+        queue.pop_front();
+        spaceFree.notify_all();
+        guard.unlock();
+        pool.submit([this, filePath = std::move(filePath), id = id] {
+          consume(filePath, id, nullptr, 0, readStatus::FAILED);
+        });
+        continue;
+      }
+      if (inFlight == 0) {
+        readerWake.wait(guard, [this] {
+          return (!queue.empty() && !freeSlots.empty()) || (done && queue.empty());
+        });
+        if (queue.empty()) {
+          return;  // Done, and nothing left in flight
+        }
+      }
+      bool took = false;
+      while (!queue.empty() && !freeSlots.empty()) {
+        unsigned index = freeSlots.back();
+        freeSlots.pop_back();
+        slot& file = slots[index];
+        file.path = std::move(queue.front().first);
+        file.id = queue.front().second;
+        file.busy = true;
+        queue.pop_front();
+
+        struct io_uring_sqe* sqe = entry();
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<std::uint64_t>(file.path.c_str());
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        sqe->user_data = tag(OPEN, index);
+        inFlight++;
+        took = true;
+      }
+      if (took) {
+        spaceFree.notify_all();
+      }
+    }
+
+    {
+      traceSpan span("io wait", "io");
+      broken = !ring->submit(1);
+    }
+    if (broken) {
+      std::cerr << ">>>> Warning: io_uring failed, reading the remaining files directly\n";
+      for (unsigned index = 0; index < DEPTH; index++) {
+        if (slots[index].busy) {
+          if (slots[index].fd >= 0) {
+            ::close(slots[index].fd);
+            slots[index].fd = -1;
+          }
+          dispatch(index, 0, readStatus::FAILED);
+        }
+      }
+      continue;
+    }
+
+    struct io_uring_cqe completion;
+    while (ring->nextCompletion(completion)) {
+      inFlight--;
+      auto index = static_cast<unsigned>(completion.user_data & 0xFFFFFFFFu);
+      auto op = static_cast<operation>(completion.user_data >> 32);
+      slot& file = slots[index];
+      if (op == OPEN) {
+        if (completion.res < 0) {
+          dispatch(index, 0, readStatus::FAILED);
+          continue;
+        }
+        file.fd = completion.res;
+        file.filled = 0;
+        // The size tells when the file is read whole; the inode was just loaded by the open
+        struct stat info {};
+        if (fstat(file.fd, &info) != 0 || static_cast<size_t>(info.st_size) >= BUFFER_SIZE) {
+          submitClose(index);
+          inFlight++;
+          dispatch(index, 0, info.st_size > 0 ? readStatus::TOO_LARGE : readStatus::FAILED);
+          continue;
+        }
+        file.expected = static_cast<size_t>(info.st_size);
+        submitRead(index);
+        inFlight++;
+      } else if (op == READ) {
+        if (completion.res > 0) {
+          file.filled += static_cast<size_t>(completion.res);
+        }
+        // A short read is resumed until the size of the file is reached
+        if (completion.res > 0 && file.filled < file.expected) {
+          submitRead(index);
+          inFlight++;
+          continue;
+        }
+        submitClose(index);
+        inFlight++;
+        if (completion.res < 0 || file.filled < file.expected) {
+          dispatch(index, 0, readStatus::FAILED);  // Error, or truncated since the stat
+        } else {
+          dispatch(index, file.filled,
+                   file.filled == BUFFER_SIZE ? readStatus::TOO_LARGE : readStatus::OK);
+        }
+      }
+    }
+  }
+}
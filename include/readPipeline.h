@@ -0,0 +1,122 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ioRing;
+class threadPool;
+
+/**
+ * @class readPipeline
+ * @brief Reads files through io_uring with many opens and reads in flight, for cold caches.
+ *
+ * A reader thread owns the ring. It takes paths from a bounded queue, and for each one it submits
+ * an openat, then reads of up to BUFFER_SIZE bytes into one of DEPTH registered buffers until the
+ * size of the file (fstat after the open) is reached, then a close, without ever waiting on a
+ * single file. Each completed buffer is handed to the workers of
+ * a thread pool, which count it and give the buffer back. Since a file holds its buffer until it
+ * is counted, the buffers also bound how much is read ahead of the workers.
+ *
+ * Files that do not fit in a buffer are reported as TOO_LARGE and left to the caller, which maps
+ * them: at that size a mapping is cheaper than a copy anyway.
+ */
+class readPipeline {
+public:
+  /** Files in flight, and number of read buffers. */
+  static constexpr unsigned DEPTH = 64;
+  /** Size of each read buffer (files from this size on are memory-mapped instead). */
+  static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+  /** Outcome of the read of a file. */
+  enum class readStatus { OK, TOO_LARGE, FAILED };
+
+  /**
+   * Called on a worker with the content of a file; data is only valid for OK, during the call.
+   * For FAILED the caller opens the file itself, to report the error or to read it on its own.
+   */
+  using consume_t = std::function<void(
+    const std::string& filePath, size_t id, const char* data, size_t size, readStatus status)>;
+
+  /**
+   * @brief Sets up the ring and starts the reader thread; check valid() before use.
+   *
+   * @param workers Pool the files are counted on.
+   * @param consume Called once per added file.
+   */
+  readPipeline(threadPool& workers, consume_t consume);
+
+  /**
+   * @brief Finishes the pending reads (see finish()).
+   */
+  ~readPipeline();
+
+  readPipeline(const readPipeline&) = delete;
+  readPipeline& operator=(const readPipeline&) = delete;
+
+  /**
+   * @brief Checks if io_uring is available; if not, the caller reads files itself.
+   *
+   * @return True if files can be added.
+   */
+  bool valid() const { return reader.joinable(); }
+
+  /**
+   * @brief Queues a file to be read; blocks while the queue is full.
+   *
+   * @param filePath Path of the file.
+   * @param id Identifier handed back to consume.
+   */
+  void add(std::string filePath, size_t id);
+
+  /**
+   * @brief Waits until every added file was read and consumed.
+   */
+  void finish();
+
+private:
+  /** A file in flight; owns one read buffer. */
+  struct slot {
+    std::string path; /**< Path of the file */
+    size_t id = 0;    /**< Identifier of the file */
+    int fd = -1;      /**< Descriptor once open */
+    size_t expected = 0; /**< Size of the file when it was opened */
+    size_t filled = 0;   /**< Bytes read into its buffer so far */
+    bool busy = false; /**< Opened or read by the ring, not handed to the workers yet */
+  };
+
+  threadPool& pool;                   /**< Workers the files are counted on */
+  consume_t consume;                  /**< Counts a file */
+  std::unique_ptr<ioRing> ring;       /**< The io_uring instance */
+  std::unique_ptr<char[]> buffers;    /**< DEPTH buffers of BUFFER_SIZE bytes */
+  bool registered = false;            /**< The buffers are registered with the ring */
+  bool broken = false;                /**< io_uring_enter failed: the ring is given up */
+  std::vector<slot> slots;            /**< One per buffer */
+
+  std::mutex lock;                               /**< Guards what follows */
+  std::condition_variable readerWake;            /**< Work for the reader */
+  std::condition_variable spaceFree;             /**< Room in the queue */
+  std::deque<std::pair<std::string, size_t>> queue; /**< Files not yet opened */
+  std::vector<unsigned> freeSlots;               /**< Slots not in flight nor being counted */
+  bool done = false;                             /**< No more files will be added */
+  std::thread reader;                            /**< Drives the ring */
+
+  /**
+   * @brief Loop of the reader thread.
+   */
+  void run();
+
+  /**
+   * @brief Hands a file over to the workers; the slot is freed once it is consumed.
+   *
+   * @param index Slot of the file.
+   * @param size Bytes read into its buffer.
+   * @param status Outcome of the read.
+   */
+  void dispatch(unsigned index, size_t size, readStatus status);
+};
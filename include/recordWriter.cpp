@@ -0,0 +1,271 @@
+#include "./recordWriter.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "./jsonText.h"
+
+namespace {
+
+// Appends one row as a JSON object on a single line
+void jsonObject(tableWriter& out,
+                std::string_view prefix,
+                std::string_view name,
+                langId language,
+                const lineCounts& counts) {
+  out.text("{\"file\":\"");
+  jsonText::escape(out, prefix);
+  jsonText::escape(out, name);
+  out.text("\",\"language\":\"");
+  jsonText::escape(out, languageRegistry::name(language));
+  out.text("\",\"comments\":");
+  out.number(counts.comments);
+  out.text(",\"blank\":");
+  out.number(counts.blank);
+  out.text(",\"code\":");
+  out.number(counts.code);
+  out.text(",\"lines\":");
+  out.number(counts.lines);
+  out.put('}');
+}
+
+// Appends a CSV field (prefix then name), quoted (RFC 4180) when it holds a comma, a quote or a
+// line break
+void csvField(tableWriter& out, std::string_view prefix, std::string_view name) {
+  auto needsQuotes = [](std::string_view text) {
+    return text.find_first_of(",\"\r\n") != std::string_view::npos;
+  };
+  if (!needsQuotes(prefix) && !needsQuotes(name)) {
+    out.text(prefix);
+    out.text(name);
+    return;
+  }
+  out.put('"');
+  for (std::string_view part : { prefix, name }) {
+    size_t quote;
+    while ((quote = part.find('"')) != std::string_view::npos) {
+      out.text(part.substr(0, quote + 1));
+      out.put('"');
+      part.remove_prefix(quote + 1);
+    }
+    out.text(part);
+  }
+  out.put('"');
+}
+
+class jsonWriter : public recordWriter {
+public:
+  explicit jsonWriter(tableWriter& destination) : out(destination) {}
+
+  void begin(size_t, size_t) override { out.text("{\"files\":["); }
+
+  void row(std::string_view prefix,
+           std::string_view name,
+           langId language,
+           const lineCounts& counts,
+           std::uint64_t) override {
+    out.text(first ? "\n" : ",\n");
+    first = false;
+    jsonObject(out, prefix, name, language, counts);
+  }
+
+  void end(count_t files, const lineCounts& totals) override {
+    out.text("\n],\n\"totals\":{\"files\":");
+    out.number(files);
+    out.text(",\"comments\":");
+    out.number(totals.comments);
+    out.text(",\"blank\":");
+    out.number(totals.blank);
+    out.text(",\"code\":");
+    out.number(totals.code);
+    out.text(",\"lines\":");
+    out.number(totals.lines);
+    out.text("}}\n");
+  }
+
+private:
+  tableWriter& out;
+  bool first = true;
+};
+
+class ndjsonWriter : public recordWriter {
+public:
+  explicit ndjsonWriter(tableWriter& destination) : out(destination) {}
+
+  void begin(size_t, size_t) override {}
+
+  void row(std::string_view prefix,
+           std::string_view name,
+           langId language,
+           const lineCounts& counts,
+           std::uint64_t) override {
+    jsonObject(out, prefix, name, language, counts);
+    out.put('\n');
+  }
+
+  void end(count_t, const lineCounts&) override {}
+
+private:
+  tableWriter& out;
+};
+
+class csvWriter : public recordWriter {
+public:
+  explicit csvWriter(tableWriter& destination) : out(destination) {}
+
+  void begin(size_t, size_t) override { out.text("file,language,comments,blank,code,lines\n"); }
+
+  void row(std::string_view prefix,
+           std::string_view name,
+           langId language,
+           const lineCounts& counts,
+           std::uint64_t) override {
+    csvField(out, prefix, name);
+    out.put(',');
+    csvField(out, {}, languageRegistry::name(language));  // Names may come from --languages
+    out.put(',');
+    out.number(counts.comments);
+    out.put(',');
+    out.number(counts.blank);
+    out.put(',');
+    out.number(counts.code);
+    out.put(',');
+    out.number(counts.lines);
+    out.put('\n');
+  }
+
+  void end(count_t, const lineCounts&) override {}
+
+private:
+  tableWriter& out;
+};
+
+class binWriter : public recordWriter {
+public:
+  explicit binWriter(tableWriter& destination) : out(destination) {}
+
+  void begin(size_t rowCount, size_t pathBytes) override {
+    expectedRows = rowCount;
+    paths.reserve(pathBytes);
+
+    binFormat::header head{};
+    std::memcpy(head.magic, binFormat::MAGIC, sizeof(head.magic));
+    head.formatVersion = binFormat::VERSION;
+    head.rulesVersion = languageRegistry::rulesVersion();
+    head.rowCount = rowCount;
+    head.languageCount = languageRegistry::count();
+    head.rowSize = sizeof(binFormat::row);
+    head.languagesOffset = sizeof(binFormat::header);
+    head.rowsOffset = head.languagesOffset + head.languageCount * sizeof(binFormat::language);
+    head.stringsOffset = head.rowsOffset + rowCount * sizeof(binFormat::row);
+    head.stringsSize = pathBytes;
+    head.totalsOffset = head.stringsOffset + pathBytes;
+    head.shardIndex = shardIndex;
+    head.shardCount = shardCount;
+    head.argumentCount = argumentCount;
+    head.scopeHash = scopeHash;
+    write(head);
+
+    for (langId id = 0; id < languageRegistry::count(); id++) {
+      binFormat::language entry{};
+      std::string_view languageName = languageRegistry::name(id);
+      std::memcpy(entry.name,
+                  languageName.data(),
+                  std::min(languageName.size(), sizeof(entry.name) - 1));
+      write(entry);
+    }
+  }
+
+  void row(std::string_view prefix,
+           std::string_view name,
+           langId language,
+           const lineCounts& counts,
+           std::uint64_t ordinal) override {
+    binFormat::row record{};
+    record.comments = counts.comments;
+    record.blank = counts.blank;
+    record.code = counts.code;
+    record.lines = counts.lines;
+    record.pathOffset = paths.size();
+    record.ordinal = ordinal;
+    record.pathLength = static_cast<std::uint32_t>(prefix.size() + name.size());
+    record.language = language;
+    write(record);
+    paths.append(prefix);
+    paths.append(name);
+    writtenRows++;
+  }
+
+  void setShard(unsigned index,
+                unsigned count,
+                std::uint32_t arguments,
+                std::uint64_t scope) override {
+    shardIndex = index;
+    shardCount = count;
+    argumentCount = arguments;
+    scopeHash = scope;
+  }
+
+  void end(count_t files, const lineCounts& totals) override {
+    if (writtenRows != expectedRows) {
+      std::cerr << ">>>> Error: binary output announced " << expectedRows << " rows, got "
+                << writtenRows << "\n";
+    }
+    out.text(paths);
+    binFormat::totals sums{};
+    sums.files = files;
+    sums.comments = totals.comments;
+    sums.blank = totals.blank;
+    sums.code = totals.code;
+    sums.lines = totals.lines;
+    write(sums);
+  }
+
+private:
+  tableWriter& out;
+  std::string paths;        /**< Path blob, written after the rows */
+  size_t expectedRows = 0;  /**< Rows announced in the header */
+  size_t writtenRows = 0;   /**< Rows written so far */
+  std::uint32_t shardIndex = 0; /**< Shard of the rows */
+  std::uint32_t shardCount = 1; /**< Number of shards */
+  std::uint32_t argumentCount = 0; /**< Paths and lists counted */
+  std::uint64_t scopeHash = 0;     /**< What the run counts */
+
+  template <typename T>
+  void write(const T& value) {
+    out.text(std::string_view(reinterpret_cast<const char*>(&value), sizeof(value)));
+  }
+};
+
+}  // namespace
+
+std::unique_ptr<recordWriter> recordWriter::create(outputFormat format, tableWriter& out) {
+  switch (format) {
+  case outputFormat::JSON:
+    return std::make_unique<jsonWriter>(out);
+  case outputFormat::NDJSON:
+    return std::make_unique<ndjsonWriter>(out);
+  case outputFormat::CSV:
+    return std::make_unique<csvWriter>(out);
+  case outputFormat::BIN:
+    return std::make_unique<binWriter>(out);
+  default:
+    return nullptr;
+  }
+}
+
+bool recordWriter::parseFormat(const std::string& name, outputFormat& format) {
+  if (name == "table") {
+    format = outputFormat::TABLE;
+  } else if (name == "json") {
+    format = outputFormat::JSON;
+  } else if (name == "csv") {
+    format = outputFormat::CSV;
+  } else if (name == "ndjson") {
+    format = outputFormat::NDJSON;
+  } else if (name == "bin") {
+    format = outputFormat::BIN;
+  } else {
+    return false;
+  }
+  return true;
+}
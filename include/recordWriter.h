@@ -0,0 +1,161 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "./file.h"
+#include "./language.h"
+#include "./lexer.h"
+#include "./tableWriter.h"
+
+/**
+ * @brief Output formats of the results.
+ */
+enum class outputFormat { TABLE, JSON, CSV, NDJSON, BIN };
+
+/**
+ * @namespace binFormat
+ * @brief Layout of the `--format bin` output, meant to be memory-mapped by other tools.
+ *
+ * The file is a header, a table of language names, the rows (fixed-size records, in output order),
+ * a blob with the paths the rows point into and the totals. Integers are in the byte order of the
+ * machine that wrote the file; a reader that sees formatVersion byte-swapped knows it has to swap.
+ *
+ * A file written with --shard is a partial result: `--merge` puts the rows of all the shards back
+ * in the order of their ordinals, which is the order of an unsharded run.
+ */
+namespace binFormat {
+
+constexpr char MAGIC[8] = { 'S', 'L', 'O', 'C', 'K', 'F', 'B', '1' };
+constexpr std::uint32_t VERSION = 3;
+
+/** Start of the file. */
+struct header {
+  char magic[8];                 /**< MAGIC */
+  std::uint32_t formatVersion;   /**< VERSION */
+  std::uint32_t rulesVersion;    /**< languageRegistry::rulesVersion() of the counts */
+  std::uint64_t rowCount;        /**< Number of rows */
+  std::uint32_t languageCount;   /**< Entries in the language table */
+  std::uint32_t rowSize;         /**< sizeof(row) */
+  std::uint64_t languagesOffset; /**< Offset of the language table */
+  std::uint64_t rowsOffset;      /**< Offset of the first row */
+  std::uint64_t stringsOffset;   /**< Offset of the path blob */
+  std::uint64_t stringsSize;     /**< Size of the path blob */
+  std::uint64_t totalsOffset;    /**< Offset of the totals, right after the path blob */
+  std::uint32_t shardIndex;      /**< Shard of the rows, from 0 */
+  std::uint32_t shardCount;      /**< Number of shards of the run (1 if not sharded) */
+  std::uint32_t argumentCount;   /**< Paths and lists counted; the i-th gives its files the
+                                      ordinals from i << 40 */
+  std::uint32_t padding;
+  std::uint64_t scopeHash;       /**< Hash of the paths, lists and options that choose the files */
+};
+
+/** Entry of the language table: the name of a langId, NUL-padded. */
+struct language {
+  char name[32];
+};
+
+/** A counted file. */
+struct row {
+  std::uint64_t comments;   /**< Comment lines */
+  std::uint64_t blank;      /**< Blank lines */
+  std::uint64_t code;       /**< Code lines */
+  std::uint64_t lines;      /**< Total lines */
+  std::uint64_t pathOffset; /**< Start of the path in the blob */
+  std::uint64_t ordinal;    /**< Position of the file in an unsharded run (File::getOrdinal()) */
+  std::uint32_t pathLength; /**< Length of the path (not NUL-terminated) */
+  std::uint8_t language;    /**< Index into the language table */
+  std::uint8_t padding[3];
+};
+
+/** End of the file: the counts of every file of the shard, rows left out by --top included. */
+struct totals {
+  std::uint64_t files;    /**< Number of files */
+  std::uint64_t comments; /**< Comment lines */
+  std::uint64_t blank;    /**< Blank lines */
+  std::uint64_t code;     /**< Code lines */
+  std::uint64_t lines;    /**< Total lines */
+};
+
+static_assert(sizeof(header) == 96, "binary header layout changed");
+static_assert(sizeof(row) == 56, "binary row layout changed");
+static_assert(sizeof(totals) == 40, "binary totals layout changed");
+
+}  // namespace binFormat
+
+/**
+ * @class recordWriter
+ * @brief Streams rows to a machine-readable format (JSON, CSV, NDJSON or binary).
+ *
+ * Rows are rendered straight into a tableWriter: no row is ever materialized as a string, and only
+ * the binary writer keeps anything, a single blob with the paths.
+ */
+class recordWriter {
+public:
+  virtual ~recordWriter() = default;
+
+  /**
+   * @brief Creates the writer of a format.
+   *
+   * @param format Any format but TABLE.
+   * @param out Destination of the records.
+   * @return The writer.
+   */
+  static std::unique_ptr<recordWriter> create(outputFormat format, tableWriter& out);
+
+  /**
+   * @brief Parses the name of a format.
+   *
+   * @param name One of table, json, csv, ndjson and bin.
+   * @param format Receives the format.
+   * @return False if the name is unknown.
+   */
+  static bool parseFormat(const std::string& name, outputFormat& format);
+
+  /**
+   * @brief Starts the output.
+   *
+   * @param rowCount Number of rows that will follow (required by the binary format only).
+   * @param pathBytes Total length of their paths (required by the binary format only).
+   */
+  virtual void begin(size_t rowCount, size_t pathBytes) = 0;
+
+  /**
+   * @brief Records the shard the rows belong to and what the run counts; only the binary format
+   * keeps it.
+   *
+   * @param index Shard, from 0.
+   * @param count Number of shards.
+   * @param arguments Number of paths and lists counted.
+   * @param scope Hash of the paths, lists and options that choose the files.
+   */
+  virtual void setShard(unsigned /*index*/,
+                        unsigned /*count*/,
+                        std::uint32_t /*arguments*/,
+                        std::uint64_t /*scope*/) {}
+
+  /**
+   * @brief Writes the record of a file whose path is prefix followed by name.
+   *
+   * @param prefix First part of the path (e.g. the directory).
+   * @param name Second part of the path.
+   * @param language Language of the file.
+   * @param counts Line counts of the file.
+   * @param ordinal Position of the file in an unsharded run (only the binary format keeps it).
+   */
+  virtual void row(std::string_view prefix,
+                   std::string_view name,
+                   langId language,
+                   const lineCounts& counts,
+                   std::uint64_t ordinal)
+    = 0;
+
+  /**
+   * @brief Ends the output.
+   *
+   * @param files Number of rows written.
+   * @param totals Sum of their counts.
+   */
+  virtual void end(count_t files, const lineCounts& totals) = 0;
+};
@@ -0,0 +1,350 @@
+#include "./resultCache.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <tuple>
+#include <unistd.h>
+
+namespace {
+
+constexpr char MAGIC[8] = { 'S', 'L', 'O', 'C', 'K', 'F', 'C', '1' };
+constexpr std::uint32_t FORMAT_VERSION = 1;
+
+// On-disk layout (native byte order: a cache is not meant to travel between machines)
+struct fileHeader {
+  char magic[8];
+  std::uint32_t formatVersion;
+  std::uint32_t rulesVersion;
+  std::uint64_t recordCount;
+  std::uint64_t stringsOffset;
+  std::uint64_t stringsSize;
+};
+
+struct fileRecord {
+  std::uint64_t device;
+  std::uint64_t inode;
+  std::uint64_t size;
+  std::int64_t mtimeNs;
+  std::uint64_t pathHash;
+  std::uint64_t blank;
+  std::uint64_t comments;
+  std::uint64_t code;
+  std::uint64_t lines;
+  std::uint64_t pathOffset;
+  std::uint32_t pathLength;
+  std::uint8_t language;
+  std::uint8_t padding[3];
+};
+
+static_assert(sizeof(fileHeader) == 40, "cache header layout changed");
+static_assert(sizeof(fileRecord) == 88, "cache record layout changed");
+
+// FNV-1a: paths are short, so a simple hash is as fast as any
+std::uint64_t hashPath(const std::string& filePath) {
+  std::uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : filePath) {
+    hash = (hash ^ c) * 1099511628211ull;
+  }
+  return hash;
+}
+
+cacheKey keyOf(const fileRecord& record) {
+  return { record.device, record.inode, record.size, record.mtimeNs, record.pathHash };
+}
+
+bool writeAll(int fd, const void* data, size_t length) {
+  const char* p = static_cast<const char*>(data);
+  while (length > 0) {
+    ssize_t written = ::write(fd, p, length);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    p += written;
+    length -= static_cast<size_t>(written);
+  }
+  return true;
+}
+
+}  // namespace
+
+bool cacheKey::operator<(const cacheKey& other) const {
+  return std::tie(device, inode, size, mtimeNs, pathHash)
+         < std::tie(other.device, other.inode, other.size, other.mtimeNs, other.pathHash);
+}
+
+bool cacheKey::operator==(const cacheKey& other) const {
+  return device == other.device && inode == other.inode && size == other.size
+         && mtimeNs == other.mtimeNs && pathHash == other.pathHash;
+}
+
+resultCache::resultCache(const std::string& cachePath) : path(cachePath) {}
+
+resultCache::~resultCache() { unmap(); }
+
+void resultCache::unmap() {
+  if (map != nullptr) {
+    munmap(const_cast<unsigned char*>(map), mapLength);
+    map = nullptr;
+    mapLength = 0;
+    recordCount = 0;
+  }
+}
+
+bool resultCache::makeKey(const std::string& filePath, cacheKey& key) {
+  struct stat info {};
+  if (::stat(filePath.c_str(), &info) != 0) {
+    return false;
+  }
+  key.device = static_cast<std::uint64_t>(info.st_dev);
+  key.inode = static_cast<std::uint64_t>(info.st_ino);
+  key.size = static_cast<std::uint64_t>(info.st_size);
+  key.mtimeNs = static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+  key.pathHash = hashPath(filePath);
+  return true;
+}
+
+bool resultCache::load() {
+  unmap();
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return errno == ENOENT;  // No cache yet
+  }
+  struct stat info {};
+  if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(fileHeader))) {
+    ::close(fd);
+    return false;
+  }
+  size_t length = static_cast<size_t>(info.st_size);
+  void* address = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (address == MAP_FAILED) {
+    return false;
+  }
+  map = static_cast<const unsigned char*>(address);
+  mapLength = length;
+
+  // Validate the image; records are then searched in place
+  fileHeader header;
+  std::memcpy(&header, map, sizeof(header));
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.formatVersion != FORMAT_VERSION
+      || header.recordCount > (length - sizeof(fileHeader)) / sizeof(fileRecord)) {
+    unmap();
+    return false;
+  }
+  if (header.rulesVersion != languageRegistry::rulesVersion()) {
+    unmap();  // Counted with other rules: start over
+    return true;
+  }
+  recordCount = static_cast<size_t>(header.recordCount);
+  return true;
+}
+
+bool resultCache::lookup(const cacheKey& key, langId& language, lineCounts& counts) {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    seen.push_back(key);
+  }
+  if (recordCount == 0) {
+    return false;
+  }
+  const fileRecord* first = reinterpret_cast<const fileRecord*>(map + sizeof(fileHeader));
+  const fileRecord* last = first + recordCount;
+  const fileRecord* found
+    = std::lower_bound(first, last, key, [](const fileRecord& record, const cacheKey& wanted) {
+        return keyOf(record) < wanted;
+      });
+  if (found == last || !(keyOf(*found) == key)) {
+    return false;
+  }
+  language = found->language;
+  counts.blank = found->blank;
+  counts.comments = found->comments;
+  counts.code = found->code;
+  counts.lines = found->lines;
+  hitCount++;
+  return true;
+}
+
+void resultCache::store(const cacheKey& key,
+                        const std::string& filePath,
+                        langId language,
+                        const lineCounts& counts) {
+  std::lock_guard<std::mutex> guard(lock);
+  added.push_back({ key, filePath, language, counts });
+}
+
+bool resultCache::readEntries(const unsigned char* data, size_t length, std::vector<entry>& out) {
+  if (length < sizeof(fileHeader)) {
+    return false;
+  }
+  fileHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.formatVersion != FORMAT_VERSION
+      || header.recordCount > (length - sizeof(fileHeader)) / sizeof(fileRecord)
+      || header.stringsOffset > length || header.stringsSize > length - header.stringsOffset) {
+    return false;
+  }
+  if (header.rulesVersion != languageRegistry::rulesVersion()) {
+    return true;
+  }
+
+  const char* strings = reinterpret_cast<const char*>(data + header.stringsOffset);
+  for (std::uint64_t i = 0; i < header.recordCount; i++) {
+    fileRecord record;
+    std::memcpy(&record, data + sizeof(fileHeader) + i * sizeof(fileRecord), sizeof(record));
+    if (record.pathOffset > header.stringsSize
+        || record.pathLength > header.stringsSize - record.pathOffset) {
+      return false;
+    }
+    lineCounts counts;
+    counts.blank = record.blank;
+    counts.comments = record.comments;
+    counts.code = record.code;
+    counts.lines = record.lines;
+    out.push_back({ keyOf(record),
+                    std::string(strings + record.pathOffset, record.pathLength),
+                    record.language,
+                    counts });
+  }
+  return true;
+}
+
+bool resultCache::writeEntries(const std::vector<entry>& entries) const {
+  std::vector<fileRecord> records;
+  std::string strings;
+  records.reserve(entries.size());
+  for (const auto& e : entries) {
+    fileRecord record{};
+    record.device = e.key.device;
+    record.inode = e.key.inode;
+    record.size = e.key.size;
+    record.mtimeNs = e.key.mtimeNs;
+    record.pathHash = e.key.pathHash;
+    record.blank = e.counts.blank;
+    record.comments = e.counts.comments;
+    record.code = e.counts.code;
+    record.lines = e.counts.lines;
+    record.pathOffset = strings.size();
+    record.pathLength = static_cast<std::uint32_t>(e.path.size());
+    record.language = e.language;
+    strings += e.path;
+    records.push_back(record);
+  }
+
+  fileHeader header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.formatVersion = FORMAT_VERSION;
+  header.rulesVersion = languageRegistry::rulesVersion();
+  header.recordCount = records.size();
+  header.stringsOffset = sizeof(fileHeader) + records.size() * sizeof(fileRecord);
+  header.stringsSize = strings.size();
+
+  // Write a private copy, then swap it in: readers see either the old or the new cache
+  std::string temporary = path + ".tmp." + std::to_string(getpid());
+  int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = writeAll(fd, &header, sizeof(header))
+            && writeAll(fd, records.data(), records.size() * sizeof(fileRecord))
+            && writeAll(fd, strings.data(), strings.size());
+  ok = (::close(fd) == 0) && ok;
+  if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+    std::remove(temporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool resultCache::save(bool compact) {
+  std::lock_guard<std::mutex> guard(lock);
+
+  // Serialize writers; the lock file outlives the renames of the cache itself
+  std::string lockPath = path + ".lock";
+  int lockFd = ::open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (lockFd < 0) {
+    return false;
+  }
+  while (flock(lockFd, LOCK_EX) != 0) {
+    if (errno != EINTR) {
+      ::close(lockFd);
+      return false;
+    }
+  }
+
+  // Start from what is on disk now: another job may have saved since load()
+  std::vector<entry> merged;
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd >= 0) {
+    struct stat info {};
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+      size_t length = static_cast<size_t>(info.st_size);
+      void* address = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+      if (address != MAP_FAILED) {
+        if (!readEntries(static_cast<const unsigned char*>(address), length, merged)) {
+          merged.clear();  // Corrupt: rebuild from this run only
+        }
+        munmap(address, length);
+      }
+    }
+    ::close(fd);
+  }
+  size_t before = merged.size();
+  merged.insert(merged.end(), added.begin(), added.end());
+
+  // Sort by key; on duplicates the entry computed in this run wins (it comes last)
+  std::stable_sort(merged.begin(), merged.end(), [](const entry& a, const entry& b) {
+    return a.key < b.key;
+  });
+  std::vector<entry> unique;
+  unique.reserve(merged.size());
+  for (auto& e : merged) {
+    if (!unique.empty() && unique.back().key == e.key) {
+      unique.back() = std::move(e);
+    } else {
+      unique.push_back(std::move(e));
+    }
+  }
+
+  // Drop older versions of the files seen in this run, and with compaction anything stale
+  auto byPath = [](const cacheKey& a, const cacheKey& b) {
+    return a.pathHash != b.pathHash ? a.pathHash < b.pathHash : a < b;
+  };
+  std::sort(seen.begin(), seen.end(), byPath);
+  auto isStale = [&](const entry& e) {
+    auto range = std::equal_range(seen.begin(),
+                                  seen.end(),
+                                  cacheKey{ 0, 0, 0, 0, e.key.pathHash },
+                                  [](const cacheKey& a, const cacheKey& b) {
+                                    return a.pathHash < b.pathHash;
+                                  });
+    if (range.first != range.second) {
+      return !std::binary_search(range.first, range.second, e.key, byPath);
+    }
+    if (compact) {
+      cacheKey current;
+      return !makeKey(e.path, current) || !(current == e.key);
+    }
+    return false;
+  };
+  unique.erase(std::remove_if(unique.begin(), unique.end(), isStale), unique.end());
+
+  bool ok = true;
+  if (!added.empty() || unique.size() != before) {
+    ok = writeEntries(unique);
+  }
+  if (ok) {
+    added.clear();
+  }
+  flock(lockFd, LOCK_UN);
+  ::close(lockFd);
+  return ok;
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "./language.h"
+#include "./lexer.h"
+
+/**
+ * @struct cacheKey
+ * @brief Identity of a file version: where it lives and what its metadata says.
+ */
+struct cacheKey {
+  std::uint64_t device = 0;   /**< Device of the file */
+  std::uint64_t inode = 0;    /**< Inode of the file */
+  std::uint64_t size = 0;     /**< Size in bytes */
+  std::int64_t mtimeNs = 0;   /**< Modification time in nanoseconds */
+  std::uint64_t pathHash = 0; /**< Hash of the path the file was found at */
+
+  bool operator<(const cacheKey& other) const;
+  bool operator==(const cacheKey& other) const;
+};
+
+/**
+ * @class resultCache
+ * @brief Persistent store of line counts, so unchanged files are never read again.
+ *
+ * The cache file is a header followed by fixed-size records sorted by key and a blob with the
+ * paths. It is memory-mapped and searched in place, so loading costs nothing but the mapping. New
+ * results are kept in memory and merged into the file by save(), which holds an exclusive lock on
+ * a side lock file and replaces the cache with an atomic rename: parallel jobs sharing one cache
+ * never see a torn file and never lose each other's records.
+ */
+class resultCache {
+public:
+  /**
+   * @brief Creates a cache bound to a file (nothing is read until load()).
+   *
+   * @param cachePath Path of the cache file.
+   */
+  explicit resultCache(const std::string& cachePath);
+  ~resultCache();
+  resultCache(const resultCache&) = delete;
+  resultCache& operator=(const resultCache&) = delete;
+
+  /**
+   * @brief Maps the cache file. A missing file or one written with other rules is an empty cache.
+   *
+   * @return False if the file exists but is not a valid cache.
+   */
+  bool load();
+
+  /**
+   * @brief Builds the key of a file from its metadata.
+   *
+   * @param filePath Path of the file.
+   * @param key Receives the key.
+   * @return False if the file cannot be stat'ed.
+   */
+  static bool makeKey(const std::string& filePath, cacheKey& key);
+
+  /**
+   * @brief Looks up the counts of a file version (safe to call from several threads).
+   *
+   * Every key looked up is remembered, so save() can drop the records of older versions.
+   *
+   * @param key Key of the file.
+   * @param language Receives the language of the file.
+   * @param counts Receives the line counts.
+   * @return True on a hit.
+   */
+  bool lookup(const cacheKey& key, langId& language, lineCounts& counts);
+
+  /**
+   * @brief Records the counts of a file version (safe to call from several threads).
+   *
+   * @param key Key of the file.
+   * @param filePath Path of the file.
+   * @param language Language of the file.
+   * @param counts Line counts.
+   */
+  void store(const cacheKey& key,
+             const std::string& filePath,
+             langId language,
+             const lineCounts& counts);
+
+  /**
+   * @brief Writes the merged cache back to disk.
+   *
+   * Records superseded by a newer version of a file seen in this run are always dropped. With
+   * compaction, every record whose file is gone or changed is dropped as well.
+   *
+   * @param compact Whether to check every record against the filesystem.
+   * @return False if the cache could not be written.
+   */
+  bool save(bool compact);
+
+  /**
+   * @brief Gets the number of lookups that hit.
+   *
+   * @return Number of hits.
+   */
+  size_t hits() const { return hitCount.load(); }
+
+private:
+  /**
+   * @struct entry
+   * @brief A record kept in memory before it is written.
+   */
+  struct entry {
+    cacheKey key;       /**< Key of the file */
+    std::string path;   /**< Path of the file */
+    langId language;    /**< Language of the file */
+    lineCounts counts;  /**< Line counts */
+  };
+
+  std::string path;                   /**< Path of the cache file */
+  const unsigned char* map = nullptr; /**< Mapped cache file */
+  size_t mapLength = 0;               /**< Size of the mapping */
+  size_t recordCount = 0;             /**< Number of records in the mapping */
+  std::mutex lock;                    /**< Guards added and seen */
+  std::vector<entry> added;           /**< Results computed in this run */
+  std::vector<cacheKey> seen;         /**< Keys of every file looked up in this run */
+  std::atomic<size_t> hitCount{ 0 };  /**< Lookups that hit */
+
+  /**
+   * @brief Releases the mapping of the cache file.
+   */
+  void unmap();
+
+  /**
+   * @brief Validates a cache image and decodes its records.
+   *
+   * @param data Start of the image.
+   * @param length Size of the image.
+   * @param out Receives the records (nothing if the image was written with other rules).
+   * @return False if the image is not a valid cache.
+   */
+  static bool readEntries(const unsigned char* data, size_t length, std::vector<entry>& out);
+
+  /**
+   * @brief Writes a cache image next to the cache file and renames it over the cache.
+   *
+   * @param entries Records sorted by key.
+   * @return False on I/O errors.
+   */
+  bool writeEntries(const std::vector<entry>& entries) const;
+};
@@ -0,0 +1,127 @@
+#include "./resultStore.h"
+#include <algorithm>
+
+resultStore::resultStore() {
+  // Directory 0 is the empty prefix of paths without a slash
+  internDirectory("");
+}
+
+std::uint32_t resultStore::internDirectory(std::string_view dir) {
+  auto found = dirIds.find(std::string(dir));
+  if (found != dirIds.end()) {
+    return found->second;
+  }
+  std::uint32_t id = static_cast<std::uint32_t>(dirOffset.size());
+  dirOffset.push_back(dirArena.size());
+  dirLength.push_back(static_cast<std::uint32_t>(dir.size()));
+  dirArena.append(dir);
+  dirIds.emplace(std::string(dir), id);
+  return id;
+}
+
+void resultStore::reserve(size_t rows) {
+  rowDir.reserve(rows);
+  nameOffset.reserve(rows);
+  nameLength.reserve(rows);
+  rowLanguage.reserve(rows);
+  blankColumn.reserve(rows);
+  commentColumn.reserve(rows);
+  codeColumn.reserve(rows);
+  lineColumn.reserve(rows);
+  ordinalColumn.reserve(rows);
+}
+
+void resultStore::append(std::string_view filePath,
+                         langId language,
+                         const lineCounts& counts,
+                         std::uint64_t ordinal) {
+  // Files of the same directory come in runs, so check the previous row before hashing
+  size_t slash = filePath.rfind('/');
+  std::string_view dir = slash == std::string_view::npos ? std::string_view()
+                                                          : filePath.substr(0, slash + 1);
+  std::string_view fileName = filePath.substr(dir.size());
+  std::uint32_t dirId;
+  if (!rowDir.empty() && directory(rowDir.size() - 1) == dir) {
+    dirId = rowDir.back();
+  } else {
+    dirId = internDirectory(dir);
+  }
+
+  rowDir.push_back(dirId);
+  nameOffset.push_back(nameArena.size());
+  nameLength.push_back(static_cast<std::uint32_t>(fileName.size()));
+  nameArena.append(fileName);
+  rowLanguage.push_back(language);
+  blankColumn.push_back(counts.blank);
+  commentColumn.push_back(counts.comments);
+  codeColumn.push_back(counts.code);
+  lineColumn.push_back(counts.lines);
+  ordinalColumn.push_back(ordinal);
+}
+
+void resultStore::append(const File& file) {
+  lineCounts counts;
+  counts.blank = file.getBlankLines();
+  counts.comments = file.getComments();
+  counts.code = file.getnCodes();
+  counts.lines = file.getLines();
+  append(file.getFileName(), file.getLanguage(), counts, file.getOrdinal());
+}
+
+int resultStore::comparePaths(size_t a, size_t b) const {
+  if (rowDir[a] == rowDir[b]) {
+    return name(a).compare(name(b));
+  }
+  // Compare directory + name of both rows as if they were single strings
+  std::string_view partsA[2] = { directory(a), name(a) };
+  std::string_view partsB[2] = { directory(b), name(b) };
+  size_t ia = 0, ib = 0, pa = 0, pb = 0;
+  while (true) {
+    while (ia < 2 && pa == partsA[ia].size()) {
+      ia++;
+      pa = 0;
+    }
+    while (ib < 2 && pb == partsB[ib].size()) {
+      ib++;
+      pb = 0;
+    }
+    if (ia == 2 || ib == 2) {
+      return (ia == 2 ? 0 : 1) - (ib == 2 ? 0 : 1);
+    }
+    size_t n = std::min(partsA[ia].size() - pa, partsB[ib].size() - pb);
+    int result = partsA[ia].substr(pa, n).compare(partsB[ib].substr(pb, n));
+    if (result != 0) {
+      return result;
+    }
+    pa += n;
+    pb += n;
+  }
+}
+
+lineCounts resultStore::totals() const {
+  lineCounts sum;
+  for (size_t row = 0; row < size(); row++) {
+    sum.blank += blankColumn[row];
+    sum.comments += commentColumn[row];
+    sum.code += codeColumn[row];
+    sum.lines += lineColumn[row];
+  }
+  return sum;
+}
+
+size_t resultStore::memoryUsage() const {
+  // A node of the directory index holds a copy of the prefix and two pointers
+  size_t index = dirIds.bucket_count() * sizeof(void*)
+                 + dirIds.size() * (sizeof(std::pair<const std::string, std::uint32_t>)
+                                    + 2 * sizeof(void*))
+                 + dirArena.capacity();
+  return dirArena.capacity() + nameArena.capacity() + index
+         + dirOffset.capacity() * sizeof(std::uint64_t)
+         + dirLength.capacity() * sizeof(std::uint32_t)
+         + rowDir.capacity() * sizeof(std::uint32_t) + nameOffset.capacity() * sizeof(std::uint64_t)
+         + nameLength.capacity() * sizeof(std::uint32_t) + rowLanguage.capacity() * sizeof(langId)
+         + (blankColumn.capacity() + commentColumn.capacity() + codeColumn.capacity()
+            + lineColumn.capacity())
+             * sizeof(count_t)
+         + ordinalColumn.capacity() * sizeof(std::uint64_t);
+}
@@ -0,0 +1,174 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "./file.h"
+#include "./language.h"
+#include "./lexer.h"
+
+/**
+ * @class resultStore
+ * @brief Column-oriented table of the counted files.
+ *
+ * Each row is a file. Paths are split into a directory, interned once no matter how many files it
+ * holds, and a file name kept in one contiguous arena. The language is a langId and every counter
+ * lives in its own array. Rows are addressed by index and read through string_views, so sorting,
+ * aggregating and printing never allocate per row.
+ */
+class resultStore {
+private:
+  std::string dirArena;                             /**< Directory prefixes, back to back */
+  std::vector<std::uint64_t> dirOffset;             /**< Start of each directory in dirArena */
+  std::vector<std::uint32_t> dirLength;             /**< Length of each directory */
+  std::unordered_map<std::string, std::uint32_t> dirIds; /**< Directory prefix -> id */
+
+  std::string nameArena;                  /**< File names, back to back */
+  std::vector<std::uint32_t> rowDir;      /**< Directory id of each row */
+  std::vector<std::uint64_t> nameOffset;  /**< Start of each file name in nameArena */
+  std::vector<std::uint32_t> nameLength;  /**< Length of each file name */
+  std::vector<langId> rowLanguage;        /**< Language of each row */
+  std::vector<count_t> blankColumn;       /**< Blank lines of each row */
+  std::vector<count_t> commentColumn;     /**< Comment lines of each row */
+  std::vector<count_t> codeColumn;        /**< Code lines of each row */
+  std::vector<count_t> lineColumn;        /**< Total lines of each row */
+  std::vector<std::uint64_t> ordinalColumn; /**< Position of each row in an unsharded run */
+
+  /**
+   * @brief Gets the id of a directory prefix, interning it on first sight.
+   *
+   * @param dir Directory prefix, trailing slash included.
+   * @return Directory id.
+   */
+  std::uint32_t internDirectory(std::string_view dir);
+
+public:
+  resultStore();
+
+  /**
+   * @brief Appends a counted file.
+   *
+   * @param filePath Path of the file.
+   * @param language Language of the file.
+   * @param counts Line counts of the file.
+   * @param ordinal Position of the file among all the files of the run (see File::getOrdinal()).
+   */
+  void append(std::string_view filePath,
+              langId language,
+              const lineCounts& counts,
+              std::uint64_t ordinal);
+
+  /**
+   * @brief Appends a counted file whose ordinal is its row index.
+   *
+   * @param filePath Path of the file.
+   * @param language Language of the file.
+   * @param counts Line counts of the file.
+   */
+  void append(std::string_view filePath, langId language, const lineCounts& counts) {
+    append(filePath, language, counts, size());
+  }
+
+  /**
+   * @brief Appends a counted file, with its ordinal.
+   *
+   * @param file The counted file.
+   */
+  void append(const File& file);
+
+  /**
+   * @brief Reserves room for more rows.
+   *
+   * @param rows Number of rows expected in total.
+   */
+  void reserve(size_t rows);
+
+  /**
+   * @brief Gets the number of rows.
+   *
+   * @return Number of files in the store.
+   */
+  size_t size() const { return rowDir.size(); }
+
+  /**
+   * @brief Checks if the store is empty.
+   *
+   * @return True if no file was stored.
+   */
+  bool empty() const { return rowDir.empty(); }
+
+  /**
+   * @brief Gets the directory part of a path, trailing slash included.
+   *
+   * @param row Row index.
+   * @return Directory prefix (empty for paths without a slash).
+   */
+  std::string_view directory(size_t row) const {
+    std::uint32_t dir = rowDir[row];
+    return std::string_view(dirArena).substr(dirOffset[dir], dirLength[dir]);
+  }
+
+  /**
+   * @brief Gets the file name part of a path.
+   *
+   * @param row Row index.
+   * @return File name.
+   */
+  std::string_view name(size_t row) const {
+    return std::string_view(nameArena).substr(nameOffset[row], nameLength[row]);
+  }
+
+  /**
+   * @brief Gets the length of the full path of a row.
+   *
+   * @param row Row index.
+   * @return Length of directory plus file name.
+   */
+  size_t pathLength(size_t row) const { return dirLength[rowDir[row]] + nameLength[row]; }
+
+  /**
+   * @brief Compares the full paths of two rows, without building them.
+   *
+   * @param a First row.
+   * @param b Second row.
+   * @return Negative, zero or positive, like std::string::compare.
+   */
+  int comparePaths(size_t a, size_t b) const;
+
+  langId language(size_t row) const { return rowLanguage[row]; }  /**< Language of a row */
+  count_t blank(size_t row) const { return blankColumn[row]; }     /**< Blank lines of a row */
+  count_t comments(size_t row) const { return commentColumn[row]; } /**< Comment lines of a row */
+  count_t code(size_t row) const { return codeColumn[row]; }       /**< Code lines of a row */
+  count_t lines(size_t row) const { return lineColumn[row]; }      /**< Total lines of a row */
+  std::uint64_t ordinal(size_t row) const { return ordinalColumn[row]; } /**< Ordinal of a row */
+
+  /**
+   * @brief Gets the line counts of a row.
+   *
+   * @param row Row index.
+   * @return Line counts.
+   */
+  lineCounts counts(size_t row) const {
+    lineCounts c;
+    c.blank = blankColumn[row];
+    c.comments = commentColumn[row];
+    c.code = codeColumn[row];
+    c.lines = lineColumn[row];
+    return c;
+  }
+
+  /**
+   * @brief Estimates the heap memory held by the store, spare capacity included.
+   *
+   * @return Bytes of the arenas, columns and directory index.
+   */
+  size_t memoryUsage() const;
+
+  /**
+   * @brief Sums the counts of every row.
+   *
+   * @return Totals of the store.
+   */
+  lineCounts totals() const;
+};
@@ -0,0 +1,171 @@
+#include "./simdScan.h"
+#if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h>
+# define SLOC_X86 1
+#endif
+
+namespace {
+
+using find_fn = const char* (*)(const char*, const char*, char, char, char);
+using find_set_fn = const char* (*)(const char*, const char*, const char*, unsigned);
+
+const char* findAnyScalar(const char* p, const char* end, char a, char b, char c) {
+  for (; p < end; p++) {
+    if (*p == a || *p == b || *p == c) {
+      return p;
+    }
+  }
+  return end;
+}
+
+const char* findFirstOfScalar(const char* p, const char* end, const char* set, unsigned count) {
+  for (; p < end; p++) {
+    for (unsigned k = 0; k < count; k++) {
+      if (*p == set[k]) {
+        return p;
+      }
+    }
+  }
+  return end;
+}
+
+#ifdef SLOC_X86
+// SSE2 is part of the x86-64 baseline, so this kernel needs no target attribute
+const char* findAnySse2(const char* p, const char* end, char a, char b, char c) {
+  const __m128i va = _mm_set1_epi8(a);
+  const __m128i vb = _mm_set1_epi8(b);
+  const __m128i vc = _mm_set1_epi8(c);
+  for (; end - p >= 16; p += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, va), _mm_cmpeq_epi8(chunk, vb)),
+                                _mm_cmpeq_epi8(chunk, vc));
+    int mask = _mm_movemask_epi8(hits);
+    if (mask != 0) {
+      return p + __builtin_ctz(static_cast<unsigned>(mask));
+    }
+  }
+  return findAnyScalar(p, end, a, b, c);
+}
+
+__attribute__((target("avx2"))) const char* findAnyAvx2(const char* p,
+                                                        const char* end,
+                                                        char a,
+                                                        char b,
+                                                        char c) {
+  const __m256i va = _mm256_set1_epi8(a);
+  const __m256i vb = _mm256_set1_epi8(b);
+  const __m256i vc = _mm256_set1_epi8(c);
+  for (; end - p >= 32; p += 32) {
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i hits = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(chunk, va), _mm256_cmpeq_epi8(chunk, vb)),
+      _mm256_cmpeq_epi8(chunk, vc));
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+    if (mask != 0) {
+      return p + __builtin_ctz(mask);
+    }
+  }
+  return findAnySse2(p, end, a, b, c);
+}
+
+const char* findFirstOfSse2(const char* p, const char* end, const char* set, unsigned count) {
+  __m128i needles[simd::MAX_SET];
+  for (unsigned k = 0; k < count; k++) {
+    needles[k] = _mm_set1_epi8(set[k]);
+  }
+  for (; end - p >= 16; p += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i hits = _mm_setzero_si128();
+    for (unsigned k = 0; k < count; k++) {
+      hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, needles[k]));
+    }
+    int mask = _mm_movemask_epi8(hits);
+    if (mask != 0) {
+      return p + __builtin_ctz(static_cast<unsigned>(mask));
+    }
+  }
+  return findFirstOfScalar(p, end, set, count);
+}
+
+__attribute__((target("avx2"))) const char* findFirstOfAvx2(const char* p,
+                                                            const char* end,
+                                                            const char* set,
+                                                            unsigned count) {
+  __m256i needles[simd::MAX_SET];
+  for (unsigned k = 0; k < count; k++) {
+    needles[k] = _mm256_set1_epi8(set[k]);
+  }
+  for (; end - p >= 32; p += 32) {
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i hits = _mm256_setzero_si256();
+    for (unsigned k = 0; k < count; k++) {
+      hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, needles[k]));
+    }
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+    if (mask != 0) {
+      return p + __builtin_ctz(mask);
+    }
+  }
+  return findFirstOfSse2(p, end, set, count);
+}
+#endif
+
+struct kernel {
+  find_fn findAny;
+  find_set_fn findFirstOf;
+  const char* name;
+};
+
+kernel selectKernel() {
+#ifdef SLOC_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return { findAnyAvx2, findFirstOfAvx2, "avx2" };
+  }
+  return { findAnySse2, findFirstOfSse2, "sse2" };
+#else
+  return { findAnyScalar, findFirstOfScalar, "scalar" };
+#endif
+}
+
+const kernel& activeKernel() {
+  static const kernel selected = selectKernel();
+  return selected;
+}
+
+}  // namespace
+
+namespace simd {
+
+const char* findAny(const char* begin, const char* end, char a, char b, char c) {
+  // Short ranges are cheaper to walk than to dispatch
+  if (end - begin < 16) {
+    return findAnyScalar(begin, end, a, b, c);
+  }
+  return activeKernel().findAny(begin, end, a, b, c);
+}
+
+const char* findPair(const char* begin, const char* end, char a, char b) {
+  while (begin < end) {
+    const char* hit = find(begin, end, a);
+    if (hit + 1 >= end) {
+      return end;
+    }
+    if (hit[1] == b) {
+      return hit;
+    }
+    begin = hit + 1;
+  }
+  return end;
+}
+
+const char* findFirstOf(const char* begin, const char* end, const char* set, unsigned count) {
+  if (end - begin < 16) {
+    return findFirstOfScalar(begin, end, set, count);
+  }
+  return activeKernel().findFirstOf(begin, end, set, count);
+}
+
+const char* kernelName() { return activeKernel().name; }
+
+}  // namespace simd
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+
+/**
+ * @namespace simd
+ * @brief Vectorized byte searches used by the lexer.
+ *
+ * Every search has an AVX2 kernel, an SSE2 kernel and a scalar fallback. The best kernel supported
+ * by the running CPU is picked once, on first use.
+ */
+namespace simd {
+
+/**
+ * @brief Finds the first byte equal to any of three needles.
+ *
+ * Pass the same needle more than once to search for fewer bytes.
+ *
+ * @param begin Start of the range.
+ * @param end End of the range.
+ * @param a First needle.
+ * @param b Second needle.
+ * @param c Third needle.
+ * @return Pointer to the first matching byte, or end if there is none.
+ */
+const char* findAny(const char* begin, const char* end, char a, char b, char c);
+
+/**
+ * @brief Finds the first occurrence of a single byte.
+ *
+ * @param begin Start of the range.
+ * @param end End of the range.
+ * @param a Needle.
+ * @return Pointer to the first matching byte, or end if there is none.
+ */
+inline const char* find(const char* begin, const char* end, char a) {
+  return findAny(begin, end, a, a, a);
+}
+
+/**
+ * @brief Finds the first occurrence of a two-byte sequence.
+ *
+ * @param begin Start of the range.
+ * @param end End of the range.
+ * @param a First byte of the sequence.
+ * @param b Second byte of the sequence.
+ * @return Pointer to the first byte of the sequence, or end if there is none.
+ */
+const char* findPair(const char* begin, const char* end, char a, char b);
+
+/**
+ * @brief Finds the first byte that belongs to a small set.
+ *
+ * @param begin Start of the range.
+ * @param end End of the range.
+ * @param set Bytes to look for.
+ * @param count Number of bytes in set (at most MAX_SET).
+ * @return Pointer to the first matching byte, or end if there is none.
+ */
+const char* findFirstOf(const char* begin, const char* end, const char* set, unsigned count);
+
+/** Largest set accepted by findFirstOf. */
+constexpr unsigned MAX_SET = 8;
+
+/**
+ * @brief Gets the name of the kernel selected for this CPU.
+ *
+ * @return "avx2", "sse2" or "scalar".
+ */
+const char* kernelName();
+
+}  // namespace simd
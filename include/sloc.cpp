@@ -0,0 +1,45 @@
+#include "./sloc.h"
+#include <algorithm>
+
+namespace {
+
+// Bytes of a new chunk joined to the carry: enough to finish any delimiter the carry starts
+constexpr size_t STITCH_BYTES = 64;
+
+}  // namespace
+
+lineCounts sloc::count(std::string_view content, langId language) {
+  return lexer::count(languageRegistry::tables(language), content.data(), content.size());
+}
+
+sloc::chunkCounter::chunkCounter(langId language) : tables(&languageRegistry::tables(language)) {}
+
+void sloc::chunkCounter::feed(std::string_view chunk) {
+  if (!carry.empty()) {
+    // Finish the split delimiter on a copy, then go on in the chunk itself
+    size_t carried = carry.size();
+    carry.append(chunk.data(), std::min(chunk.size(), STITCH_BYTES));
+    size_t consumed = lexer::scan(*tables, state, carry.data(), carry.size(), counts, false);
+    if (consumed < carried) {
+      // Still too short to decide (the chunk was tiny): wait for more
+      carry.erase(0, consumed);
+      carry.append(chunk.data() + std::min(chunk.size(), STITCH_BYTES),
+                   chunk.size() - std::min(chunk.size(), STITCH_BYTES));
+      return;
+    }
+    chunk.remove_prefix(consumed - carried);
+    carry.clear();
+  }
+  size_t consumed = lexer::scan(*tables, state, chunk.data(), chunk.size(), counts, false);
+  carry.assign(chunk.data() + consumed, chunk.size() - consumed);
+}
+
+lineCounts sloc::chunkCounter::finish() {
+  lexer::scan(*tables, state, carry.data(), carry.size(), counts, true);
+  lexer::finish(*tables, state, counts);
+  lineCounts total = counts;
+  state = lexState();
+  counts = lineCounts();
+  carry.clear();
+  return total;
+}
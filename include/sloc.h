@@ -0,0 +1,70 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include "./language.h"
+#include "./lexer.h"
+
+/**
+ * @namespace sloc
+ * @brief Public interface of libsloc: counts source held in memory, without files or processes.
+ *
+ * Languages are the identifiers of lang (or languageRegistry::fromPath / fromExtension), counts
+ * are lineCounts. The content is read where it lies; nothing is copied but the few bytes of a
+ * delimiter split between two chunks.
+ */
+namespace sloc {
+
+/**
+ * @brief Counts the lines of a whole piece of source.
+ *
+ * @param content The source.
+ * @param language Language of the source (unknown identifiers get the C rules).
+ * @return Counts of blank, comment, code and total lines.
+ */
+lineCounts count(std::string_view content, langId language);
+
+/**
+ * @class chunkCounter
+ * @brief Counts a source given in consecutive chunks of any size, e.g. as it is received.
+ *
+ * The lexer state travels from one chunk to the next, so feeding the chunks of a source and then
+ * calling finish() gives exactly the counts of count() on the whole source.
+ */
+class chunkCounter {
+public:
+  /**
+   * @brief Starts counting a source.
+   *
+   * @param language Language of the source.
+   */
+  explicit chunkCounter(langId language);
+
+  /**
+   * @brief Counts the next chunk of the source; the chunk need not outlive the call.
+   *
+   * @param chunk The bytes following the previous chunk.
+   */
+  void feed(std::string_view chunk);
+
+  /**
+   * @brief Counts the end of the source (and its last line, if unterminated).
+   *
+   * @return Counts of the whole source. The counter can then start on another source.
+   */
+  lineCounts finish();
+
+  /**
+   * @brief Gets the counts of the lines completed so far.
+   *
+   * @return Counts without the line in progress.
+   */
+  const lineCounts& partial() const { return counts; }
+
+private:
+  const lexTables* tables; /**< Tables of the language */
+  lexState state;          /**< Lexer state at the end of what was consumed */
+  lineCounts counts;       /**< Lines completed so far */
+  std::string carry;       /**< Bytes left unconsumed at the end of the last chunk */
+};
+
+}  // namespace sloc
@@ -0,0 +1,153 @@
+#include "./sortEngine.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include "./language.h"
+
+namespace {
+
+// A row and its sort key: 16 bytes, so the radix passes stream through memory
+struct keyedRow {
+  std::uint64_t key;
+  std::uint32_t row;
+};
+
+// Stable LSD radix sort on the key, one byte per pass; bytes equal in every key cost no pass
+void radixSort(std::vector<keyedRow>& items) {
+  static constexpr int PASSES = sizeof(std::uint64_t);
+  std::vector<std::array<size_t, 256>> histogram(PASSES);
+  for (auto& counts : histogram) {
+    counts.fill(0);
+  }
+  for (const keyedRow& item : items) {
+    for (int pass = 0; pass < PASSES; pass++) {
+      histogram[pass][(item.key >> (8 * pass)) & 0xFF]++;
+    }
+  }
+
+  std::vector<keyedRow> scratch(items.size());
+  for (int pass = 0; pass < PASSES; pass++) {
+    auto& counts = histogram[pass];
+    if (std::find(counts.begin(), counts.end(), items.size()) != counts.end()) {
+      continue;  // Every key has the same byte here: the pass would not move anything
+    }
+    size_t position = 0;
+    for (size_t& count : counts) {
+      size_t next = position + count;
+      count = position;
+      position = next;
+    }
+    for (const keyedRow& item : items) {
+      scratch[counts[(item.key >> (8 * pass)) & 0xFF]++] = item;
+    }
+    items.swap(scratch);
+  }
+}
+
+// Byte of the path of a row (directory then name), or 0 past its end
+unsigned char pathByte(const resultStore& db, size_t row, size_t position) {
+  std::string_view directory = db.directory(row);
+  if (position < directory.size()) {
+    return static_cast<unsigned char>(directory[position]);
+  }
+  std::string_view name = db.name(row);
+  position -= directory.size();
+  return position < name.size() ? static_cast<unsigned char>(name[position]) : 0;
+}
+
+// Length of the prefix shared by the paths of all rows
+size_t commonPrefix(const resultStore& db) {
+  size_t length = db.pathLength(0);
+  for (size_t row = 1; row < db.size() && length > 0; row++) {
+    length = std::min(length, db.pathLength(row));
+    size_t same = 0;
+    while (same < length && pathByte(db, row, same) == pathByte(db, 0, same)) {
+      same++;
+    }
+    length = same;
+  }
+  return length;
+}
+
+}  // namespace
+
+sortEngine::sortEngine(const resultStore& store) : db(store) {}
+
+std::vector<size_t> sortEngine::order(char column, bool descending, size_t top) const {
+  std::vector<keyedRow> items(db.size());
+  if (items.empty()) {
+    return {};
+  }
+
+  // Languages sort by name: rank them once instead of comparing strings
+  std::vector<std::uint64_t> typeRank(languageRegistry::count());
+  if (column == 't') {
+    std::vector<langId> ids(languageRegistry::count());
+    for (size_t id = 0; id < ids.size(); id++) {
+      ids[id] = static_cast<langId>(id);
+    }
+    std::stable_sort(ids.begin(), ids.end(), [](langId a, langId b) {
+      return languageRegistry::name(a) < languageRegistry::name(b);
+    });
+    for (size_t rank = 0; rank < ids.size(); rank++) {
+      typeRank[ids[rank]] = rank;
+    }
+  }
+  // Paths: 8 bytes past the shared prefix, big-endian so the key orders like the bytes
+  size_t prefix = column == 'f' ? commonPrefix(db) : 0;
+
+  for (size_t row = 0; row < items.size(); row++) {
+    std::uint64_t key = 0;
+    switch (column) {
+    case 'f':
+      for (size_t k = 0; k < sizeof(key); k++) {
+        key = (key << 8) | pathByte(db, row, prefix + k);
+      }
+      break;
+    case 't':
+      key = typeRank[db.language(row)];
+      break;
+    case 'c':
+      key = db.comments(row);
+      break;
+    case 'b':
+      key = db.blank(row);
+      break;
+    case 's':
+      key = db.code(row);
+      break;
+    default:
+      key = db.lines(row);
+      break;
+    }
+    // Complementing the key reverses the order, and the sort stays stable
+    items[row] = { descending ? ~key : key, static_cast<std::uint32_t>(row) };
+  }
+  radixSort(items);
+
+  size_t wanted = (top == 0 || top > items.size()) ? items.size() : top;
+  if (column == 'f') {
+    // Paths whose keys tie are told apart by the rest of their bytes
+    auto before = [this, descending](const keyedRow& a, const keyedRow& b) {
+      int result = db.comparePaths(a.row, b.row);
+      return descending ? result > 0 : result < 0;
+    };
+    for (size_t first = 0; first < wanted;) {
+      size_t last = first + 1;
+      while (last < items.size() && items[last].key == items[first].key) {
+        last++;
+      }
+      if (last - first > 1) {
+        std::stable_sort(items.begin() + first, items.begin() + last, before);
+      }
+      first = last;
+    }
+  }
+
+  std::vector<size_t> rows(wanted);
+  for (size_t position = 0; position < wanted; position++) {
+    rows[position] = items[position].row;
+  }
+  return rows;
+}
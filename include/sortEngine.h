@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "./resultStore.h"
+
+/**
+ * @class sortEngine
+ * @brief Orders the rows of a resultStore by one of the table columns.
+ *
+ * The sort key of every row is read once into a compact (key, row) array, which an LSD radix sort
+ * orders in linear time. Numeric columns are their own key, languages are ranked by name, and paths
+ * use their first 8 bytes past the prefix all paths share, so only rows whose keys tie are compared
+ * as strings afterwards. Every order is stable: rows that tie keep their order of appearance, in
+ * both directions.
+ */
+class sortEngine {
+public:
+  /**
+   * @brief Creates an engine for a store.
+   *
+   * @param store Rows to order (at most 2^32 of them).
+   */
+  explicit sortEngine(const resultStore& store);
+
+  /**
+   * @brief Orders the rows.
+   *
+   * @param column One of f (path), t (language), c (comments), b (blank), s (code) and a (lines).
+   * @param descending Order from the largest key down.
+   * @param top Rows wanted (0 = all); the order is only guaranteed for the ones returned.
+   * @return Row indices in order.
+   */
+  std::vector<size_t> order(char column, bool descending, size_t top = 0) const;
+
+private:
+  const resultStore& db; /**< Rows to order */
+};
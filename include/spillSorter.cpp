@@ -0,0 +1,387 @@
+#include "./spillSorter.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "./sortEngine.h"
+#include "./tracer.h"
+
+namespace {
+
+// What sortEngine allocates per row while it orders a store: keys, their scratch copy, the order
+constexpr size_t SORT_BYTES_PER_ROW = 40;
+// Encoded records are written in pieces of this size
+constexpr size_t WRITE_BUFFER = 1024 * 1024;
+
+void putVarint(std::string& out, std::uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+// Record layout: path length, path, language byte, blank, comments, code, lines and ordinal
+void putRecord(std::string& out,
+               std::string_view prefix,
+               std::string_view name,
+               langId language,
+               const lineCounts& counts,
+               std::uint64_t ordinal) {
+  putVarint(out, prefix.size() + name.size());
+  out.append(prefix);
+  out.append(name);
+  out.push_back(static_cast<char>(language));
+  putVarint(out, counts.blank);
+  putVarint(out, counts.comments);
+  putVarint(out, counts.code);
+  putVarint(out, counts.lines);
+  putVarint(out, ordinal);
+}
+
+bool getVarint(const char*& p, const char* end, std::uint64_t& value) {
+  value = 0;
+  for (int shift = 0; p < end && shift < 64; shift += 7) {
+    auto byte = static_cast<unsigned char>(*p++);
+    value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+    if (byte < 0x80) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Decodes the record at p; false if [p, end) does not hold all of it
+bool getRecord(const char*& p, const char* end, spillSorter::record& out) {
+  const char* at = p;
+  std::uint64_t length;
+  if (!getVarint(at, end, length) || static_cast<std::uint64_t>(end - at) < length + 1) {
+    return false;
+  }
+  out.path.assign(at, length);
+  at += length;
+  out.language = static_cast<langId>(*at++);
+  if (!getVarint(at, end, out.counts.blank) || !getVarint(at, end, out.counts.comments)
+      || !getVarint(at, end, out.counts.code) || !getVarint(at, end, out.counts.lines)
+      || !getVarint(at, end, out.ordinal)) {
+    return false;
+  }
+  p = at;
+  return true;
+}
+
+// Reads the records of one run through a buffer
+class runReader {
+public:
+  runReader(int file, std::uint64_t begin, std::uint64_t end)
+      : fd(file), position(begin), limit(end), buffer(spillSorter::READ_BUFFER, '\0') {}
+
+  // Reads the next record; false at the end of the run or on an error
+  bool next(spillSorter::record& out, std::string& error) {
+    while (true) {
+      const char* p = buffer.data() + start;
+      if (getRecord(p, buffer.data() + filled, out)) {
+        start = static_cast<size_t>(p - buffer.data());
+        return true;
+      }
+      if (position == limit) {
+        if (start != filled) {
+          error = "truncated run in the temporary file";
+        }
+        return false;
+      }
+      if (!fill(error)) {
+        return false;
+      }
+    }
+  }
+
+private:
+  int fd;
+  std::uint64_t position;  // Next byte of the run to read
+  std::uint64_t limit;     // End of the run
+  std::string buffer;
+  size_t start = 0;        // First byte not decoded yet
+  size_t filled = 0;       // End of the bytes read
+
+  bool fill(std::string& error) {
+    // Keep the partial record, and make room for it if it fills the whole buffer
+    std::memmove(buffer.data(), buffer.data() + start, filled - start);
+    filled -= start;
+    start = 0;
+    if (filled == buffer.size()) {
+      buffer.resize(buffer.size() * 2);
+    }
+    size_t wanted = static_cast<size_t>(std::min<std::uint64_t>(buffer.size() - filled,
+                                                                limit - position));
+    ssize_t got = pread(fd, buffer.data() + filled, wanted, static_cast<off_t>(position));
+    if (got <= 0) {
+      error = std::string("cannot read the temporary file: ")
+              + (got < 0 ? std::strerror(errno) : "unexpected end");
+      return false;
+    }
+    filled += static_cast<size_t>(got);
+    position += static_cast<std::uint64_t>(got);
+    return true;
+  }
+};
+
+}  // namespace
+
+spillSorter::spillSorter(size_t bytes, char sortColumn, bool reverse, size_t rowsWanted)
+    : budget(std::max(bytes, MIN_BUDGET)),
+      column(sortColumn),
+      descending(reverse),
+      top(rowsWanted) {
+  // Same ranks as sortEngine, so languages with the same name tie the same way
+  if (column == 't') {
+    std::vector<langId> ids(languageRegistry::count());
+    for (size_t id = 0; id < ids.size(); id++) {
+      ids[id] = static_cast<langId>(id);
+    }
+    std::stable_sort(ids.begin(), ids.end(), [](langId a, langId b) {
+      return languageRegistry::name(a) < languageRegistry::name(b);
+    });
+    typeRank.resize(ids.size());
+    for (size_t rank = 0; rank < ids.size(); rank++) {
+      typeRank[ids[rank]] = rank;
+    }
+  }
+}
+
+spillSorter::~spillSorter() {
+  if (fd >= 0) {
+    ::close(fd);
+  }
+}
+
+bool spillSorter::append(const File& file) {
+  lineCounts counts;
+  counts.blank = file.getBlankLines();
+  counts.comments = file.getComments();
+  counts.code = file.getnCodes();
+  counts.lines = file.getLines();
+  store.append(file.getFileName(), file.getLanguage(), counts, file.getOrdinal());
+
+  rows++;
+  sum.blank += counts.blank;
+  sum.comments += counts.comments;
+  sum.code += counts.code;
+  sum.lines += counts.lines;
+  longest = std::max(longest, file.getFileName().size());
+  allPathBytes += file.getFileName().size();
+
+  if (store.memoryUsage() + store.size() * SORT_BYTES_PER_ROW < budget) {
+    return true;
+  }
+  return spill();
+}
+
+bool spillSorter::spill() {
+  traceSpan span("spill", "io");
+  std::vector<size_t> order;
+  if (column != '\0') {
+    order = sortEngine(store).order(column, descending, top);
+  } else {
+    order.resize(store.size());
+    for (size_t row = 0; row < order.size(); row++) {
+      order[row] = row;
+    }
+  }
+
+  std::uint64_t begin = fileEnd;
+  std::string encoded;
+  encoded.reserve(WRITE_BUFFER + 64);
+  for (size_t row : order) {
+    putRecord(encoded, store.directory(row), store.name(row), store.language(row),
+              store.counts(row), store.ordinal(row));
+    if (encoded.size() >= WRITE_BUFFER) {
+      if (!writeOut(encoded)) {
+        return false;
+      }
+      encoded.clear();
+    }
+  }
+  if (!writeOut(encoded)) {
+    return false;
+  }
+  span.setBytes(fileEnd - begin);
+  runs.emplace_back(begin, fileEnd);
+  written++;
+
+  // The next stores take as many rows, and skip the growth steps that overshoot the budget
+  if (runRows == 0) {
+    runRows = store.size();
+  }
+  store = resultStore();
+  store.reserve(runRows);
+  return true;
+}
+
+bool spillSorter::writeOut(std::string_view data) {
+  if (fd < 0) {
+    const char* directory = std::getenv("TMPDIR");
+    std::string name = std::string(directory != nullptr && *directory != '\0' ? directory : "/tmp")
+                       + "/slockf-runs-XXXXXX";
+    fd = mkstemp(name.data());
+    if (fd < 0) {
+      message = "cannot create a temporary file in " + name.substr(0, name.rfind('/')) + ": "
+                + std::strerror(errno);
+      return false;
+    }
+    unlink(name.c_str());  // Gone as soon as it is closed, whatever happens
+  }
+  while (!data.empty()) {
+    ssize_t done = pwrite(fd, data.data(), data.size(), static_cast<off_t>(fileEnd));
+    if (done < 0 && errno == EINTR) {
+      continue;
+    }
+    if (done <= 0) {
+      message = std::string("cannot write the temporary file: ") + std::strerror(errno);
+      return false;
+    }
+    data.remove_prefix(static_cast<size_t>(done));
+    fileEnd += static_cast<std::uint64_t>(done);
+  }
+  return true;
+}
+
+bool spillSorter::finish() {
+  if (runs.empty()) {
+    return true;  // Everything fits: merge() sorts the store in memory
+  }
+  if (!store.empty() && !spill()) {
+    return false;
+  }
+
+  // Half of the budget goes to the read buffers, the other half is left to their growth
+  size_t fanIn = std::max<size_t>(2, budget / 2 / READ_BUFFER);
+  while (runs.size() > fanIn) {
+    traceSpan span("merge pass", "io");
+    std::vector<run> merged;
+    for (size_t first = 0; first < runs.size(); first += fanIn) {
+      size_t last = std::min(runs.size(), first + fanIn);
+      if (last - first == 1) {
+        merged.push_back(runs[first]);
+        continue;
+      }
+      std::uint64_t begin = fileEnd;
+      std::string encoded;
+      bool ok = mergeRuns(first, last, [&](const record& row) {
+        putRecord(encoded, "", row.path, row.language, row.counts, row.ordinal);
+        if (encoded.size() >= WRITE_BUFFER && writeOut(encoded)) {
+          encoded.clear();
+        }
+      });
+      if (!ok || !message.empty() || !writeOut(encoded)) {
+        return false;
+      }
+      merged.emplace_back(begin, fileEnd);
+      written++;
+    }
+    runs.swap(merged);
+  }
+  return true;
+}
+
+bool spillSorter::merge(const visit_t& visit) {
+  if (runs.empty()) {
+    std::vector<size_t> order;
+    if (column != '\0') {
+      traceSpan span("sort", "phase");
+      order = sortEngine(store).order(column, descending, top);
+    } else {
+      order.resize(store.size());
+      for (size_t row = 0; row < order.size(); row++) {
+        order[row] = row;
+      }
+    }
+    std::string path;
+    for (size_t row : order) {
+      path.assign(store.directory(row));
+      path.append(store.name(row));
+      visit(path, store.language(row), store.counts(row), store.ordinal(row));
+    }
+    return true;
+  }
+  traceSpan span("merge", "phase");
+  return mergeRuns(0, runs.size(), [&visit](const record& row) {
+    visit(row.path, row.language, row.counts, row.ordinal);
+  });
+}
+
+bool spillSorter::before(const record& a, const record& b) const {
+  if (column == 'f') {
+    int result = a.path.compare(b.path);
+    return descending ? result > 0 : result < 0;
+  }
+  std::uint64_t keyA, keyB;
+  switch (column) {
+  case '\0':
+    return false;  // Order of appearance: the run order decides
+  case 't':
+    keyA = typeRank[a.language];
+    keyB = typeRank[b.language];
+    break;
+  case 'c':
+    keyA = a.counts.comments;
+    keyB = b.counts.comments;
+    break;
+  case 'b':
+    keyA = a.counts.blank;
+    keyB = b.counts.blank;
+    break;
+  case 's':
+    keyA = a.counts.code;
+    keyB = b.counts.code;
+    break;
+  default:
+    keyA = a.counts.lines;
+    keyB = b.counts.lines;
+    break;
+  }
+  return descending ? keyA > keyB : keyA < keyB;
+}
+
+bool spillSorter::mergeRuns(size_t first,
+                            size_t last,
+                            const std::function<void(const record&)>& emit) {
+  std::vector<runReader> readers;
+  std::vector<record> heads(last - first);
+  std::vector<size_t> heap;  // Runs by their head row, the next one to emit on top
+  readers.reserve(last - first);
+  for (size_t k = first; k < last; k++) {
+    readers.emplace_back(fd, runs[k].first, runs[k].second);
+  }
+  // A run comes after another if its head sorts after, or ties and the run is later
+  auto after = [this, &heads](size_t a, size_t b) {
+    if (before(heads[b], heads[a])) {
+      return true;
+    }
+    return !before(heads[a], heads[b]) && a > b;
+  };
+  for (size_t k = 0; k < readers.size(); k++) {
+    if (readers[k].next(heads[k], message)) {
+      heap.push_back(k);
+    } else if (!message.empty()) {
+      return false;
+    }
+  }
+  std::make_heap(heap.begin(), heap.end(), after);
+
+  for (size_t emitted = 0; !heap.empty() && (top == 0 || emitted < top); emitted++) {
+    std::pop_heap(heap.begin(), heap.end(), after);
+    size_t k = heap.back();
+    emit(heads[k]);
+    if (readers[k].next(heads[k], message)) {
+      std::push_heap(heap.begin(), heap.end(), after);
+    } else if (!message.empty()) {
+      return false;
+    } else {
+      heap.pop_back();
+    }
+  }
+  return true;
+}
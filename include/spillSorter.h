@@ -0,0 +1,184 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "./file.h"
+#include "./language.h"
+#include "./lexer.h"
+#include "./resultStore.h"
+
+/**
+ * @class spillSorter
+ * @brief Orders the counted files like sortEngine, within a memory budget.
+ *
+ * Rows gather in a resultStore. When the store and the arrays sortEngine needs to order it would
+ * outgrow the budget, the store is sorted and written out as a run of compact records (varint
+ * counts and the path) to an unlinked temporary file, and a new store starts. merge() then reads
+ * the runs back through small buffers and merges them k ways. A tie goes to the earlier run, which
+ * holds the earlier rows, so the order is exactly the one of a sort in memory. When the budget
+ * holds fewer read buffers than there are runs, groups of runs are merged into longer runs first.
+ * If nothing was spilled, merge() reads the store through sortEngine and no file is created.
+ */
+class spillSorter {
+public:
+  /** Smallest budget accepted. */
+  static constexpr size_t MIN_BUDGET = 1024 * 1024;
+  /** Read buffer of a run during a merge (it grows for a longer record). */
+  static constexpr size_t READ_BUFFER = 64 * 1024;
+
+  /** Receives a row in output order. */
+  using visit_t = std::function<void(
+    std::string_view path, langId language, const lineCounts& counts, std::uint64_t ordinal)>;
+
+  /**
+   * @brief Creates an empty sorter.
+   *
+   * @param budget Bytes the rows may take in memory (at least MIN_BUDGET).
+   * @param column One of f, t, c, b, s and a (see sortEngine), or '\0' for the order of appearance.
+   * @param descending Order from the largest key down.
+   * @param top Rows wanted (0 = all); a run keeps only its first top rows.
+   */
+  spillSorter(size_t budget, char column, bool descending, size_t top);
+
+  /**
+   * @brief Closes the temporary file.
+   */
+  ~spillSorter();
+
+  spillSorter(const spillSorter&) = delete;
+  spillSorter& operator=(const spillSorter&) = delete;
+
+  /**
+   * @brief Adds a counted file, spilling a run first if the budget is reached.
+   *
+   * @param file The counted file.
+   * @return False if a run could not be written (see error()).
+   */
+  bool append(const File& file);
+
+  /**
+   * @brief Spills the last rows, if runs were spilled, and merges runs until the budget holds a
+   * read buffer for each of them; call it once, after the last append().
+   *
+   * @return False if a run could not be written or read (see error()).
+   */
+  bool finish();
+
+  /**
+   * @brief Visits the rows in order, the first top ones only if top was given; may be repeated.
+   *
+   * @param visit Called once per row.
+   * @return False if a run could not be read (see error()).
+   */
+  bool merge(const visit_t& visit);
+
+  /**
+   * @brief Gets the number of rows added.
+   *
+   * @return Number of files.
+   */
+  count_t size() const { return rows; }
+
+  /**
+   * @brief Gets the sum of the counts of every row added.
+   *
+   * @return Totals.
+   */
+  const lineCounts& totals() const { return sum; }
+
+  /**
+   * @brief Gets the length of the longest path added.
+   *
+   * @return Length in bytes.
+   */
+  size_t longestPath() const { return longest; }
+
+  /**
+   * @brief Gets the total length of the paths added.
+   *
+   * @return Length in bytes.
+   */
+  size_t pathBytes() const { return allPathBytes; }
+
+  /**
+   * @brief Gets the number of runs written so far, intermediate merges included.
+   *
+   * @return Number of runs.
+   */
+  size_t spilledRuns() const { return written; }
+
+  /**
+   * @brief Gets why append(), finish() or merge() failed.
+   *
+   * @return Description of the error.
+   */
+  const std::string& error() const { return message; }
+
+  /** A row read back from a run. */
+  struct record {
+    std::string path;
+    langId language = lang::UNDEF;
+    lineCounts counts;
+    std::uint64_t ordinal = 0;
+  };
+
+private:
+  using run = std::pair<std::uint64_t, std::uint64_t>; /**< Start and end of a run in the file */
+
+  size_t budget;            /**< Bytes the rows may take in memory */
+  char column;              /**< Sort column, or '\0' */
+  bool descending;          /**< Order from the largest key down */
+  size_t top;               /**< Rows wanted (0 = all) */
+  std::vector<std::uint64_t> typeRank; /**< Rank of each language by name, for column t */
+
+  resultStore store;        /**< Rows not spilled yet */
+  size_t runRows = 0;       /**< Rows of the first run, reserved for the next ones */
+  std::vector<run> runs;    /**< Runs to merge, in order of appearance of their rows */
+  int fd = -1;              /**< Temporary file of the runs */
+  std::uint64_t fileEnd = 0; /**< End of the data written to the file */
+  size_t written = 0;       /**< Runs written */
+
+  count_t rows = 0;         /**< Rows added */
+  lineCounts sum;           /**< Totals of the rows added */
+  size_t longest = 0;       /**< Longest path */
+  size_t allPathBytes = 0;  /**< Total length of the paths */
+  std::string message;      /**< Last error */
+
+  /**
+   * @brief Sorts the store, writes it as a new run and empties it.
+   *
+   * @return False on a write error.
+   */
+  bool spill();
+
+  /**
+   * @brief Appends encoded records to the temporary file, creating it first if needed.
+   *
+   * @param data Encoded records.
+   * @return False on a write error.
+   */
+  bool writeOut(std::string_view data);
+
+  /**
+   * @brief Merges consecutive runs, calling emit for each row in order until top rows.
+   *
+   * @param first First run.
+   * @param last One past the last run.
+   * @param emit Called once per row.
+   * @return False on a read error.
+   */
+  bool mergeRuns(size_t first, size_t last, const std::function<void(const record&)>& emit);
+
+  /**
+   * @brief Tells if a row goes before another one with the same run order.
+   *
+   * @param a First row.
+   * @param b Second row.
+   * @return True if a sorts strictly before b.
+   */
+  bool before(const record& a, const record& b) const;
+};
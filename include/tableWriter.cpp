@@ -0,0 +1,124 @@
+#include "./tableWriter.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+
+namespace {
+
+bool writeAll(int fd, const char* data, size_t length) {
+  while (length > 0) {
+    ssize_t written = ::write(fd, data, length);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += written;
+    length -= static_cast<size_t>(written);
+  }
+  return true;
+}
+
+}  // namespace
+
+size_t formatPercent(char* out, count_t part, count_t total) {
+  if (total == 0) {
+    std::memcpy(out, "0%", 2);
+    return 2;
+  }
+  // Tenths of a percent, rounded half up; below 2^40 lines the double printf works on is always
+  // on the same side of a rounding boundary as the exact value, unless the value is a tie
+  if (total < (count_t(1) << 40) && part <= total) {
+    count_t tenths = part * 1000 / total;
+    count_t remainder = part * 1000 % total;
+    if (2 * remainder != total) {
+      tenths += (2 * remainder > total) ? 1 : 0;
+      char* end = std::to_chars(out, out + 24, tenths / 10).ptr;
+      end[0] = '.';
+      end[1] = static_cast<char>('0' + tenths % 10);
+      end[2] = '%';
+      return static_cast<size_t>(end + 3 - out);
+    }
+  }
+  char text[64];
+  int length = std::snprintf(text, sizeof(text), "%.1f%%", (part * 100.0) / total);
+  std::memcpy(out, text, static_cast<size_t>(length));
+  return static_cast<size_t>(length);
+}
+
+tableWriter::tableWriter(int descriptor)
+  : fd(descriptor), interactive(isatty(descriptor) == 1), buffer(new char[CAPACITY]) {}
+
+tableWriter::tableWriter(std::string& destination)
+  : fd(-1), interactive(false), sink(&destination), buffer(new char[CAPACITY]) {}
+
+tableWriter::~tableWriter() { flush(); }
+
+void tableWriter::text(std::string_view content) {
+  if (content.size() > CAPACITY - used) {
+    flush();
+    if (content.size() > CAPACITY) {
+      emit(content.data(), content.size());  // Too big to buffer: write it through
+      return;
+    }
+  }
+  std::memcpy(buffer.get() + used, content.data(), content.size());
+  used += content.size();
+}
+
+void tableWriter::spaces(int count) {
+  while (count > 0) {
+    size_t chunk = std::min(static_cast<size_t>(count), CAPACITY);
+    char* p = reserve(chunk);
+    std::memset(p, ' ', chunk);
+    used += chunk;
+    count -= static_cast<int>(chunk);
+  }
+}
+
+void tableWriter::cell(std::string_view content, int width) {
+  text(content);
+  spaces(width - static_cast<int>(content.size()));
+}
+
+void tableWriter::number(count_t value) {
+  char* p = reserve(24);
+  used += static_cast<size_t>(std::to_chars(p, p + 24, value).ptr - p);
+}
+
+void tableWriter::cell(count_t value, int width) {
+  char digits[24];
+  char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+  cell(std::string_view(digits, static_cast<size_t>(end - digits)), width);
+}
+
+void tableWriter::percentCell(count_t part, count_t total, int width) {
+  // "N (P%)": at most 20 digits, " (", a percentage and ")"
+  char text[64];
+  char* end = std::to_chars(text, text + 24, part).ptr;
+  *end++ = ' ';
+  *end++ = '(';
+  end += formatPercent(end, part, total);
+  *end++ = ')';
+  cell(std::string_view(text, static_cast<size_t>(end - text)), width);
+}
+
+bool tableWriter::flush() {
+  size_t length = used;
+  used = 0;
+  return emit(buffer.get(), length);
+}
+
+bool tableWriter::emit(const char* data, size_t length) {
+  if (sink != nullptr) {
+    sink->append(data, length);
+    return true;
+  }
+  std::cout.flush();
+  return writeAll(fd, data, length);
+}
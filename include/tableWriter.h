@@ -0,0 +1,150 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "./file.h"
+
+/**
+ * @class tableWriter
+ * @brief Renders table text into a reusable buffer and writes it with a few large write(2) calls.
+ *
+ * Cells are padded like std::left with std::setw, numbers are converted with std::to_chars, and
+ * nothing allocates once the buffer exists. Before writing, std::cout is flushed, so messages
+ * printed through it earlier still come first.
+ */
+class tableWriter {
+public:
+  /** Size of the buffer; a full buffer is written out before more text is added. */
+  static constexpr size_t CAPACITY = 1 << 20;
+
+  /**
+   * @brief Creates a writer.
+   *
+   * @param fd Descriptor to write to.
+   */
+  explicit tableWriter(int fd);
+
+  /**
+   * @brief Creates a writer that appends to a string instead of a descriptor.
+   *
+   * @param destination String the text is appended to, on each flush.
+   */
+  explicit tableWriter(std::string& destination);
+
+  /**
+   * @brief Writes out whatever is still buffered.
+   */
+  ~tableWriter();
+
+  tableWriter(const tableWriter&) = delete;
+  tableWriter& operator=(const tableWriter&) = delete;
+
+  /**
+   * @brief Appends text.
+   *
+   * @param content Text to append.
+   */
+  void text(std::string_view content);
+
+  /**
+   * @brief Appends one character.
+   *
+   * @param c Character to append.
+   */
+  void put(char c) {
+    if (used == CAPACITY) {
+      flush();
+    }
+    buffer[used++] = c;
+  }
+
+  /**
+   * @brief Appends text left-aligned in a cell (longer text is not cut).
+   *
+   * @param content Text of the cell.
+   * @param width Width of the cell.
+   */
+  void cell(std::string_view content, int width);
+
+  /**
+   * @brief Appends a number.
+   *
+   * @param value Number to append.
+   */
+  void number(count_t value);
+
+  /**
+   * @brief Appends a number left-aligned in a cell.
+   *
+   * @param value Number of the cell.
+   * @param width Width of the cell.
+   */
+  void cell(count_t value, int width);
+
+  /**
+   * @brief Appends a "count (percentage%)" cell, left-aligned.
+   *
+   * @param part Count shown in the cell.
+   * @param total Count the percentage is relative to.
+   * @param width Width of the cell.
+   */
+  void percentCell(count_t part, count_t total, int width);
+
+  /**
+   * @brief Appends spaces.
+   *
+   * @param count Number of spaces (nothing if not positive).
+   */
+  void spaces(int count);
+
+  /**
+   * @brief Writes the buffered text.
+   *
+   * @return False if the descriptor refused the data.
+   */
+  bool flush();
+
+  /**
+   * @brief Gets the number of buffered bytes.
+   *
+   * @return Bytes not yet written.
+   */
+  size_t buffered() const { return used; }
+
+  /**
+   * @brief Checks if the writer writes to a terminal.
+   *
+   * @return True for a terminal.
+   */
+  bool isInteractive() const { return interactive; }
+
+private:
+  int fd;                          /**< Destination */
+  bool interactive;                /**< The destination is a terminal */
+  std::string* sink = nullptr;     /**< Destination instead of fd, if any */
+  std::unique_ptr<char[]> buffer;  /**< Pending text */
+  size_t used = 0;                 /**< Bytes of pending text */
+
+  /**
+   * @brief Sends text to the destination.
+   *
+   * @param data Text.
+   * @param length Bytes of text.
+   * @return False if the descriptor refused the data.
+   */
+  bool emit(const char* data, size_t length);
+
+  /**
+   * @brief Makes room for some bytes, writing the buffer out if needed.
+   *
+   * @param bytes Bytes about to be appended (at most CAPACITY).
+   * @return Where to append them.
+   */
+  char* reserve(size_t bytes) {
+    if (CAPACITY - used < bytes) {
+      flush();
+    }
+    return buffer.get() + used;
+  }
+};
@@ -0,0 +1,135 @@
+#include "./threadPool.h"
+#include <algorithm>
+
+namespace {
+// Pool and worker index of the calling thread (nullptr / -1 outside any pool)
+thread_local threadPool* currentPool = nullptr;
+thread_local int currentIndex = -1;
+}  // namespace
+
+threadPool::threadPool(unsigned nThreads) {
+  if (nThreads == 0) {
+    nThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (unsigned i = 0; i < nThreads; i++) {
+    queues.push_back(std::make_unique<taskQueue>());
+  }
+  for (unsigned i = 0; i < nThreads; i++) {
+    workers.emplace_back([this, i] { workerLoop(i); });
+  }
+}
+
+threadPool::~threadPool() {
+  wait();
+  {
+    std::lock_guard<std::mutex> guard(idleLock);
+    stopping = true;
+  }
+  workAvailable.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+int threadPool::currentWorker() { return currentIndex; }
+
+threadPool* threadPool::current() { return currentPool; }
+
+void threadPool::forEach(size_t count, const std::function<void(size_t)>& body) {
+  struct group {
+    std::atomic<size_t> next{ 0 };     // Next index to take
+    std::atomic<size_t> finished{ 0 }; // Indices done
+    std::mutex lock;
+    std::condition_variable done;
+  };
+  // Helpers may only start once everything is done: they then find no index and leave
+  auto shared = std::make_shared<group>();
+  auto work = [shared, count, &body] {
+    for (size_t index; (index = shared->next.fetch_add(1)) < count;) {
+      body(index);
+      if (shared->finished.fetch_add(1) + 1 == count) {
+        std::lock_guard<std::mutex> guard(shared->lock);
+        shared->done.notify_all();
+      }
+    }
+  };
+  for (size_t helper = 1; helper < std::min<size_t>(count, queues.size()); helper++) {
+    submit(work);
+  }
+  work();
+  std::unique_lock<std::mutex> guard(shared->lock);
+  shared->done.wait(guard, [&] { return shared->finished.load() == count; });
+}
+
+void threadPool::submit(task_t task) {
+  pending.fetch_add(1, std::memory_order_relaxed);
+
+  // Tasks spawned by a worker stay local; the others are spread round-robin
+  unsigned target = (currentPool == this) ? static_cast<unsigned>(currentIndex)
+                                          : nextQueue.fetch_add(1) % queues.size();
+  {
+    std::lock_guard<std::mutex> guard(queues[target]->lock);
+    queued.fetch_add(1);
+    queues[target]->tasks.push_back(std::move(task));
+  }
+  {
+    // Taking the lock avoids a lost wake-up against a worker about to sleep
+    std::lock_guard<std::mutex> guard(idleLock);
+  }
+  workAvailable.notify_one();
+}
+
+void threadPool::wait() {
+  std::unique_lock<std::mutex> guard(idleLock);
+  allDone.wait(guard, [this] { return pending.load() == 0; });
+}
+
+bool threadPool::takeTask(unsigned index, task_t& out) {
+  // Own deque first, newest task first
+  {
+    taskQueue& own = *queues[index];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (!own.tasks.empty()) {
+      out = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      queued.fetch_sub(1);
+      return true;
+    }
+  }
+  // Steal the oldest task of some other worker
+  for (size_t k = 1; k < queues.size(); k++) {
+    taskQueue& victim = *queues[(index + k) % queues.size()];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (!victim.tasks.empty()) {
+      out = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      queued.fetch_sub(1);
+      return true;
+    }
+  }
+  return false;
+}
+
+void threadPool::workerLoop(unsigned index) {
+  currentPool = this;
+  currentIndex = static_cast<int>(index);
+
+  task_t task;
+  while (true) {
+    if (takeTask(index, task)) {
+      task();
+      task = nullptr;
+      if (pending.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> guard(idleLock);
+        allDone.notify_all();
+      }
+      continue;
+    }
+
+    std::unique_lock<std::mutex> guard(idleLock);
+    workAvailable.wait(guard, [this] { return stopping || queued.load() > 0; });
+    if (stopping && queued.load() == 0) {
+      return;
+    }
+  }
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class threadPool
+ * @brief Fixed-size pool of workers that balance load by stealing tasks.
+ *
+ * Every worker owns a task deque. A worker pops its own tasks from the back (LIFO, cache friendly)
+ * and, when it runs dry, steals from the front of the other workers' deques. Tasks submitted from
+ * inside a worker land on that worker's deque; tasks submitted from outside are spread round-robin.
+ */
+class threadPool {
+public:
+  using task_t = std::function<void()>;
+
+  /**
+   * @brief Starts the worker threads.
+   *
+   * @param nThreads Number of workers. Zero means one worker per hardware thread.
+   */
+  explicit threadPool(unsigned nThreads);
+
+  /**
+   * @brief Waits for the pending tasks and joins the workers.
+   */
+  ~threadPool();
+
+  threadPool(const threadPool&) = delete;
+  threadPool& operator=(const threadPool&) = delete;
+
+  /**
+   * @brief Schedules a task for execution.
+   *
+   * @param task Callable to be run by one of the workers.
+   */
+  void submit(task_t task);
+
+  /**
+   * @brief Blocks until every submitted task (including the ones they submitted) has finished.
+   */
+  void wait();
+
+  /**
+   * @brief Gets the number of workers.
+   *
+   * @return Number of worker threads.
+   */
+  unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+  /**
+   * @brief Gets the index of the worker running the calling thread.
+   *
+   * @return Worker index in [0, size()), or -1 when called from a thread outside any pool.
+   */
+  static int currentWorker();
+
+  /**
+   * @brief Gets the pool the calling thread works for.
+   *
+   * @return The pool, or nullptr when called from a thread outside any pool.
+   */
+  static threadPool* current();
+
+  /**
+   * @brief Runs body(0) ... body(count - 1) on the workers and the calling thread.
+   *
+   * The calling thread takes indices too and only waits for the ones already running elsewhere,
+   * so this can be called from inside a task, unlike wait().
+   *
+   * @param count Number of indices.
+   * @param body Work of one index.
+   */
+  void forEach(size_t count, const std::function<void(size_t)>& body);
+
+private:
+  /**
+   * @struct taskQueue
+   * @brief Deque of tasks owned by a single worker.
+   */
+  struct taskQueue {
+    std::mutex lock;           /**< Guards tasks */
+    std::deque<task_t> tasks;  /**< Pending tasks */
+  };
+
+  std::vector<std::unique_ptr<taskQueue>> queues; /**< One deque per worker */
+  std::vector<std::thread> workers;               /**< Worker threads */
+  std::atomic<size_t> pending{ 0 };               /**< Submitted but unfinished tasks */
+  std::atomic<size_t> queued{ 0 };                /**< Tasks sitting in some deque */
+  std::atomic<unsigned> nextQueue{ 0 };           /**< Round-robin cursor for outside submits */
+  std::mutex idleLock;                            /**< Guards the condition variables */
+  std::condition_variable workAvailable;          /**< Signals idle workers */
+  std::condition_variable allDone;                /**< Signals wait() */
+  bool stopping = false;                          /**< Set when the pool shuts down */
+
+  /**
+   * @brief Main loop of a worker.
+   *
+   * @param index Index of the worker.
+   */
+  void workerLoop(unsigned index);
+
+  /**
+   * @brief Takes a task from the worker's own deque or steals one from another worker.
+   *
+   * @param index Index of the worker looking for work.
+   * @param out Receives the task.
+   * @return True if a task was found.
+   */
+  bool takeTask(unsigned index, task_t& out);
+};
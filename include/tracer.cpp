@@ -0,0 +1,179 @@
+#include "./tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "./jsonText.h"
+#include "./threadPool.h"
+
+std::atomic<bool> tracer::isEnabled{ false };
+
+namespace {
+
+struct traceEvent {
+  const char* name;
+  const char* category;
+  std::uint64_t startNs;
+  std::uint64_t endNs;
+  std::uint64_t bytes;
+  std::string detail;
+};
+
+// Spans of one thread; kept by the registry so they outlive the thread
+struct threadEvents {
+  unsigned tid;
+  std::string threadName;
+  std::vector<traceEvent> events;
+};
+
+std::chrono::steady_clock::time_point origin;
+std::mutex registryLock;
+std::vector<std::unique_ptr<threadEvents>> registry;
+thread_local threadEvents* localEvents = nullptr;
+
+threadEvents& eventsOfThisThread() {
+  if (localEvents == nullptr) {
+    std::lock_guard<std::mutex> guard(registryLock);
+    registry.push_back(std::make_unique<threadEvents>());
+    localEvents = registry.back().get();
+    localEvents->tid = static_cast<unsigned>(registry.size() - 1);
+    int worker = threadPool::currentWorker();
+    localEvents->threadName = worker < 0 ? "main" : "worker " + std::to_string(worker);
+  }
+  return *localEvents;
+}
+
+// Writes a JSON string through the escaper of the record formats (invalid UTF-8 becomes U+FFFD)
+void writeJsonString(std::ostream& out, const std::string& text) {
+  struct streamSink {
+    std::ostream& out;
+    void text(std::string_view part) {
+      out.write(part.data(), static_cast<std::streamsize>(part.size()));
+    }
+  } sink{ out };
+  out << '"';
+  jsonText::escape(sink, text);
+  out << '"';
+}
+
+}  // namespace
+
+void tracer::enable() {
+  origin = std::chrono::steady_clock::now();
+  isEnabled.store(true);
+}
+
+std::uint64_t tracer::now() {
+  return static_cast<std::uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin)
+      .count());
+}
+
+void tracer::record(const char* name,
+                    const char* category,
+                    std::uint64_t startNs,
+                    std::uint64_t endNs,
+                    std::uint64_t bytes,
+                    std::string detail) {
+  eventsOfThisThread().events.push_back(
+    { name, category, startNs, endNs, bytes, std::move(detail) });
+}
+
+bool tracer::writeChromeTrace(const std::string& path) {
+  std::ofstream out(path);
+  if (!out) {
+    return false;
+  }
+  std::lock_guard<std::mutex> guard(registryLock);
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  bool first = true;
+  char number[64];
+  for (const auto& thread : registry) {
+    out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+        << thread->tid << ",\"args\":{\"name\":";
+    writeJsonString(out, thread->threadName);
+    out << "}}";
+    first = false;
+    for (const auto& event : thread->events) {
+      // Complete events ("X"), times in microseconds
+      out << ",\n{\"name\":";
+      writeJsonString(out, event.name);
+      out << ",\"cat\":";
+      writeJsonString(out, event.category);
+      std::snprintf(number,
+                    sizeof(number),
+                    ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f",
+                    event.startNs / 1000.0,
+                    (event.endNs - event.startNs) / 1000.0);
+      out << number << ",\"pid\":1,\"tid\":" << thread->tid << ",\"args\":{\"bytes\":" << event.bytes;
+      if (!event.detail.empty()) {
+        out << ",\"detail\":";
+        writeJsonString(out, event.detail);
+      }
+      out << "}}";
+    }
+  }
+  out << "\n]}\n";
+  return static_cast<bool>(out);
+}
+
+void tracer::printTimings(std::ostream& out) {
+  struct summary {
+    std::string name;
+    std::string category;
+    std::uint64_t firstStart;
+    std::uint64_t count = 0;
+    std::uint64_t totalNs = 0;
+    std::uint64_t bytes = 0;
+  };
+  std::vector<summary> summaries;
+  std::uint64_t wallNs = 0;
+  {
+    std::lock_guard<std::mutex> guard(registryLock);
+    for (const auto& thread : registry) {
+      for (const auto& event : thread->events) {
+        auto found = std::find_if(summaries.begin(), summaries.end(), [&](const summary& s) {
+          return s.name == event.name;
+        });
+        if (found == summaries.end()) {
+          summaries.push_back({ event.name, event.category, event.startNs });
+          found = summaries.end() - 1;
+        }
+        found->firstStart = std::min(found->firstStart, event.startNs);
+        found->count++;
+        found->totalNs += event.endNs - event.startNs;
+        found->bytes += event.bytes;
+        wallNs = std::max(wallNs, event.endNs);
+      }
+    }
+  }
+  std::sort(summaries.begin(), summaries.end(), [](const summary& a, const summary& b) {
+    return a.firstStart < b.firstStart;
+  });
+
+  // Spans of files and directories overlap across threads: their total is CPU time, not wall time
+  char line[160];
+  std::snprintf(
+    line, sizeof(line), "%-14s %-6s %10s %12s %14s %10s\n", "span", "kind", "count", "total ms",
+    "bytes", "MB/s");
+  out << line;
+  for (const auto& s : summaries) {
+    double ms = s.totalNs / 1e6;
+    double rate = (s.bytes > 0 && s.totalNs > 0) ? s.bytes * 1e3 / s.totalNs : 0.0;
+    std::snprintf(line,
+                  sizeof(line),
+                  "%-14s %-6s %10llu %12.3f %14llu %10.1f\n",
+                  s.name.c_str(),
+                  s.category.c_str(),
+                  static_cast<unsigned long long>(s.count),
+                  ms,
+                  static_cast<unsigned long long>(s.bytes),
+                  rate);
+    out << line;
+  }
+  std::snprintf(line, sizeof(line), "wall clock: %.3f ms\n", wallNs / 1e6);
+  out << line;
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+
+/**
+ * @class tracer
+ * @brief Process-wide recorder of timed spans (phases, directories, files).
+ *
+ * Every thread appends its spans to a buffer of its own, so recording takes no lock. The spans can
+ * be written as a Chrome trace-event file (chrome://tracing, Perfetto) or summed up per name.
+ * Tracing is off unless enable() is called; a disabled span costs one relaxed load and a branch.
+ */
+class tracer {
+public:
+  /**
+   * @brief Starts recording. Call once, before any span of interest is opened.
+   */
+  static void enable();
+
+  /**
+   * @brief Checks if spans are being recorded.
+   *
+   * @return True once enable() was called.
+   */
+  static bool enabled() { return isEnabled.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Gets the time elapsed since enable().
+   *
+   * @return Nanoseconds on a monotonic clock.
+   */
+  static std::uint64_t now();
+
+  /**
+   * @brief Records a finished span for the calling thread.
+   *
+   * @param name Name of the span (must outlive the tracer, e.g. a literal).
+   * @param category Category of the span (same requirement).
+   * @param startNs Start, as returned by now().
+   * @param endNs End, as returned by now().
+   * @param bytes Bytes processed in the span (0 if not meaningful).
+   * @param detail Free text shown with the span, e.g. a path (may be empty).
+   */
+  static void record(const char* name,
+                     const char* category,
+                     std::uint64_t startNs,
+                     std::uint64_t endNs,
+                     std::uint64_t bytes,
+                     std::string detail);
+
+  /**
+   * @brief Writes every recorded span in Chrome trace-event format.
+   *
+   * @param path Path of the JSON file.
+   * @return False if the file could not be written.
+   */
+  static bool writeChromeTrace(const std::string& path);
+
+  /**
+   * @brief Prints the number of spans, their total time and bytes, per span name.
+   *
+   * @param out Stream to print to.
+   */
+  static void printTimings(std::ostream& out);
+
+private:
+  static std::atomic<bool> isEnabled; /**< Set by enable() */
+};
+
+/**
+ * @class traceSpan
+ * @brief Records the lifetime of a scope as a span, when tracing is enabled.
+ */
+class traceSpan {
+public:
+  /**
+   * @brief Opens a span.
+   *
+   * @param spanName Name of the span (a literal).
+   * @param spanCategory Category of the span (a literal).
+   */
+  traceSpan(const char* spanName, const char* spanCategory)
+    : name(spanName), category(spanCategory), active(tracer::enabled()),
+      start(active ? tracer::now() : 0) {}
+
+  ~traceSpan() {
+    if (active) {
+      tracer::record(name, category, start, tracer::now(), bytes, std::move(detail));
+    }
+  }
+
+  traceSpan(const traceSpan&) = delete;
+  traceSpan& operator=(const traceSpan&) = delete;
+
+  /**
+   * @brief Sets the number of bytes processed in the span.
+   *
+   * @param count Number of bytes.
+   */
+  void setBytes(std::uint64_t count) { bytes = count; }
+
+  /**
+   * @brief Attaches a text to the span; nothing is copied when tracing is disabled.
+   *
+   * @param text Text to attach, e.g. a path.
+   */
+  void setDetail(const std::string& text) {
+    if (active) {
+      detail = text;
+    }
+  }
+
+private:
+  const char* name;       /**< Name of the span */
+  const char* category;   /**< Category of the span */
+  bool active;            /**< Tracing was enabled when the span opened */
+  std::uint64_t start;    /**< Start of the span */
+  std::uint64_t bytes = 0; /**< Bytes processed */
+  std::string detail;     /**< Attached text */
+};
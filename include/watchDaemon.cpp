@@ -0,0 +1,602 @@
+#include "./watchDaemon.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <unordered_set>
+#include <utility>
+#include "./dirWalker.h"
+#include "./outputHandler.h"
+#include "./recordWriter.h"
+#include "./threadPool.h"
+#include "./tracer.h"
+
+namespace {
+
+// Events that change what a watched directory holds
+constexpr std::uint32_t DIRECTORY_EVENTS = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM
+                                           | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR;
+// Events of a file given on the command line
+constexpr std::uint32_t FILE_EVENTS = IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF;
+// Longest query accepted, and how long a client may go without sending or reading anything
+constexpr size_t MAX_REQUEST = 4096;
+constexpr auto CLIENT_TIMEOUT = std::chrono::seconds(10);
+// Clients served at once, and bytes of answers waiting to be sent before queries are held back
+constexpr size_t MAX_CLIENTS = 64;
+constexpr size_t MAX_PENDING = 64 * 1024 * 1024;
+// Dead entries of the results kept before the tables are compacted
+constexpr size_t MIN_COMPACT = 1024;
+// Files counted per pool task during a scan
+constexpr size_t SCAN_BATCH = 32;
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int) { stopRequested = 1; }
+
+bool writeAll(int fd, const char* data, size_t length) {
+  while (length > 0) {
+    ssize_t written = ::write(fd, data, length);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += written;
+    length -= static_cast<size_t>(written);
+  }
+  return true;
+}
+
+bool fillAddress(const std::string& socketPath, sockaddr_un& address) {
+  address = {};
+  address.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(address.sun_path)) {
+    std::cerr << ">>>> Error: socket path too long: " << socketPath << "\n";
+    return false;
+  }
+  std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+  return true;
+}
+
+}  // namespace
+
+watchDaemon::watchDaemon(std::vector<std::string> paths, const scanOptions& settings)
+  : roots(std::move(paths)), options(settings) {}
+
+watchDaemon::~watchDaemon() {
+  if (inotifyFd >= 0) {
+    ::close(inotifyFd);
+  }
+  if (listenFd >= 0) {
+    ::close(listenFd);
+  }
+}
+
+void watchDaemon::scan(const std::string& path) {
+  traceSpan span("scan", "phase");
+  span.setDetail(path);
+  fileHandler handler(path);
+  if (!handler.isValidPath()) {
+    std::cerr << ">>>> Error: no such file or directory: " << path << "\n";
+    return;
+  }
+
+  std::vector<std::string> found;
+  if (handler.isDirectory()) {
+    dirWalker walker(options.isRecursive, nullptr);
+    walker.setFilters(options.respectGitignore, options.excludes);
+    walker.setDirectoryVisitor([this](const std::string& dirPath) {
+      int wd = inotify_add_watch(inotifyFd, dirPath.c_str(), DIRECTORY_EVENTS);
+      if (wd >= 0) {
+        watches[wd] = dirPath.back() == '/' ? dirPath : dirPath + '/';
+      }
+    });
+    walker.walk(path, [&found](const std::string& filePath, size_t) { found.push_back(filePath); });
+  } else if (handler.isValidExtension(path)) {
+    int wd = inotify_add_watch(inotifyFd, path.c_str(), FILE_EVENTS);
+    if (wd >= 0) {
+      watches[wd] = path;
+    }
+    found.push_back(path);
+  } else {
+    std::cerr << ">>>> Error: File with invalid extension: " << path << "\n";
+    return;
+  }
+
+  // Count what was found, in parallel, keeping the order of the walk
+  std::vector<File> counted(found.size(), File("", lang::UNDEF, 0, 0, 0, 0));
+  if (options.jobs == 1 || found.size() <= SCAN_BATCH) {
+    for (size_t index = 0; index < found.size(); index++) {
+      counted[index] = handler.countFile(found[index], options);
+    }
+  } else {
+    threadPool pool(options.jobs);
+    for (size_t first = 0; first < found.size(); first += SCAN_BATCH) {
+      pool.submit([&, first] {
+        size_t last = std::min(first + SCAN_BATCH, found.size());
+        for (size_t index = first; index < last; index++) {
+          counted[index] = handler.countFile(found[index], options);
+        }
+      });
+    }
+    pool.wait();
+  }
+
+  for (File& file : counted) {
+    auto known = byPath.find(file.getFileName());
+    if (known != byPath.end()) {
+      files[known->second] = std::move(file);  // Found again (e.g. moved back): keep its place
+    } else {
+      byPath.emplace(file.getFileName(), files.size());
+      files.push_back(std::move(file));
+      live.push_back(true);
+    }
+  }
+  dirty = true;
+}
+
+void watchDaemon::rescan() {
+  for (const auto& [wd, path] : watches) {
+    inotify_rm_watch(inotifyFd, wd);
+  }
+  watches.clear();
+  files.clear();
+  live.clear();
+  byPath.clear();
+  deadCount = 0;
+  for (const std::string& root : roots) {
+    scan(root);
+  }
+}
+
+void watchDaemon::update(const std::string& filePath) {
+  fileHandler handler(filePath);
+  File file = handler.countFile(filePath, options);
+  auto known = byPath.find(filePath);
+  if (known != byPath.end()) {
+    files[known->second] = std::move(file);
+  } else {
+    byPath.emplace(filePath, files.size());
+    files.push_back(std::move(file));
+    live.push_back(true);
+  }
+  dirty = true;
+}
+
+void watchDaemon::remove(const std::string& path) {
+  if (path.empty() || path.back() != '/') {
+    auto known = byPath.find(path);
+    if (known != byPath.end()) {
+      live[known->second] = false;
+      byPath.erase(known);
+      deadCount++;
+      dirty = true;
+      compact();
+    }
+    return;
+  }
+  // A directory: drop its files, and stop watching it (a moved directory keeps its watches)
+  for (auto entry = byPath.begin(); entry != byPath.end();) {
+    if (entry->first.compare(0, path.size(), path) == 0) {
+      live[entry->second] = false;
+      entry = byPath.erase(entry);
+      deadCount++;
+      dirty = true;
+    } else {
+      ++entry;
+    }
+  }
+  for (auto watch = watches.begin(); watch != watches.end();) {
+    if (watch->second.compare(0, path.size(), path) == 0) {
+      inotify_rm_watch(inotifyFd, watch->first);
+      watch = watches.erase(watch);
+    } else {
+      ++watch;
+    }
+  }
+  compact();
+}
+
+void watchDaemon::compact() {
+  // Under create/delete churn every new file takes a new entry: drop the dead ones now and then
+  if (deadCount < MIN_COMPACT || deadCount < byPath.size()) {
+    return;
+  }
+  size_t kept = 0;
+  for (size_t index = 0; index < files.size(); index++) {
+    if (live[index]) {
+      if (kept != index) {
+        files[kept] = std::move(files[index]);
+      }
+      byPath.find(files[kept].getFileName())->second = kept;
+      kept++;
+    }
+  }
+  files.erase(files.begin() + static_cast<std::ptrdiff_t>(kept), files.end());
+  files.shrink_to_fit();
+  live.assign(kept, true);
+  live.shrink_to_fit();
+  deadCount = 0;
+}
+
+void watchDaemon::readEvents() {
+  traceSpan span("events", "phase");
+  alignas(struct inotify_event) char buffer[64 * 1024];
+  // Files written several times in one batch are counted once, after the batch
+  std::vector<std::string> pending;
+  std::unordered_set<std::string> pendingSet;
+  bool overflow = false;
+
+  while (true) {
+    ssize_t length = ::read(inotifyFd, buffer, sizeof(buffer));
+    if (length <= 0) {
+      break;  // EAGAIN: nothing more for now
+    }
+    for (ssize_t offset = 0; offset < length;) {
+      const auto* event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+      offset += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+      if (event->mask & IN_Q_OVERFLOW) {
+        overflow = true;
+        continue;
+      }
+      auto watch = watches.find(event->wd);
+      if (watch == watches.end()) {
+        continue;
+      }
+      if (event->mask & IN_IGNORED) {
+        watches.erase(watch);
+        continue;
+      }
+
+      bool isDirectoryWatch = !watch->second.empty() && watch->second.back() == '/';
+      std::string path = isDirectoryWatch && event->len > 0 ? watch->second + event->name
+                                                            : watch->second;
+      if (!isDirectoryWatch || (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF))) {
+        // A file given on the command line, or a watched directory that went away
+        if (event->mask & IN_CLOSE_WRITE) {
+          if (pendingSet.insert(path).second) {
+            pending.push_back(path);
+          }
+        } else if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+          remove(path);
+          pendingSet.erase(path);
+        }
+        continue;
+      }
+
+      if (event->mask & IN_ISDIR) {
+        if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+          remove(path + '/');
+        } else if ((event->mask & (IN_CREATE | IN_MOVED_TO)) && options.isRecursive) {
+          scan(path);
+        }
+      } else if (languageRegistry::fromPath(path) != lang::UNDEF) {
+        if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+          if (pendingSet.insert(path).second) {
+            pending.push_back(path);
+          }
+        } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+          remove(path);
+          pendingSet.erase(path);
+        }
+      }
+    }
+  }
+
+  if (overflow) {
+    // Events were lost: only a new walk can tell what changed
+    std::cerr << ">>>> Warning: inotify queue overflowed, rescanning\n";
+    rescan();
+    return;
+  }
+  for (const std::string& filePath : pending) {
+    if (pendingSet.count(filePath) != 0) {
+      update(filePath);
+    }
+  }
+}
+
+const resultStore& watchDaemon::results() {
+  if (dirty) {
+    store = resultStore();
+    store.reserve(byPath.size());
+    for (size_t index = 0; index < files.size(); index++) {
+      if (live[index]) {
+        files[index].setOrdinal(store.size());
+        store.append(files[index]);
+      }
+    }
+    dirty = false;
+  }
+  return store;
+}
+
+bool watchDaemon::receive(connection& client) {
+  // The client shuts its side down once the query is sent
+  char chunk[512];
+  while (client.request.size() < MAX_REQUEST) {
+    ssize_t length = ::read(client.fd, chunk, sizeof(chunk));
+    if (length < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    if (length == 0) {
+      break;
+    }
+    client.request.append(chunk, static_cast<size_t>(length));
+  }
+  client.received = true;
+  return true;
+}
+
+bool watchDaemon::send(connection& client) {
+  while (client.sent < client.reply.size()) {
+    ssize_t written = ::write(client.fd, client.reply.data() + client.sent,
+                              client.reply.size() - client.sent);
+    if (written < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    client.sent += static_cast<size_t>(written);
+  }
+  return false;
+}
+
+std::string watchDaemon::answer(const std::string& request) {
+  std::vector<std::string> arguments;
+  for (size_t start = 0; start < request.size();) {
+    size_t end = request.find('\n', start);
+    if (end == std::string::npos) {
+      end = request.size();
+    }
+    arguments.push_back(request.substr(start, end - start));
+    start = end + 1;
+  }
+
+  std::pair<std::string, std::string> sortOption;
+  size_t top = 0;
+  outputFormat format = outputFormat::TABLE;
+  bool totals = false;
+  std::string error;
+  for (size_t i = 0; i < arguments.size() && error.empty(); i++) {
+    const std::string& arg = arguments[i];
+    bool hasValue = i + 1 < arguments.size();
+    if (arg == "-s" || arg == "-S") {
+      if (!hasValue || arguments[i + 1].empty()
+          || arguments[i + 1].find_first_not_of("ftcbsa") != std::string::npos) {
+        error = "Invalid option! (f | t | c | b | s | a)";
+      } else {
+        sortOption = { arg, arguments[++i] };
+      }
+    } else if (arg == "--top") {
+      const std::string value = hasValue ? arguments[++i] : "";
+      if (value.empty() || value.size() > 9
+          || value.find_first_not_of("0123456789") != std::string::npos) {
+        error = "Invalid number of rows: " + value;
+      } else {
+        top = std::stoul(value);
+      }
+    } else if (arg == "--format") {
+      if (!hasValue || !recordWriter::parseFormat(arguments[++i], format)) {
+        error = "Invalid format (table | json | csv | ndjson | bin)";
+      }
+    } else if (arg == "--totals") {
+      totals = true;
+    } else if (!arg.empty()) {
+      error = "Unknown query option: " + arg;
+    }
+  }
+  if (error.empty() && totals && format != outputFormat::TABLE && format != outputFormat::JSON) {
+    error = "--totals is printed as a table or as JSON only";
+  }
+  if (!error.empty()) {
+    return "1>>>> Error: " + error + "\n";
+  }
+
+  traceSpan span("query", "phase");
+  std::string reply = "0";
+  const resultStore& current = results();
+  {
+    outputHandler output(reply);
+    output.setFormat(format);
+    if (totals) {
+      output.outputTotals(current);
+    } else {
+      output.setTop(sortOption.first.empty() ? 0 : top);
+      output.outputFormatted(current, static_cast<int>(current.size()), sortOption);
+    }
+  }
+  span.setBytes(reply.size());
+  return reply;
+}
+
+int watchDaemon::run(const std::string& socketPath) {
+  sockaddr_un address;
+  if (!fillAddress(socketPath, address)) {
+    return 1;
+  }
+  inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotifyFd < 0) {
+    std::cerr << ">>>> Error: cannot start inotify: " << std::strerror(errno) << "\n";
+    return 1;
+  }
+
+  for (const std::string& root : roots) {
+    scan(root);
+  }
+
+  // Replace a socket left behind by a daemon that died, but nothing else
+  struct stat info {};
+  if (lstat(socketPath.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+    ::unlink(socketPath.c_str());
+  }
+  listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listenFd < 0 || ::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+      || ::listen(listenFd, 16) != 0) {
+    std::cerr << ">>>> Error: cannot listen on " << socketPath << ": " << std::strerror(errno)
+              << "\n";
+    return 1;
+  }
+
+  struct sigaction action {};
+  action.sa_handler = requestStop;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+  std::signal(SIGPIPE, SIG_IGN);  // A client that hangs up must not kill the daemon
+
+  std::cerr << "Watching " << byPath.size() << " files in " << watches.size()
+            << " directories, listening on " << socketPath << "\n";
+
+  using clock = std::chrono::steady_clock;
+  std::vector<struct pollfd> ready;
+  while (stopRequested == 0) {
+    // A client waits for its query, or for room to send its answer
+    ready.assign({ { inotifyFd, POLLIN, 0 },
+                   { clients.size() < MAX_CLIENTS ? listenFd : -1, POLLIN, 0 } });
+    // A query held back waits for the others to drain, with no deadline of its own
+    clock::time_point wake = clock::time_point::max();
+    for (const connection& client : clients) {
+      bool heldBack = client.received && client.reply.empty();
+      short events = !client.received ? POLLIN : heldBack ? 0 : POLLOUT;
+      ready.push_back({ client.fd, events, 0 });
+      if (!heldBack) {
+        wake = std::min(wake, client.deadline);
+      }
+    }
+    int timeout = -1;
+    if (wake != clock::time_point::max()) {
+      auto left = std::chrono::ceil<std::chrono::milliseconds>(wake - clock::now()).count();
+      timeout = static_cast<int>(std::max<decltype(left)>(left, 0));
+    }
+    if (poll(ready.data(), ready.size(), timeout) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << ">>>> Error: poll failed: " << std::strerror(errno) << "\n";
+      break;
+    }
+    // Changes first, so a query sent after a save sees it
+    if (ready[0].revents & POLLIN) {
+      readEvents();
+    }
+
+    clock::time_point now = clock::now();
+    size_t pending = 0;
+    for (const connection& client : clients) {
+      pending += client.reply.size() - client.sent;
+    }
+    size_t kept = 0;
+    for (size_t k = 0; k < clients.size(); k++) {
+      connection& client = clients[k];
+      short revents = ready[k + 2].revents;
+      bool open = true;
+      if (!client.received && revents != 0) {
+        open = receive(client);
+        client.deadline = now + CLIENT_TIMEOUT;
+      }
+      if (open && client.received && client.reply.empty() && pending < MAX_PENDING) {
+        client.reply = answer(client.request);
+        pending += client.reply.size();
+        client.deadline = now + CLIENT_TIMEOUT;
+        revents |= POLLOUT;  // Try at once: a small answer fits in the socket
+      }
+      if (open && !client.reply.empty() && (revents & (POLLOUT | POLLERR | POLLHUP))) {
+        size_t before = client.sent;
+        open = send(client);
+        pending -= client.sent - before;
+        if (client.sent != before) {
+          client.deadline = now + CLIENT_TIMEOUT;
+        }
+      }
+      bool heldBack = client.received && client.reply.empty();
+      if (open && !heldBack && now >= client.deadline) {
+        open = false;  // Stalled: its buffer is freed for the others
+      }
+      if (!open) {
+        ::close(client.fd);
+      } else if (kept++ != k) {
+        clients[kept - 1] = std::move(client);
+      }
+    }
+    clients.erase(clients.begin() + static_cast<std::ptrdiff_t>(kept), clients.end());
+
+    if (ready[1].revents & POLLIN) {
+      int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd >= 0) {
+        connection client;
+        client.fd = fd;
+        client.deadline = now + CLIENT_TIMEOUT;
+        clients.push_back(std::move(client));
+      }
+    }
+  }
+
+  for (const connection& client : clients) {
+    ::close(client.fd);
+  }
+  clients.clear();
+  ::unlink(socketPath.c_str());
+  return 0;
+}
+
+int watchDaemon::query(const std::string& socketPath, const std::vector<std::string>& request) {
+  sockaddr_un address;
+  if (!fillAddress(socketPath, address)) {
+    return 1;
+  }
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+    std::cerr << ">>>> Error: no daemon listening on " << socketPath << "\n";
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    return 1;
+  }
+  std::signal(SIGPIPE, SIG_IGN);
+
+  std::string message;
+  for (const std::string& arg : request) {
+    message += arg;
+    message += '\n';
+  }
+  if (!writeAll(fd, message.data(), message.size())) {
+    std::cerr << ">>>> Error: could not send the query\n";
+    ::close(fd);
+    return 1;
+  }
+  ::shutdown(fd, SHUT_WR);
+
+  // Status byte, then the output, copied as it arrives
+  char buffer[64 * 1024];
+  int status = -1;
+  std::cout.flush();
+  while (true) {
+    ssize_t length = ::read(fd, buffer, sizeof(buffer));
+    if (length < 0 && errno == EINTR) {
+      continue;
+    }
+    if (length <= 0) {
+      break;
+    }
+    const char* data = buffer;
+    if (status < 0) {
+      status = buffer[0] == '0' ? 0 : 1;
+      data++;
+      length--;
+    }
+    writeAll(status == 0 ? STDOUT_FILENO : STDERR_FILENO, data, static_cast<size_t>(length));
+  }
+  ::close(fd);
+  if (status < 0) {
+    std::cerr << ">>>> Error: the daemon closed the connection without answering\n";
+    return 1;
+  }
+  return status;
+}
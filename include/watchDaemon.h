@@ -0,0 +1,146 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "./file.h"
+#include "./fileHandler.h"
+#include "./resultStore.h"
+
+/**
+ * @class watchDaemon
+ * @brief Keeps the counts of a set of trees in memory and answers queries over a Unix socket.
+ *
+ * The trees are walked and counted once. Every directory is then watched with inotify, and only
+ * the files written, moved or deleted afterwards are recounted (through fileHandler::countFile) or
+ * dropped. A single thread alternates between the inotify events and the queries, so a query
+ * always sees a consistent state and costs a sort and a print, not a walk.
+ *
+ * A query is the list of its options, one per line. The answer is a status byte ('0' or '1' for
+ * an error) followed by the output. Clients are served without blocking: the answer is rendered
+ * at once, then sent as the socket takes it, while the loop goes on with the events and the other
+ * clients. New queries are held back while too many bytes of answers wait to be sent, and a client
+ * that makes no progress for a while is dropped.
+ */
+class watchDaemon {
+public:
+  /**
+   * @brief Creates a daemon; nothing happens until run().
+   *
+   * @param paths Files and directories to count and watch.
+   * @param options Discovery and counting settings.
+   */
+  watchDaemon(std::vector<std::string> paths, const scanOptions& options);
+  ~watchDaemon();
+  watchDaemon(const watchDaemon&) = delete;
+  watchDaemon& operator=(const watchDaemon&) = delete;
+
+  /**
+   * @brief Counts the trees, then serves queries until SIGINT or SIGTERM.
+   *
+   * @param socketPath Path of the Unix socket to listen on.
+   * @return Exit status of the program.
+   */
+  int run(const std::string& socketPath);
+
+  /**
+   * @brief Sends a query to a running daemon and copies the answer to the standard output.
+   *
+   * @param socketPath Path of the daemon's socket.
+   * @param request Options of the query (-s/-S X, --top N, --format F, --totals).
+   * @return Exit status of the program.
+   */
+  static int query(const std::string& socketPath, const std::vector<std::string>& request);
+
+private:
+  /** A connected client: its query, then its answer. */
+  struct connection {
+    int fd = -1;           /**< Non-blocking socket */
+    std::string request;   /**< Query received so far */
+    bool received = false; /**< The whole query is in */
+    std::string reply;     /**< Answer, once rendered */
+    size_t sent = 0;       /**< Bytes of reply already sent */
+    std::chrono::steady_clock::time_point deadline; /**< Dropped if no progress by then */
+  };
+
+  std::vector<std::string> roots; /**< Paths given on the command line */
+  scanOptions options;            /**< Discovery and counting settings */
+  int inotifyFd = -1;             /**< inotify instance */
+  int listenFd = -1;              /**< Listening socket */
+
+  std::unordered_map<int, std::string> watches;       /**< Watch descriptor -> watched path */
+  std::vector<File> files;                            /**< Results, in order of discovery */
+  std::vector<bool> live;                             /**< The file still exists */
+  std::unordered_map<std::string, size_t> byPath;     /**< Path -> index of its live result */
+  size_t deadCount = 0;                               /**< Entries of files no longer live */
+  resultStore store;                                  /**< Live results, rebuilt when dirty */
+  bool dirty = true;                                  /**< files changed since store was built */
+  std::vector<connection> clients;                    /**< Clients being served */
+
+  /**
+   * @brief Walks a file or a directory, watching its directories and counting its files.
+   *
+   * @param path The file or directory.
+   */
+  void scan(const std::string& path);
+
+  /**
+   * @brief Forgets every result and watch and scans the roots again.
+   */
+  void rescan();
+
+  /**
+   * @brief Counts a file again, or adds it if it is new.
+   *
+   * @param filePath The file.
+   */
+  void update(const std::string& filePath);
+
+  /**
+   * @brief Drops the result of a file, or of every file under a directory.
+   *
+   * @param path The file, or the directory with a trailing slash.
+   */
+  void remove(const std::string& path);
+
+  /**
+   * @brief Drops the entries of the files removed, once they outnumber the live ones.
+   */
+  void compact();
+
+  /**
+   * @brief Applies the pending inotify events.
+   */
+  void readEvents();
+
+  /**
+   * @brief Reads what a client has sent of its query.
+   *
+   * @param client The client.
+   * @return False if the connection failed.
+   */
+  bool receive(connection& client);
+
+  /**
+   * @brief Sends what the socket of a client takes of its answer.
+   *
+   * @param client The client.
+   * @return False once the answer is sent whole or the connection failed.
+   */
+  bool send(connection& client);
+
+  /**
+   * @brief Renders the answer to a query.
+   *
+   * @param request Options of the query, one per line.
+   * @return Status byte, then the output.
+   */
+  std::string answer(const std::string& request);
+
+  /**
+   * @brief Gets the live results, rebuilding the store if files changed.
+   *
+   * @return The store.
+   */
+  const resultStore& results();
+};
@@ -1,9 +1,34 @@
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include "../include/contentFilter.h"
+#include "../include/contentHash.h"
+#include "../include/dedupTable.h"
 #include "../include/fileHandler.h"
 #include "../include/outputHandler.h"
+#include "../include/partMerger.h"
+#include "../include/resultCache.h"
+#include "../include/resultStore.h"
+#include "../include/spillSorter.h"
+#include "../include/tracer.h"
+#include "../include/watchDaemon.h"
 
 const std::string HELP_FILE_PATH = "./help.txt";
 
+// Options that stand alone and options that consume the next argument
+const std::vector<std::string> FLAG_OPTIONS = { "-h", "--help", "-r", "--cache-compact", "--stream", "--timings", "--respect-gitignore", "--dedup", "--io-uring", "--totals", "--merge" };
+const std::vector<std::string> VALUE_OPTIONS = { "-s", "-S", "-j", "--cache", "--trace", "--format", "--top", "--exclude", "--daemon", "--query", "--languages", "--max-memory", "--files-from", "--files0-from", "--shard", "--max-file-size", "--skip", "--skipped-report" };
+
+bool isKnownOption(const std::string& arg) {
+    return std::find(FLAG_OPTIONS.begin(), FLAG_OPTIONS.end(), arg) != FLAG_OPTIONS.end()
+        || std::find(VALUE_OPTIONS.begin(), VALUE_OPTIONS.end(), arg) != VALUE_OPTIONS.end();
+}
+
+bool takesValue(const std::string& arg) {
+    return std::find(VALUE_OPTIONS.begin(), VALUE_OPTIONS.end(), arg) != VALUE_OPTIONS.end();
+}
+
 void processHelpOption(const outputHandler& output, const std::string& arg) {
     if (arg == "-h" || arg == "--help") {
         output.printHelpMessage(HELP_FILE_PATH);
@@ -14,14 +39,14 @@ void processHelpOption(const outputHandler& output, const std::string& arg) {
 void validateOptions(int argc, char* argv[], bool& hasValidOption, bool& invalidOptionDetected, bool& attemptedSortWithoutFlag) {
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
-        if (arg == "-h" || arg == "--help" || arg == "-r" || arg == "-s" || arg == "-S") {
+        if (isKnownOption(arg)) {
             hasValidOption = true;
             return;
         }
         if (arg.find_first_not_of("ftcbsa") == std::string::npos) {
             attemptedSortWithoutFlag = true;
         }
-        if (arg[0] == '-' && arg != "-h" && arg != "--help" && arg != "-r" && arg != "-s" && arg != "-S") {
+        if (arg[0] == '-') {
             invalidOptionDetected = true;
         }
     }
@@ -43,12 +68,230 @@ std::pair<std::string, std::string> processSortOption(int argc, char* argv[], in
     return sortOption;
 }
 
-void processFiles(int argc, char* argv[], std::vector<File>& Db, bool isRecursive) {
+std::string processValueOption(int argc, char* argv[], int& i) {
+    if (i + 1 >= argc) {
+        std::cerr << "Argument expected after " << argv[i] << "!\n";
+        std::exit(1);
+    }
+    return argv[++i];
+}
+
+unsigned processJobsOption(int argc, char* argv[], int& i) {
+    std::string value = processValueOption(argc, argv, i);
+    if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos || value.size() > 4) {
+        std::cerr << "Invalid number of jobs: " << value << "\n";
+        std::exit(1);
+    }
+    return static_cast<unsigned>(std::stoul(value));
+}
+
+outputFormat processFormatOption(int argc, char* argv[], int& i) {
+    std::string value = processValueOption(argc, argv, i);
+    outputFormat format;
+    if (!recordWriter::parseFormat(value, format)) {
+        std::cerr << "Invalid format: " << value << " (table | json | csv | ndjson | bin)\n";
+        std::exit(1);
+    }
+    return format;
+}
+
+size_t processTopOption(int argc, char* argv[], int& i) {
+    std::string value = processValueOption(argc, argv, i);
+    if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos || value.size() > 9
+        || std::stoul(value) == 0) {
+        std::cerr << "Invalid number of rows: " << value << "\n";
+        std::exit(1);
+    }
+    return std::stoul(value);
+}
+
+std::uint64_t parseSize(const std::string& value) {
+    // A number of bytes, optionally followed by K, M or G (powers of 1024); 0 if it is not one
+    size_t digits = value.find_first_not_of("0123456789");
+    std::string suffix = digits == std::string::npos ? "" : value.substr(digits);
+    size_t shift = 64;
+    if (suffix.empty()) shift = 0;
+    if (suffix == "K" || suffix == "k") shift = 10;
+    if (suffix == "M" || suffix == "m") shift = 20;
+    if (suffix == "G" || suffix == "g") shift = 30;
+    if (digits == 0 || shift == 64 || value.size() - suffix.size() > 9) {
+        return 0;
+    }
+    return std::stoull(value.substr(0, digits)) << shift;
+}
+
+size_t processMemoryOption(int argc, char* argv[], int& i) {
+    std::string value = processValueOption(argc, argv, i);
+    std::uint64_t bytes = parseSize(value);
+    if (bytes < spillSorter::MIN_BUDGET) {
+        std::cerr << "Invalid memory size: " << value << " (at least 1M, e.g. 512M or 2G)\n";
+        std::exit(1);
+    }
+    return static_cast<size_t>(bytes);
+}
+
+void processFileSizeOption(int argc, char* argv[], int& i, contentFilter& filter) {
+    std::string value = processValueOption(argc, argv, i);
+    std::uint64_t bytes = parseSize(value);
+    if (bytes == 0) {
+        std::cerr << "Invalid file size: " << value << " (e.g. 512K or 16M)\n";
+        std::exit(1);
+    }
+    filter.setSizeLimit(bytes);
+}
+
+void processSkipOption(int argc, char* argv[], int& i, contentFilter& filter) {
+    // A comma-separated list of checks; the option may also be repeated
+    std::string value = processValueOption(argc, argv, i);
+    size_t start = 0;
+    while (start <= value.size()) {
+        size_t comma = value.find(',', start);
+        if (comma == std::string::npos) comma = value.size();
+        std::string check = value.substr(start, comma - start);
+        if (!filter.enable(check)) {
+            std::cerr << "Invalid check: " << check << " (binary | generated | minified)\n";
+            std::exit(1);
+        }
+        start = comma + 1;
+    }
+}
+
+void processShardOption(int argc, char* argv[], int& i, scanOptions& options) {
+    // I/N, the I-th of N shards counting from 1
+    std::string value = processValueOption(argc, argv, i);
+    size_t slash = value.find('/');
+    std::string index = value.substr(0, slash);
+    std::string count = slash == std::string::npos ? "" : value.substr(slash + 1);
+    if (index.empty() || count.empty() || index.find_first_not_of("0123456789") != std::string::npos
+        || count.find_first_not_of("0123456789") != std::string::npos || count.size() > 4 || index.size() > 4
+        || std::stoul(index) == 0 || std::stoul(index) > std::stoul(count)) {
+        std::cerr << "Invalid shard: " << value << " (I/N with 1 <= I <= N, e.g. 2/8)\n";
+        std::exit(1);
+    }
+    options.shardIndex = static_cast<unsigned>(std::stoul(index)) - 1;
+    options.shardCount = static_cast<unsigned>(std::stoul(count));
+}
+
+void processExcludeOption(int argc, char* argv[], int& i, std::vector<std::string>& excludes) {
+    // A comma-separated list of patterns; the option may also be repeated
+    std::string value = processValueOption(argc, argv, i);
+    size_t start = 0;
+    while (start <= value.size()) {
+        size_t comma = value.find(',', start);
+        if (comma == std::string::npos) comma = value.size();
+        if (comma > start) excludes.push_back(value.substr(start, comma - start));
+        start = comma + 1;
+    }
+}
+
+std::vector<std::string> collectPaths(int argc, char* argv[]) {
+    std::vector<std::string> paths;
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
-        if (arg[0] == '-') continue;
-        fileHandler handler(arg);
-        handler.setFilesInDatabase(Db, isRecursive);
+        if (arg[0] == '-') {
+            if (takesValue(arg)) ++i;  // Skip the option's argument as well
+            continue;
+        }
+        paths.push_back(arg);
+    }
+    return paths;
+}
+
+// Lists of files to count: their path ("-" is the standard input) and their delimiter
+using fileLists = std::vector<std::pair<std::string, char>>;
+
+// Ordinals of the files of the index-th path or list (the lists follow the paths), whatever options
+// surround them: the files of a run keep the same ordinals whatever shard counts them
+scanOptions argumentOptions(scanOptions options, std::uint64_t index) {
+    options.ordinalBase = index << 40;
+    return options;
+}
+
+// Identifies what a run counts (paths, lists and the options that choose the files), so the
+// parts of a sharded run can be checked against one another
+std::uint64_t scopeHash(const std::vector<std::string>& paths, const fileLists& lists, const scanOptions& options) {
+    std::string scope;
+    auto add = [&scope](const std::string& item) { scope.append(item).push_back('\0'); };
+    if (options.isRecursive) add("-r");
+    if (options.respectGitignore) add("--respect-gitignore");
+    for (const std::string& pattern : options.excludes) add("--exclude=" + pattern);
+    for (const std::string& path : paths) add(path);
+    for (const auto& [listPath, delimiter] : lists) add((delimiter == '\0' ? "--files0-from=" : "--files-from=") + listPath);
+    return contentHash::hash(scope.data(), scope.size());
+}
+
+void processLists(size_t first, const fileLists& lists, const scanOptions& options, const std::function<void(const File&)>& sink) {
+    for (size_t k = 0; k < lists.size(); ++k) {
+        const auto& [listPath, delimiter] = lists[k];
+        fileHandler(listPath).countList(delimiter, argumentOptions(options, first + k), sink);
+    }
+}
+
+void processFiles(int argc, char* argv[], const fileLists& lists, resultStore& Db, const scanOptions& options) {
+    std::vector<std::string> paths = collectPaths(argc, argv);
+    for (size_t k = 0; k < paths.size(); ++k) {
+        fileHandler handler(paths[k]);
+        handler.setFilesInDatabase(Db, argumentOptions(options, k));
+    }
+    processLists(paths.size(), lists, options, [&Db](const File& file) { Db.append(file); });
+    if (Db.empty()) {
+        std::cerr << "No valid files found!\n";
+        std::exit(1);
+    }
+}
+
+void processFilesStreaming(int argc, char* argv[], const fileLists& lists, outputHandler& output, const scanOptions& options) {
+    output.beginStream();
+    std::vector<std::string> paths = collectPaths(argc, argv);
+    for (size_t k = 0; k < paths.size(); ++k) {
+        fileHandler handler(paths[k]);
+        handler.streamFiles(argumentOptions(options, k), [&output](const File& file) { output.streamRow(file); });
+        output.flush();
+    }
+    processLists(paths.size(), lists, options, [&output](const File& file) { output.streamRow(file); });
+    if (output.streamedFiles() == 0) {
+        std::cerr << "No valid files found!\n";
+        std::exit(1);
+    }
+    output.endStream();
+}
+
+void processFilesBounded(int argc, char* argv[], const fileLists& lists, spillSorter& sorter, scanOptions options) {
+    // Streamed in the order of appearance, so the sorter breaks ties like a sort in memory
+    options.ordered = true;
+    auto append = [&sorter](const File& file) {
+        if (!sorter.append(file)) {
+            std::cerr << ">>>> Error: " << sorter.error() << "\n";
+            std::exit(1);
+        }
+    };
+    std::vector<std::string> paths = collectPaths(argc, argv);
+    for (size_t k = 0; k < paths.size(); ++k) {
+        fileHandler handler(paths[k]);
+        handler.streamFiles(argumentOptions(options, k), append);
+    }
+    processLists(paths.size(), lists, options, append);
+    if (sorter.size() == 0) {
+        std::cerr << "No valid files found!\n";
+        std::exit(1);
+    }
+    if (!sorter.finish()) {
+        std::cerr << ">>>> Error: " << sorter.error() << "\n";
+        std::exit(1);
+    }
+}
+
+void mergeParts(int argc, char* argv[], resultStore& Db) {
+    partMerger merger;
+    for (const std::string& partPath : collectPaths(argc, argv)) {
+        if (!merger.add(partPath)) {
+            std::cerr << ">>>> Error: " << merger.error() << "\n";
+            std::exit(1);
+        }
+    }
+    if (!merger.finish(Db)) {
+        std::cerr << ">>>> Error: " << merger.error() << "\n";
+        std::exit(1);
     }
     if (Db.empty()) {
         std::cerr << "No valid files found!\n";
@@ -72,15 +315,62 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
-    std::vector<File> Db;
+    resultStore Db;
     std::pair<std::string, std::string> sortOption;
-    bool isRecursive = false;
+    scanOptions options;
+    std::string cachePath;
+    bool compactCache = false;
+    bool streaming = false;
+    std::string tracePath;
+    bool showTimings = false;
+    outputFormat format = outputFormat::TABLE;
+    size_t topRows = 0;
+    bool dedup = false;
+    std::string formatName;
+    std::string daemonSocket;
+    std::string querySocket;
+    bool totals = false;
+    std::string languagesPath;
+    size_t maxMemory = 0;
+    fileLists lists;
+    bool merge = false;
+    contentFilter filter;
+    bool filtering = false;
+    std::string skippedReportPath;
 
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
         processHelpOption(output, arg);
 
-        if (arg == "-r") isRecursive = true;
+        if (arg == "-r") options.isRecursive = true;
+        if (arg == "-j") options.jobs = processJobsOption(argc, argv, i);
+        if (arg == "--cache") cachePath = processValueOption(argc, argv, i);
+        if (arg == "--cache-compact") compactCache = true;
+        if (arg == "--stream") streaming = true;
+        if (arg == "--trace") tracePath = processValueOption(argc, argv, i);
+        if (arg == "--timings") showTimings = true;
+        if (arg == "--format") {
+            format = processFormatOption(argc, argv, i);
+            formatName = argv[i];
+        }
+        if (arg == "--top") topRows = processTopOption(argc, argv, i);
+        if (arg == "--respect-gitignore") options.respectGitignore = true;
+        if (arg == "--dedup") dedup = true;
+        if (arg == "--io-uring") options.asyncIo = true;
+        if (arg == "--exclude") processExcludeOption(argc, argv, i, options.excludes);
+        if (arg == "--daemon") daemonSocket = processValueOption(argc, argv, i);
+        if (arg == "--query") querySocket = processValueOption(argc, argv, i);
+        if (arg == "--totals") totals = true;
+        if (arg == "--languages") languagesPath = processValueOption(argc, argv, i);
+        if (arg == "--max-memory") maxMemory = processMemoryOption(argc, argv, i);
+        if (arg == "--files-from") lists.emplace_back(processValueOption(argc, argv, i), '\n');
+        if (arg == "--files0-from") lists.emplace_back(processValueOption(argc, argv, i), '\0');
+        if (arg == "--shard") processShardOption(argc, argv, i, options);
+        if (arg == "--merge") merge = true;
+        if (arg == "--max-file-size") processFileSizeOption(argc, argv, i, filter);
+        if (arg == "--skip") processSkipOption(argc, argv, i, filter);
+        if (arg == "--max-file-size" || arg == "--skip") filtering = true;
+        if (arg == "--skipped-report") skippedReportPath = processValueOption(argc, argv, i);
 
         auto tempSortOption = processSortOption(argc, argv, i);
         if (!tempSortOption.first.empty() && sortOption.first.empty()) {
@@ -88,8 +378,161 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    processFiles(argc, argv, Db, isRecursive);
-    output.outputFormatted(Db, Db.size(), sortOption);
+    if (streaming && !sortOption.first.empty()) {
+        std::cerr << "--stream prints files as they are counted and cannot sort them (-s/-S)\n";
+        return 1;
+    }
+
+    if (topRows > 0 && sortOption.first.empty()) {
+        std::cerr << "--top selects the first rows of a sorted table and needs -s or -S\n";
+        return 1;
+    }
+
+    if (streaming && format == outputFormat::BIN) {
+        std::cerr << "--format bin needs the number of files up front and cannot be streamed\n";
+        return 1;
+    }
+
+    if (maxMemory > 0 && (streaming || !daemonSocket.empty())) {
+        std::cerr << "--max-memory bounds the rows kept for sorting; --stream and --daemon do not sort them\n";
+        return 1;
+    }
+
+    if (!lists.empty() && !daemonSocket.empty()) {
+        std::cerr << "--daemon watches the files and directories given; it cannot take a list\n";
+        return 1;
+    }
+
+    if (options.shardCount > 1 && (!daemonSocket.empty() || dedup)) {
+        std::cerr << "--shard counts a part of the files; --daemon and --dedup need all of them\n";
+        return 1;
+    }
+
+    if (merge && (options.shardCount > 1 || streaming || maxMemory > 0 || !daemonSocket.empty() || !lists.empty())) {
+        std::cerr << "--merge reads the parts written by --shard; it counts no files\n";
+        return 1;
+    }
+
+    if (filtering && !daemonSocket.empty()) {
+        std::cerr << "--daemon recounts the files as they change; it does not take --skip or --max-file-size\n";
+        return 1;
+    }
+
+    if (!skippedReportPath.empty() && !filtering) {
+        std::cerr << "--skipped-report lists the files turned down by --skip and --max-file-size\n";
+        return 1;
+    }
+
+    if (totals && querySocket.empty()) {
+        std::cerr << "--totals is a query option and needs --query\n";
+        return 1;
+    }
+
+    if (!querySocket.empty()) {
+        // The counting happens in the daemon: only the output options are sent
+        std::vector<std::string> request;
+        if (!sortOption.first.empty()) request.insert(request.end(), { sortOption.first, sortOption.second });
+        if (topRows > 0) request.insert(request.end(), { "--top", std::to_string(topRows) });
+        if (!formatName.empty()) request.insert(request.end(), { "--format", formatName });
+        if (totals) request.push_back("--totals");
+        return watchDaemon::query(querySocket, request);
+    }
+
+    output.setFormat(format);
+    std::vector<std::string> paths = collectPaths(argc, argv);
+    output.setShard(options.shardIndex, options.shardCount, static_cast<std::uint32_t>(paths.size() + lists.size()), scopeHash(paths, lists, options));
+    output.setTop(topRows);
+    if (format != outputFormat::TABLE) {
+        options.messages = &std::cerr;  // Keep the standard output parseable
+    }
+
+    if (!tracePath.empty() || showTimings) {
+        tracer::enable();
+    }
+
+    // Before anything looks at an extension
+    std::string languageError;
+    if (!languagesPath.empty() && !languageRegistry::loadFile(languagesPath, languageError)) {
+        std::cerr << ">>>> Error: " << languageError << "\n";
+        return 1;
+    }
+
+    std::unique_ptr<resultCache> cache;
+    if (!cachePath.empty()) {
+        traceSpan span("cache load", "phase");
+        cache = std::make_unique<resultCache>(cachePath);
+        if (!cache->load()) {
+            std::cerr << ">>>> Warning: invalid cache file " << cachePath << ", rebuilding it\n";
+        }
+        options.cache = cache.get();
+    }
+
+    std::unique_ptr<dedupTable> contents;
+    if (dedup) {
+        contents = std::make_unique<dedupTable>();
+        options.dedup = contents.get();
+    }
+
+    if (!daemonSocket.empty()) {
+        std::vector<std::string> roots = collectPaths(argc, argv);
+        if (roots.empty()) {
+            std::cerr << "--daemon needs the files or directories to watch\n";
+            return 1;
+        }
+        watchDaemon daemon(roots, options);
+        int status = daemon.run(daemonSocket);
+        if (cache && !cache->save(compactCache)) {
+            std::cerr << ">>>> Warning: could not write cache file " << cachePath << "\n";
+        }
+        return status;
+    }
+
+    if (filtering) {
+        options.filter = &filter;
+    }
+
+    std::unique_ptr<spillSorter> sorter;
+    if (merge) {
+        mergeParts(argc, argv, Db);
+    } else if (streaming) {
+        processFilesStreaming(argc, argv, lists, output, options);
+    } else if (maxMemory > 0) {
+        char column = sortOption.first.empty() ? '\0' : sortOption.second[0];
+        sorter = std::make_unique<spillSorter>(maxMemory, column, sortOption.first == "-S", topRows);
+        processFilesBounded(argc, argv, lists, *sorter, options);
+    } else {
+        processFiles(argc, argv, lists, Db, options);
+    }
+    if (cache) {
+        traceSpan span("cache save", "phase");
+        if (!cache->save(compactCache)) {
+            std::cerr << ">>>> Warning: could not write cache file " << cachePath << "\n";
+        }
+    }
+    if (sorter && !output.outputMerged(*sorter)) {
+        std::cerr << ">>>> Error: " << sorter->error() << "\n";
+        return 1;
+    }
+    if (!streaming && !sorter) {
+        output.outputFormatted(Db, Db.size(), sortOption);
+    }
+
+    if (contents) {
+        contents->printReport(std::cerr);
+    }
+    if (filtering) {
+        filter.printReport(std::cerr);
+    }
+    if (!skippedReportPath.empty() && !filter.writeReport(skippedReportPath)) {
+        std::cerr << ">>>> Warning: could not write the skipped files report " << skippedReportPath << "\n";
+    }
+
+    if (!tracePath.empty() && !tracer::writeChromeTrace(tracePath)) {
+        std::cerr << ">>>> Warning: could not write trace file " << tracePath << "\n";
+    }
+    if (showTimings) {
+        tracer::printTimings(std::cerr);
+    }
 
     return 0;
 }